@@ -0,0 +1,821 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "at_uart.h"
+#include "at_sim.h"
+#include "at_check.h"
+#include "at_mq.h"
+#include "at_http.h"
+#include "at_utils.h"
+#include "at_codec.h"
+#include "at_json_pool.h"
+#include "cJSON.h"
+
+// AT 协议栈基准测试：真实的 at_uart / at_mq / at_http 对接 at_sim 模拟的模组
+// 环境变量：
+//   BENCH_LATENCY_MS  模拟器每条命令的响应延迟，默认 0
+//   BENCH_ITERATIONS  每项的操作次数，默认 200
+//   BENCH_HTTP_BODY   HTTP 响应体字节数，默认 65536
+//   BENCH_CMUX        非 0 时连接前进入 CMUX，MQTT 与 HTTP 各走一条 DLC，默认 0
+//   BENCH_ENCODING    MQ 上行报文编码，json（默认）或 cbor
+//   BENCH_MODEL       模拟的模组，sim800（默认）或 a76xx，由探测选定对应的命令集
+//   BENCH_FORMAT      json（默认）或 csv
+//   BENCH_OUTPUT      结果写入的文件，默认标准输出
+
+static const char *TAG = "BENCH";
+
+// ---------------- 堆分配计数 ----------------
+// 链接时以 --wrap 接管，见 main/CMakeLists.txt；计数覆盖整个进程，
+// http_get 项包含模拟器为每次 HTTPREAD 组帧的一次分配
+static atomic_uint allocCount;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+  atomic_fetch_add(&allocCount, 1);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+  atomic_fetch_add(&allocCount, 1);
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+  atomic_fetch_add(&allocCount, 1);
+  return __real_realloc(ptr, size);
+}
+
+// ---------------- 结果 ----------------
+typedef struct
+{
+  const char *name;
+  uint32_t ops;
+  uint32_t failures;
+  double seconds;
+  double ops_per_s;
+  double kb_per_s; // 只有 HTTP 相关项与 msub_burst 填写
+  int64_t p50_us;  // 单次操作延迟，并发提交的项为 0
+  int64_t p90_us;
+  int64_t p99_us;
+  int64_t max_us;
+  double allocs_per_op;
+  double bytes_per_op; // 只有编码项填写，单条报文的字节数
+} bench_result_t;
+
+#define BENCH_MAX_RESULTS 16
+
+static bench_result_t results[BENCH_MAX_RESULTS];
+static int resultCount = 0;
+static int iterations = 200;
+static int latencyMs = 0;
+static int httpBody = 65536;
+static bool cmux = false;
+static mqEncoding_t encoding = MQ_ENCODING_JSON;
+static bool lte = false;
+
+// 一项测试的计时、延迟采样与分配计数
+typedef struct
+{
+  bench_result_t *result;
+  int64_t *samples;
+  uint32_t sampleCount;
+  int64_t start;
+  unsigned allocsStart;
+} bench_run_t;
+
+static int env_int(const char *name, int fallback)
+{
+  const char *value = getenv(name);
+  return value && *value ? atoi(value) : fallback;
+}
+
+static at_sim_config_t bench_sim_config(void)
+{
+  at_sim_config_t sim = AT_SIM_DEFAULT_CONFIG();
+  sim.latency_ms = latencyMs;
+  sim.jitter_ms = 0;
+  if (lte)
+  {
+    sim.model = "A7670C-LASE";
+    sim.revision = "A7670M7_V1.11.1";
+    sim.auto_pdp = true;
+  }
+  return sim;
+}
+
+static void bench_begin(bench_run_t *run, const char *name, uint32_t ops)
+{
+  run->result = &results[resultCount++];
+  memset(run->result, 0, sizeof(*run->result));
+  run->result->name = name;
+  run->result->ops = ops;
+  // 采样数组在计数开始前分配
+  run->samples = malloc(sizeof(int64_t) * (ops > 0 ? ops : 1));
+  run->sampleCount = 0;
+  run->allocsStart = atomic_load(&allocCount);
+  run->start = esp_timer_get_time();
+}
+
+static void bench_sample(bench_run_t *run, int64_t latency_us, bool ok)
+{
+  if (!ok)
+  {
+    run->result->failures++;
+  }
+  if (run->samples && run->sampleCount < run->result->ops)
+  {
+    run->samples[run->sampleCount++] = latency_us;
+  }
+}
+
+static int compare_i64(const void *a, const void *b)
+{
+  int64_t x = *(const int64_t *)a;
+  int64_t y = *(const int64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static int64_t percentile(const int64_t *sorted, uint32_t count, int percent)
+{
+  if (count == 0)
+  {
+    return 0;
+  }
+  uint32_t rank = ((uint64_t)count * percent + 99) / 100;
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void bench_end(bench_run_t *run)
+{
+  bench_result_t *result = run->result;
+  result->seconds = (esp_timer_get_time() - run->start) / 1e6;
+  unsigned allocs = atomic_load(&allocCount) - run->allocsStart;
+  result->allocs_per_op = result->ops > 0 ? (double)allocs / result->ops : 0;
+  result->ops_per_s = result->seconds > 0 ? result->ops / result->seconds : 0;
+  if (run->samples && run->sampleCount > 0)
+  {
+    qsort(run->samples, run->sampleCount, sizeof(int64_t), compare_i64);
+    result->p50_us = percentile(run->samples, run->sampleCount, 50);
+    result->p90_us = percentile(run->samples, run->sampleCount, 90);
+    result->p99_us = percentile(run->samples, run->sampleCount, 99);
+    result->max_us = run->samples[run->sampleCount - 1];
+  }
+  free(run->samples);
+  run->samples = NULL;
+  ESP_LOGW(TAG, "%s: %.1f ops/s, p50 %lld us, p99 %lld us, %u failures", result->name, result->ops_per_s,
+           (long long)result->p50_us, (long long)result->p99_us, (unsigned)result->failures);
+}
+
+// ---------------- 测试项 ----------------
+// 同步 AT 往返：at_send_command 的单条延迟
+static void bench_at_command()
+{
+  bench_run_t run;
+  bench_begin(&run, "at_command", iterations);
+  for (int i = 0; i < iterations; i++)
+  {
+    int64_t t0 = esp_timer_get_time();
+    bool ok = at_send_command("AT", "OK", 1000, NULL, false);
+    bench_sample(&run, esp_timer_get_time() - t0, ok);
+  }
+  bench_end(&run);
+}
+
+// 异步连续提交：引擎背靠背执行时的命令吞吐
+typedef struct
+{
+  SemaphoreHandle_t done;
+  atomic_int remaining;
+  atomic_int failures;
+} bench_pipeline_t;
+
+static void bench_pipeline_cb(const at_result_t *result, void *ctx)
+{
+  bench_pipeline_t *pipeline = ctx;
+  if (result->status != AT_STATUS_OK)
+  {
+    atomic_fetch_add(&pipeline->failures, 1);
+  }
+  if (atomic_fetch_sub(&pipeline->remaining, 1) == 1)
+  {
+    xSemaphoreGive(pipeline->done);
+  }
+}
+
+static void bench_at_pipelined()
+{
+  bench_pipeline_t pipeline = {.done = xSemaphoreCreateBinary()};
+  atomic_store(&pipeline.remaining, iterations);
+  bench_run_t run;
+  bench_begin(&run, "at_command_pipelined", iterations);
+  for (int i = 0; i < iterations; i++)
+  {
+    // 提交队列满时等待引擎腾出位置
+    at_cmd_t cmd = {
+        .command = "AT",
+        .expected = "OK",
+        .timeout_ms = 1000,
+        .cb = bench_pipeline_cb,
+        .ctx = &pipeline,
+        .submit_wait_ms = -1,
+    };
+    if (!at_submit(&cmd))
+    {
+      atomic_fetch_add(&pipeline.failures, 1);
+      if (atomic_fetch_sub(&pipeline.remaining, 1) == 1)
+      {
+        xSemaphoreGive(pipeline.done);
+      }
+    }
+  }
+  xSemaphoreTake(pipeline.done, portMAX_DELAY);
+  free(run.samples);
+  run.samples = NULL;
+  run.result->failures = atomic_load(&pipeline.failures);
+  bench_end(&run);
+  vSemaphoreDelete(pipeline.done);
+}
+
+// MQTT 发布：at_mq_publish 编码信封并等待模组 OK
+static void bench_mq_publish()
+{
+  char topic[64];
+  snprintf(topic, sizeof(topic), "/device/bench/data");
+  bench_run_t run;
+  bench_begin(&run, "mq_publish", iterations);
+  for (int i = 0; i < iterations; i++)
+  {
+    char uuid[37];
+    generate_random_uuid(uuid, sizeof(uuid));
+    mqMessage_t message = {
+        .topic = topic,
+        .event = Online,
+        .rawData = "{\"seq\":1,\"value\":42}",
+        .time = get_current_timestamp_ms(),
+        .ttl = 5000,
+        .id = uuid,
+    };
+    int64_t t0 = esp_timer_get_time();
+    bool ok = at_mq_publish(message, "OK", NULL);
+    bench_sample(&run, esp_timer_get_time() - t0, ok);
+  }
+  bench_end(&run);
+}
+
+// data 超出发布暂存区（MQ_DATA_SCRATCH_SIZE）时由 cJSON 另行分配打印缓冲区，
+// 开启 cJSON 池后该缓冲区来自池，这一项覆盖池内缓冲区的释放与 arena 复位
+#define BENCH_LARGE_DATA 1500
+
+static void bench_mq_publish_large()
+{
+  static char blob[BENCH_LARGE_DATA + 1];
+  memset(blob, 'x', BENCH_LARGE_DATA);
+  bench_run_t run;
+  bench_begin(&run, "mq_publish_large", iterations);
+  for (int i = 0; i < iterations; i++)
+  {
+    char uuid[37];
+    generate_random_uuid(uuid, sizeof(uuid));
+    cJSON *data = cJSON_CreateObject();
+    cJSON_AddStringToObject(data, "blob", blob);
+    mqMessage_t message = {
+        .topic = "/device/bench/large",
+        .event = Online,
+        .data = data,
+        .time = get_current_timestamp_ms(),
+        .ttl = 5000,
+        .id = uuid,
+    };
+    int64_t t0 = esp_timer_get_time();
+    bool ok = at_mq_publish(message, "OK", NULL);
+    bench_sample(&run, esp_timer_get_time() - t0, ok);
+  }
+  bench_end(&run);
+}
+
+// 信封编码：同一条心跳分别经 cJSON、at_codec JSON 与 at_codec CBOR 编码，
+// 不经过串口，比较每条的编码耗时与字节数
+#define BENCH_ENCODE_OPS_PER_ITERATION 50
+#define BENCH_ENCODE_BUF_SIZE 512
+
+static const at_codec_ping_t benchPing = {
+    .deviceId = "89860412102070123456",
+    .projectInfoCode = "PJ202406050002",
+};
+static const at_codec_regist_t benchRegist = {
+    .deviceId = "89860412102070123456",
+    .deviceName = "ESP32_AT",
+    .deviceCate = "Elevator",
+    .mqttUserName = "bench",
+    .projectInfoCode = "PJ202406050002",
+};
+
+// at_codec 改造前的写法：先建 cJSON 树再整体打印
+static size_t bench_encode_cjson(const char *uuid, uint64_t time, char *buf, size_t cap)
+{
+  cJSON *root = cJSON_CreateObject();
+  cJSON *data = cJSON_CreateObject();
+  cJSON_AddStringToObject(data, "deviceId", benchPing.deviceId);
+  cJSON_AddStringToObject(data, "projectInfoCode", benchPing.projectInfoCode);
+  cJSON_AddItemToObject(root, "data", data);
+  cJSON_AddStringToObject(root, "event", getEventString(Ping));
+  cJSON_AddStringToObject(root, "id", uuid);
+  cJSON_AddNumberToObject(root, "time", (double)time);
+  cJSON_AddNumberToObject(root, "ttl", 5000);
+  bool ok = cJSON_PrintPreallocated(root, buf, cap, false);
+  cJSON_Delete(root);
+  return ok ? strlen(buf) : 0;
+}
+
+// data 按 JSON 编码，信封按 encoding 编码，返回信封字节数
+static size_t bench_encode_codec(bool regist, mqEncoding_t encoding, const char *uuid, uint64_t time, char *buf, size_t cap)
+{
+  char data[BENCH_ENCODE_BUF_SIZE];
+  size_t len = regist ? at_codec_encode_regist(&benchRegist, data, sizeof(data))
+                      : at_codec_encode_ping(&benchPing, data, sizeof(data));
+  eventEnum event = regist ? RegistDevice : Ping;
+  at_codec_envelope_t env = {
+      .data = {.json = data, .len = len},
+      .event = {getEventString(event), event},
+      .id = uuid,
+      .time = time,
+      .ttl = 5000,
+  };
+  return encoding == MQ_ENCODING_CBOR ? at_codec_cbor_encode_envelope(&env, buf, cap)
+                                      : at_codec_encode_envelope(&env, buf, cap);
+}
+
+typedef enum
+{
+  BENCH_ENCODE_CJSON,
+  BENCH_ENCODE_JSON,
+  BENCH_ENCODE_CBOR,
+} bench_encoder_t;
+
+static void bench_encode(const char *name, bench_encoder_t encoder, bool regist)
+{
+  char uuid[37];
+  generate_random_uuid(uuid, sizeof(uuid));
+  uint64_t time = get_current_timestamp_ms();
+  char buf[BENCH_ENCODE_BUF_SIZE];
+  uint32_t ops = (uint32_t)iterations * BENCH_ENCODE_OPS_PER_ITERATION;
+  size_t bytes = 0;
+  bench_run_t run;
+  bench_begin(&run, name, ops);
+  for (uint32_t i = 0; i < ops; i++)
+  {
+    int64_t t0 = esp_timer_get_time();
+    size_t len = encoder == BENCH_ENCODE_CJSON  ? bench_encode_cjson(uuid, time, buf, sizeof(buf))
+                 : encoder == BENCH_ENCODE_JSON ? bench_encode_codec(regist, MQ_ENCODING_JSON, uuid, time, buf, sizeof(buf))
+                                                : bench_encode_codec(regist, MQ_ENCODING_CBOR, uuid, time, buf, sizeof(buf));
+    bench_sample(&run, esp_timer_get_time() - t0, len > 0 && len < sizeof(buf));
+    bytes = len;
+  }
+  run.result->bytes_per_op = bytes;
+  bench_end(&run);
+}
+
+// 下行消息：模拟器写出 +MSUB 到 at_mq 路由回调被调用的延迟
+typedef struct
+{
+  SemaphoreHandle_t received;
+  int64_t latency_us;
+} bench_msub_t;
+
+static bench_msub_t msub;
+
+static void bench_msub_handler(const char *topic, const char *payload, size_t len, void *ctx)
+{
+  bench_msub_t *state = ctx;
+  const char *t = strstr(payload, "\"t\":");
+  if (t)
+  {
+    state->latency_us = esp_timer_get_time() - strtoll(t + 4, NULL, 10);
+  }
+  xSemaphoreGive(state->received);
+}
+
+static void bench_msub_latency()
+{
+  msub.received = xSemaphoreCreateBinary();
+  at_mq_add_route("/device/bench/cmd/#", bench_msub_handler, &msub);
+  bench_run_t run;
+  bench_begin(&run, "msub_latency", iterations);
+  for (int i = 0; i < iterations; i++)
+  {
+    char payload[64];
+    int len = snprintf(payload, sizeof(payload), "{\"seq\":%d,\"t\":%lld}", i, (long long)esp_timer_get_time());
+    msub.latency_us = -1;
+    at_sim_publish("/device/bench/cmd/set", payload, len);
+    bool ok = xSemaphoreTake(msub.received, pdMS_TO_TICKS(1000)) == pdTRUE && msub.latency_us >= 0;
+    bench_sample(&run, msub.latency_us, ok);
+  }
+  bench_end(&run);
+}
+
+// 下行突发：模拟器连续写出不同长度的二进制负载（含 \r\n 与 0 字节），
+// 消息在串口读取中粘连或被切开，统计吞吐并逐字节校验
+#define BENCH_BURST_MAX_PAYLOAD 3000
+
+typedef struct
+{
+  SemaphoreHandle_t done;
+  uint32_t expected;
+  atomic_uint received;
+  atomic_uint corrupt;
+} bench_burst_t;
+
+static bench_burst_t burst;
+
+static size_t bench_burst_size(uint32_t seq)
+{
+  return 8 + (seq * 397) % BENCH_BURST_MAX_PAYLOAD;
+}
+
+static uint8_t bench_burst_byte(uint32_t seq, size_t i)
+{
+  return (uint8_t)(seq + i * 31);
+}
+
+static void bench_burst_handler(const char *topic, const char *payload, size_t len, void *ctx)
+{
+  bench_burst_t *state = ctx;
+  uint32_t seq;
+  bool ok = len >= sizeof(seq);
+  if (ok)
+  {
+    memcpy(&seq, payload, sizeof(seq));
+    ok = len == bench_burst_size(seq);
+    for (size_t i = sizeof(seq); ok && i < len; i++)
+    {
+      ok = (uint8_t)payload[i] == bench_burst_byte(seq, i);
+    }
+  }
+  if (!ok)
+  {
+    atomic_fetch_add(&state->corrupt, 1);
+  }
+  if (atomic_fetch_add(&state->received, 1) + 1 == state->expected)
+  {
+    xSemaphoreGive(state->done);
+  }
+}
+
+static void bench_msub_burst()
+{
+  burst.done = xSemaphoreCreateBinary();
+  burst.expected = iterations;
+  at_mq_add_route("/device/bench/burst", bench_burst_handler, &burst);
+  uint8_t *payload = malloc(BENCH_BURST_MAX_PAYLOAD + 8);
+  uint64_t bytes = 0;
+  bench_run_t run;
+  bench_begin(&run, "msub_burst", iterations);
+  for (uint32_t seq = 0; seq < (uint32_t)iterations; seq++)
+  {
+    size_t len = bench_burst_size(seq);
+    memcpy(payload, &seq, sizeof(seq));
+    for (size_t i = sizeof(seq); i < len; i++)
+    {
+      payload[i] = bench_burst_byte(seq, i);
+    }
+    at_sim_publish("/device/bench/burst", payload, len);
+    bytes += len;
+  }
+  xSemaphoreTake(burst.done, pdMS_TO_TICKS(5000));
+  run.result->failures = iterations - atomic_load(&burst.received) + atomic_load(&burst.corrupt);
+  bench_end(&run);
+  run.result->kb_per_s = run.result->seconds > 0 ? bytes / 1024.0 / run.result->seconds : 0;
+  free(payload);
+}
+
+static bool bench_http_sink(const void *data, size_t len, void *ctx)
+{
+  return true;
+}
+
+// HTTP 下载：GET + 分块 HTTPREAD 的响应体吞吐
+static void bench_http_get()
+{
+  char directive[32];
+  snprintf(directive, sizeof(directive), "http_body %d", httpBody);
+  at_sim_apply(directive);
+  int ops = iterations / 20 > 3 ? iterations / 20 : 3;
+  at_http_reader_t reader = {
+      .chunk_size = 4096,
+      .sink = bench_http_sink,
+  };
+  uint64_t bytes = 0;
+  bench_run_t run;
+  bench_begin(&run, "http_get", ops);
+  for (int i = 0; i < ops; i++)
+  {
+    at_http_result_t result = {0};
+    int64_t t0 = esp_timer_get_time();
+    bool ok = at_http_get_stream("http://bench/body", &reader, &result);
+    bench_sample(&run, esp_timer_get_time() - t0, ok);
+    bytes += result.received;
+  }
+  bench_end(&run);
+  run.result->kb_per_s = run.result->seconds > 0 ? bytes / 1024.0 / run.result->seconds : 0;
+  at_http_session_close();
+}
+
+// 公平性：后台持续 HTTP 下载时的 MQTT 发布延迟；单通道时发布排在 HTTPREAD 之后，
+// CMUX 下两者在不同 DLC 上交错进行
+static volatile bool httpLoadStop;
+static volatile uint64_t httpLoadBytes;
+
+static void bench_http_load_task(void *arg)
+{
+  at_http_reader_t reader = {
+      .chunk_size = 4096,
+      .sink = bench_http_sink,
+  };
+  while (!httpLoadStop)
+  {
+    at_http_result_t result = {0};
+    at_http_get_stream("http://bench/body", &reader, &result);
+    httpLoadBytes += result.received;
+  }
+  at_http_session_close();
+  xSemaphoreGive((SemaphoreHandle_t)arg);
+  vTaskDelete(NULL);
+}
+
+static void bench_mq_publish_under_http()
+{
+  SemaphoreHandle_t done = xSemaphoreCreateBinary();
+  httpLoadStop = false;
+  httpLoadBytes = 0;
+  xTaskCreate(bench_http_load_task, "bench_http", 4096, done, 5, NULL);
+  // 等下载进入 HTTPREAD 阶段
+  vTaskDelay(pdMS_TO_TICKS(50 + latencyMs * 4));
+
+  int ops = iterations / 4 > 10 ? iterations / 4 : 10;
+  bench_run_t run;
+  bench_begin(&run, "mq_publish_under_http", ops);
+  for (int i = 0; i < ops; i++)
+  {
+    char uuid[37];
+    generate_random_uuid(uuid, sizeof(uuid));
+    mqMessage_t message = {
+        .topic = "/device/bench/data",
+        .event = Online,
+        .rawData = "{\"seq\":1,\"value\":42}",
+        .time = get_current_timestamp_ms(),
+        .ttl = 5000,
+        .id = uuid,
+    };
+    int64_t t0 = esp_timer_get_time();
+    bool ok = at_mq_publish(message, "OK", NULL);
+    bench_sample(&run, esp_timer_get_time() - t0, ok);
+  }
+  bench_end(&run);
+  // 吞吐为同一时段内后台下载的速率
+  run.result->kb_per_s = run.result->seconds > 0 ? httpLoadBytes / 1024.0 / run.result->seconds : 0;
+  httpLoadStop = true;
+  xSemaphoreTake(done, portMAX_DELAY);
+  vSemaphoreDelete(done);
+}
+
+// 多模组扩展：同一组发布任务分别经一个与两个模组发出，比较总吞吐；
+// 每个会话同时只有一条 MPUBEX 在途，第二个模组由 at_sim 实例 1 模拟
+#define BENCH_SCALE_TASKS 4
+
+typedef struct
+{
+  atomic_uint remaining; // 尚未发出的消息数
+  atomic_uint failures;
+  atomic_uint running;   // 未退出的发布任务数
+  SemaphoreHandle_t done;
+} bench_scale_t;
+
+static void bench_scale_task(void *arg)
+{
+  bench_scale_t *scale = arg;
+  while (1)
+  {
+    unsigned left = atomic_load(&scale->remaining);
+    if (left == 0)
+    {
+      break;
+    }
+    if (!atomic_compare_exchange_weak(&scale->remaining, &left, left - 1))
+    {
+      continue;
+    }
+    char uuid[37];
+    generate_random_uuid(uuid, sizeof(uuid));
+    mqMessage_t message = {
+        .topic = "/device/bench/data",
+        .event = Online,
+        .rawData = "{\"seq\":1,\"value\":42}",
+        .time = get_current_timestamp_ms(),
+        .ttl = 5000,
+        .id = uuid,
+    };
+    if (!at_mq_publish(message, "OK", NULL))
+    {
+      atomic_fetch_add(&scale->failures, 1);
+    }
+  }
+  if (atomic_fetch_sub(&scale->running, 1) == 1)
+  {
+    xSemaphoreGive(scale->done);
+  }
+  vTaskDelete(NULL);
+}
+
+static void bench_mq_publish_scale(const char *name)
+{
+  bench_scale_t scale = {.done = xSemaphoreCreateBinary()};
+  atomic_store(&scale.remaining, iterations);
+  atomic_store(&scale.running, BENCH_SCALE_TASKS);
+  bench_run_t run;
+  bench_begin(&run, name, iterations);
+  for (int i = 0; i < BENCH_SCALE_TASKS; i++)
+  {
+    xTaskCreate(bench_scale_task, "bench_pub", 4096, &scale, 5, NULL);
+  }
+  xSemaphoreTake(scale.done, portMAX_DELAY);
+  free(run.samples);
+  run.samples = NULL;
+  run.result->failures = atomic_load(&scale.failures);
+  bench_end(&run);
+  vSemaphoreDelete(scale.done);
+}
+
+static void bench_mq_publish_modems()
+{
+  // 故障转移策略下只用主会话，即单模组的基线
+  at_mq_set_policy(MQ_POLICY_FAILOVER);
+  bench_mq_publish_scale("mq_publish_1_modem");
+#if AT_MODEM_MAX > 1
+  at_sim_config_t sim = bench_sim_config();
+  sim.iccid = "89860000000000000002";
+  at_modem_port_t port = AT_MODEM_PORT_DEFAULT();
+  port.uart_num = 2;
+  port.device = at_sim_start_on(1, &sim);
+  at_modem_t *modem = port.device ? at_modem_create(&port) : NULL;
+  mqConfig_t mq = {
+      .server = "bench",
+      .port = "1883",
+      .clientId = "bench-2",
+      .username = "bench",
+      .password = "bench",
+  };
+  if (modem == NULL || !at_modem_init(modem) || !at_mq_connect_on(modem, mq))
+  {
+    ESP_LOGE(TAG, "Second modem unavailable, skipping mq_publish_2_modems");
+    at_sim_stop_on(1);
+    return;
+  }
+  at_mq_set_policy(MQ_POLICY_BALANCE);
+  bench_mq_publish_scale("mq_publish_2_modems");
+  at_mq_set_policy(MQ_POLICY_FAILOVER);
+#endif
+}
+
+// ---------------- 输出 ----------------
+static void bench_report(FILE *out, bool csv)
+{
+  const char *encodingName = encoding == MQ_ENCODING_CBOR ? "cbor" : "json";
+  const char *dialect = at_uart_dialect()->name;
+  if (csv)
+  {
+    fprintf(out, "name,dialect,latency_ms,cmux,encoding,ops,failures,seconds,ops_per_s,kb_per_s,p50_us,p90_us,p99_us,max_us,"
+                 "allocs_per_op,bytes_per_op\n");
+    for (int i = 0; i < resultCount; i++)
+    {
+      bench_result_t *r = &results[i];
+      fprintf(out, "%s,%s,%d,%d,%s,%u,%u,%.3f,%.1f,%.1f,%lld,%lld,%lld,%lld,%.2f,%.0f\n", r->name, dialect, latencyMs, cmux,
+              encodingName, (unsigned)r->ops, (unsigned)r->failures, r->seconds, r->ops_per_s, r->kb_per_s,
+              (long long)r->p50_us, (long long)r->p90_us, (long long)r->p99_us, (long long)r->max_us, r->allocs_per_op,
+              r->bytes_per_op);
+    }
+    return;
+  }
+  fprintf(out, "{\"dialect\":\"%s\",\"latency_ms\":%d,\"cmux\":%s,\"encoding\":\"%s\",\"iterations\":%d,\"results\":[",
+          dialect, latencyMs, cmux ? "true" : "false", encodingName, iterations);
+  for (int i = 0; i < resultCount; i++)
+  {
+    bench_result_t *r = &results[i];
+    fprintf(out,
+            "%s{\"name\":\"%s\",\"ops\":%u,\"failures\":%u,\"seconds\":%.3f,\"ops_per_s\":%.1f,\"kb_per_s\":%.1f,"
+            "\"p50_us\":%lld,\"p90_us\":%lld,\"p99_us\":%lld,\"max_us\":%lld,\"allocs_per_op\":%.2f,"
+            "\"bytes_per_op\":%.0f}",
+            i > 0 ? "," : "", r->name, (unsigned)r->ops, (unsigned)r->failures, r->seconds, r->ops_per_s, r->kb_per_s,
+            (long long)r->p50_us, (long long)r->p90_us, (long long)r->p99_us, (long long)r->max_us, r->allocs_per_op,
+            r->bytes_per_op);
+  }
+  fprintf(out, "]}\n");
+}
+
+void app_main(void)
+{
+  // 与应用相同，cJSON 使用专用池
+  at_json_pool_init();
+  latencyMs = env_int("BENCH_LATENCY_MS", 0);
+  iterations = env_int("BENCH_ITERATIONS", 200);
+  httpBody = env_int("BENCH_HTTP_BODY", 65536);
+  cmux = env_int("BENCH_CMUX", 0) != 0;
+  const char *encodingEnv = getenv("BENCH_ENCODING");
+  encoding = encodingEnv && strcmp(encodingEnv, "cbor") == 0 ? MQ_ENCODING_CBOR : MQ_ENCODING_JSON;
+  const char *model = getenv("BENCH_MODEL");
+  lte = model && strcmp(model, "a76xx") == 0;
+  const char *format = getenv("BENCH_FORMAT");
+  bool csv = format && strcmp(format, "csv") == 0;
+
+  at_sim_config_t sim = bench_sim_config();
+  const char *device = at_sim_start(&sim);
+  if (device == NULL)
+  {
+    ESP_LOGE(TAG, "Failed to start modem simulator");
+    exit(1);
+  }
+  at_uart_set_device(device);
+  at_uart_init();
+  if (!is_uart_inited() || !at_check_ping())
+  {
+    ESP_LOGE(TAG, "Modem simulator not responding");
+    exit(1);
+  }
+  initSysTimeByAT();
+  if (!at_http_init())
+  {
+    ESP_LOGE(TAG, "HTTP init failed");
+    exit(1);
+  }
+  if (cmux && !at_uart_cmux_start())
+  {
+    ESP_LOGE(TAG, "CMUX start failed");
+    exit(1);
+  }
+  mqConfig_t mq = {
+      .server = "bench",
+      .port = "1883",
+      .clientId = "bench",
+      .username = "bench",
+      .password = "bench",
+  };
+  at_mq_set_default_encoding(encoding);
+  if (!at_mq_connect(mq))
+  {
+    ESP_LOGE(TAG, "MQTT connect failed");
+    exit(1);
+  }
+  at_uart_start_message_task();
+
+  bench_at_command();
+  bench_at_pipelined();
+  bench_mq_publish();
+  bench_mq_publish_large();
+  bench_msub_latency();
+  bench_msub_burst();
+  bench_http_get();
+  bench_mq_publish_under_http();
+  bench_mq_publish_modems();
+  bench_encode("encode_ping_cjson", BENCH_ENCODE_CJSON, false);
+  bench_encode("encode_ping_json", BENCH_ENCODE_JSON, false);
+  bench_encode("encode_ping_cbor", BENCH_ENCODE_CBOR, false);
+  bench_encode("encode_regist_json", BENCH_ENCODE_JSON, true);
+  bench_encode("encode_regist_cbor", BENCH_ENCODE_CBOR, true);
+
+  FILE *out = stdout;
+  const char *path = getenv("BENCH_OUTPUT");
+  if (path && (out = fopen(path, "w")) == NULL)
+  {
+    ESP_LOGE(TAG, "Failed to open %s", path);
+    out = stdout;
+  }
+  bench_report(out, csv);
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+
+  int failures = 0;
+  for (int i = 0; i < resultCount; i++)
+  {
+    failures += results[i].failures;
+  }
+  if (cmux)
+  {
+    at_uart_cmux_stop();
+  }
+  at_sim_stop();
+  at_sim_stop_on(1);
+  exit(failures > 0 ? 2 : 0);
+}
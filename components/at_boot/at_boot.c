@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "at_boot.h"
+#include "at_boot_store.h"
+
+#define AT_BOOT_MAGIC 0x41544254 // "ATBT"
+#define AT_BOOT_VERSION 2
+
+static const char *TAG = "AT_BOOT";
+
+// 存储中的记录，字段布局变化时递增 AT_BOOT_VERSION
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  at_boot_state_t state;
+  uint32_t crc;
+} at_boot_record_t;
+
+static SemaphoreHandle_t bootLock = NULL;
+static StaticSemaphore_t bootLockBuffer;
+static at_boot_state_t cache;
+
+static struct
+{
+  const char *name;
+  int64_t end_us;
+} phases[AT_BOOT_PHASES];
+static int phaseCount = 0;
+
+static uint32_t crc32(const void *data, size_t len)
+{
+  const uint8_t *p = data;
+  uint32_t crc = 0xFFFFFFFF;
+  while (len--)
+  {
+    crc ^= *p++;
+    for (int i = 0; i < 8; i++)
+    {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+// 首次使用时从存储载入，校验不通过按冷启动处理
+static void boot_load(void)
+{
+  at_boot_record_t record;
+  if (at_boot_store_read(&record, sizeof(record)) && record.magic == AT_BOOT_MAGIC &&
+      record.version == AT_BOOT_VERSION && record.crc == crc32(&record, offsetof(at_boot_record_t, crc)))
+  {
+    cache = record.state;
+    cache.iccid[sizeof(cache.iccid) - 1] = '\0';
+    cache.ip[sizeof(cache.ip) - 1] = '\0';
+    return;
+  }
+  memset(&cache, 0, sizeof(cache));
+}
+
+static void boot_save(void)
+{
+  at_boot_record_t record;
+  memset(&record, 0, sizeof(record));
+  record.magic = AT_BOOT_MAGIC;
+  record.version = AT_BOOT_VERSION;
+  record.state = cache;
+  record.crc = crc32(&record, offsetof(at_boot_record_t, crc));
+  if (!at_boot_store_write(&record, sizeof(record)))
+  {
+    ESP_LOGW(TAG, "Failed to save boot cache");
+  }
+}
+
+at_boot_state_t *at_boot_take(void)
+{
+  // 首次调用在启动流程中（at_check_warm_start 或第一次检查），此时还没有并发的调用者
+  if (bootLock == NULL)
+  {
+    bootLock = xSemaphoreCreateMutexStatic(&bootLockBuffer);
+    boot_load();
+  }
+  xSemaphoreTake(bootLock, portMAX_DELAY);
+  return &cache;
+}
+
+void at_boot_give(at_boot_state_t *state, bool changed)
+{
+  if (changed)
+  {
+    boot_save();
+  }
+  xSemaphoreGive(bootLock);
+}
+
+void at_boot_forget(void)
+{
+  at_boot_state_t *state = at_boot_take();
+  memset(state, 0, sizeof(*state));
+  at_boot_give(state, true);
+}
+
+void at_boot_phase(const char *name)
+{
+  if (phaseCount < AT_BOOT_PHASES)
+  {
+    phases[phaseCount].name = name;
+    phases[phaseCount].end_us = esp_timer_get_time();
+    phaseCount++;
+  }
+}
+
+void at_boot_report(bool warm)
+{
+  char line[256];
+  int n = 0;
+  int64_t start = 0;
+  for (int i = 0; i < phaseCount && n < (int)sizeof(line); i++)
+  {
+    n += snprintf(line + n, sizeof(line) - n, "%s%s %lld ms", i > 0 ? ", " : "", phases[i].name,
+                  (long long)(phases[i].end_us - start) / 1000);
+    start = phases[i].end_us;
+  }
+  ESP_LOGI(TAG, "%s boot in %lld ms: %s", warm ? "Warm" : "Cold", (long long)start / 1000, phaseCount ? line : "-");
+}
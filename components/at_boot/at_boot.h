@@ -0,0 +1,44 @@
+#ifndef AT_BOOT_H
+#define AT_BOOT_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+// 热启动缓存：模组身份、串口链路、承载与时钟状态保存在复位后仍保留的存储中
+// （ESP32 为 RTC 慢速内存，linux 目标为文件），看门狗复位后一次探测即可确认并跳过冷启动流程
+// 另记录启动各阶段的耗时
+
+#define AT_BOOT_PHASES 12
+
+typedef struct
+{
+  bool valid;         // 以下模组字段来自一次完整检查
+  uint32_t baud_rate; // 协商后的波特率，0 为未知
+  bool flow_ctrl;
+  bool echoOff;
+  char iccid[21];
+  bool pdpActive;
+  char ip[16];        // 承载分配的地址
+  uint8_t dialect;    // 探测到的命令集 at_dialect_id_t 加 1，0 为未知
+  int64_t clock_ms;   // 上次按模组时钟校时时的 UTC 毫秒，0 为未校时
+  uint32_t warmBoots; // 连续热启动次数，冷启动清零
+} at_boot_state_t;
+
+// 与 at_scratch_take/give 相同的用法：取得缓存并加锁，changed 为 true 时写回存储
+// 持锁期间不要发送 AT 命令
+at_boot_state_t *at_boot_take(void);
+void at_boot_give(at_boot_state_t *state, bool changed);
+// 清除缓存，下次启动走冷启动流程
+void at_boot_forget(void);
+
+// 记录一个启动阶段在此刻结束，耗时从上一个阶段（或上电）算起
+void at_boot_phase(const char *name);
+// 输出各阶段耗时，warm 表示本次是否走了热启动
+void at_boot_report(bool warm);
+
+#if CONFIG_IDF_TARGET_LINUX
+// linux 目标：指定缓存文件，未指定时读取环境变量 AT_BOOT_IMAGE，默认为 boot.img
+void at_boot_set_image(const char *path);
+#endif
+#endif
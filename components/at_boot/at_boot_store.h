@@ -0,0 +1,10 @@
+#ifndef AT_BOOT_STORE_H
+#define AT_BOOT_STORE_H
+#include <stdbool.h>
+#include <stddef.h>
+
+// 热启动缓存的存储后端：ESP32 上为 RTC_NOINIT 内存，linux 目标上为文件
+// 读出的内容可能是任意值，由调用者校验
+bool at_boot_store_read(void *buf, size_t len);
+bool at_boot_store_write(const void *buf, size_t len);
+#endif
@@ -0,0 +1,31 @@
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "at_boot_store.h"
+
+#define AT_BOOT_STORE_SIZE 128
+
+// 软件复位、看门狗复位与深睡唤醒后保留，上电时为随机值
+RTC_NOINIT_ATTR static uint8_t rtcStore[AT_BOOT_STORE_SIZE];
+
+bool at_boot_store_read(void *buf, size_t len)
+{
+  // 上电或掉电复位时模组多半也重新上电，缓存即使恰好校验通过也不可信
+  esp_reset_reason_t reason = esp_reset_reason();
+  if (len > sizeof(rtcStore) || reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT)
+  {
+    return false;
+  }
+  memcpy(buf, rtcStore, len);
+  return true;
+}
+
+bool at_boot_store_write(const void *buf, size_t len)
+{
+  if (len > sizeof(rtcStore))
+  {
+    return false;
+  }
+  memcpy(rtcStore, buf, len);
+  return true;
+}
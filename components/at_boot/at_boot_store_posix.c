@@ -0,0 +1,51 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "at_boot.h"
+#include "at_boot_store.h"
+
+#define DEFAULT_IMAGE "boot.img"
+
+static const char *TAG = "BOOT_STORE";
+static char imagePath[128] = {0};
+
+void at_boot_set_image(const char *path)
+{
+  strncpy(imagePath, path, sizeof(imagePath) - 1);
+  imagePath[sizeof(imagePath) - 1] = '\0';
+}
+
+static const char *image_path(void)
+{
+  const char *path = imagePath[0] ? imagePath : getenv("AT_BOOT_IMAGE");
+  return path ? path : DEFAULT_IMAGE;
+}
+
+bool at_boot_store_read(void *buf, size_t len)
+{
+  int fd = open(image_path(), O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  bool ok = read(fd, buf, len) == (ssize_t)len;
+  close(fd);
+  return ok;
+}
+
+bool at_boot_store_write(const void *buf, size_t len)
+{
+  const char *path = image_path();
+  int fd = open(path, O_WRONLY | O_CREAT, 0644);
+  if (fd < 0)
+  {
+    ESP_LOGE(TAG, "Failed to open %s: %s", path, strerror(errno));
+    return false;
+  }
+  bool ok = pwrite(fd, buf, len, 0) == (ssize_t)len;
+  close(fd);
+  return ok;
+}
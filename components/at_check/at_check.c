@@ -2,14 +2,24 @@
 #include "at_uart.h"
 #include "esp_log.h"
 #include <stddef.h>
+#include "sdkconfig.h"
+#if !CONFIG_IDF_TARGET_LINUX
 #include "driver/gpio.h"
+#define RESET_PIN GPIO_NUM_1
+#endif
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "at_config.h"
-#define RESET_PIN GPIO_NUM_1
+#include "at_check.h"
+#include "at_boot.h"
 
 
 static const char *TAG = "AT_CHECK";
+#if !CONFIG_IDF_TARGET_LINUX
 // 初始化GPIO
 void init_gpio()
 {
@@ -33,62 +43,321 @@ bool at_check_reset()
   gpio_set_level(RESET_PIN, 0);
   ESP_LOGI(TAG, "Module reset complete..");
   vTaskDelay(pdMS_TO_TICKS(6000));
+  // 模组重启后回显、附着和承载状态都已丢失
+  at_check_invalidate_on(NULL);
   return true;
 }
+#else
+// linux 目标没有复位引脚，模拟器无需硬复位
+bool at_check_reset()
+{
+  ESP_LOGW(TAG, "Module reset not supported on linux target");
+  return false;
+}
+#endif
 
-bool at_check_ping()
+// ---------------- 模组状态缓存 ----------------
+// 基础检查的结果在 TTL 内有效，URC 报告状态变化时立即失效
+#define AT_CHECK_STATE_TTL_MS 60000
+
+// 每个模组实例一份状态缓存，URC 处理器以它为上下文
+typedef struct
+{
+  at_modem_t *modem;
+  at_modem_state_t state;
+  SemaphoreHandle_t lock;
+  char iccid[21]; // at_get_iccid 返回的副本
+} at_check_ctx_t;
+
+static at_check_ctx_t checks[AT_MODEM_MAX];
+
+static at_check_ctx_t *check_of(at_modem_t *modem)
 {
+  at_modem_t *m = modem ? modem : at_modem_default();
+  at_check_ctx_t *c = &checks[at_modem_index(m)];
+  c->modem = m;
+  return c;
+}
+
+static bool check_command(at_check_ctx_t *c, const char *command, const char *expected, int timeout_ms, char *out_response)
+{
+  return at_modem_send_command(c->modem, AT_CHAN_CTRL, command, expected, timeout_ms, out_response);
+}
+
+bool at_check_ping_on(at_modem_t *modem)
+{
+  at_check_ctx_t *c = check_of(modem);
   // 每个2秒发送一个AT直到返回OK (最多发送5次)
   for (int i = 0; i < 10; i++)
   {
-    if (at_send_command("AT", "OK", 1000, NULL, false))
+    if (check_command(c, "AT", "OK", 1000, NULL))
     {
       ESP_LOGI(TAG, "AT check passed. Module is functioning correctly.");
       return true;
     }
   }
-  if (at_check_reset())
+  // 复位引脚只接在默认实例的模组上
+  if (at_modem_index(c->modem) == 0 && at_check_reset())
+  {
+    return at_check_ping_on(modem);
+  }
+  return false;
+}
+
+bool at_check_ping()
+{
+  return at_check_ping_on(NULL);
+}
+
+// 把状态缓存与当前链路写入热启动缓存，调用者不持有 c->lock；
+// 热启动缓存只记录默认实例
+static void state_persist(at_check_ctx_t *c)
+{
+  if (at_modem_index(c->modem) != 0)
+  {
+    return;
+  }
+  at_modem_state_t snapshot;
+  at_check_get_state_on(c->modem, &snapshot);
+  at_uart_link_t link;
+  at_modem_get_link(c->modem, &link);
+  at_boot_state_t *boot = at_boot_take();
+  boot->valid = snapshot.valid;
+  boot->baud_rate = link.baud_rate;
+  boot->flow_ctrl = link.flow_ctrl;
+  boot->echoOff = snapshot.echoOff;
+  memcpy(boot->iccid, snapshot.iccid, sizeof(boot->iccid));
+  boot->pdpActive = snapshot.pdpActive;
+  if (at_modem_dialect_known(c->modem))
+  {
+    boot->dialect = at_modem_dialect(c->modem)->id + 1;
+  }
+  memcpy(boot->ip, snapshot.ip, sizeof(boot->ip));
+  at_boot_give(boot, true);
+}
+
+// +CGATT: 既是 AT+CGATT? 的应答也是附着状态变化的 URC，两者都直接更新缓存
+static void cgatt_urc_handler(const char *line, size_t len, void *ctx)
+{
+  at_check_ctx_t *c = ctx;
+  int attached = atoi(line + strlen("+CGATT:"));
+  xSemaphoreTake(c->lock, portMAX_DELAY);
+  c->state.attached = attached;
+  bool lost = !attached && c->state.valid;
+  if (!attached)
+  {
+    c->state.valid = false;
+    c->state.pdpActive = false;
+  }
+  xSemaphoreGive(c->lock);
+  if (lost)
+  {
+    state_persist(c);
+  }
+}
+
+// 承载被网络去激活，如 "+SAPBR 1: DEACT"、"+CGEV: NW PDN DEACT 1"；只认当前命令集的格式
+static void pdp_lost_urc_handler(const char *line, size_t len, void *ctx)
+{
+  at_check_ctx_t *c = ctx;
+  const at_dialect_t *d = at_modem_dialect(c->modem);
+  if (strncmp(line, d->pdp_lost_urc, strlen(d->pdp_lost_urc)) != 0 || strstr(line, d->pdp_lost_match) == NULL)
+  {
+    return;
+  }
+  ESP_LOGW(TAG, "Bearer deactivated: %s", line);
+  xSemaphoreTake(c->lock, portMAX_DELAY);
+  c->state.pdpActive = false;
+  c->state.ip[0] = '\0';
+  xSemaphoreGive(c->lock);
+  state_persist(c);
+}
+
+// SIM 状态变化（拔卡、模组重启后的 +CPIN: READY）后缓存的内容全部不可信
+static void cpin_urc_handler(const char *line, size_t len, void *ctx)
+{
+  at_check_ctx_t *c = ctx;
+  ESP_LOGW(TAG, "SIM state changed: %s", line);
+  at_check_invalidate_on(c->modem);
+}
+
+static const at_modem_state_t stateUnknown = {
+    .attached = -1,
+    .rssi = -1,
+    .ber = -1,
+};
+
+static at_check_ctx_t *state_init(at_modem_t *modem)
+{
+  at_check_ctx_t *c = check_of(modem);
+  if (c->lock != NULL)
+  {
+    return c;
+  }
+  c->state = stateUnknown;
+  c->lock = xSemaphoreCreateMutex();
+  at_modem_register_urc(c->modem, "+CGATT:", cgatt_urc_handler, c);
+  // 探测之前不知道是哪种命令集，各命令集的去激活 URC 都登记
+  for (int i = 0; i < AT_DIALECT_COUNT; i++)
+  {
+    const char *prefix = at_dialect_get(i)->pdp_lost_urc;
+    bool seen = false;
+    for (int j = 0; j < i; j++)
+    {
+      seen |= strcmp(at_dialect_get(j)->pdp_lost_urc, prefix) == 0;
+    }
+    if (!seen)
+    {
+      at_modem_register_urc(c->modem, prefix, pdp_lost_urc_handler, c);
+    }
+  }
+  at_modem_register_urc(c->modem, "+CPIN:", cpin_urc_handler, c);
+  return c;
+}
+
+void at_check_invalidate_on(at_modem_t *modem)
+{
+  at_check_ctx_t *c = check_of(modem);
+  if (c->lock == NULL)
   {
-    return at_check_ping();
+    return;
+  }
+  xSemaphoreTake(c->lock, portMAX_DELAY);
+  c->state = stateUnknown;
+  xSemaphoreGive(c->lock);
+  state_persist(c);
+}
+
+void at_check_invalidate()
+{
+  at_check_invalidate_on(NULL);
+}
+
+void at_check_get_state_on(at_modem_t *modem, at_modem_state_t *out)
+{
+  at_check_ctx_t *c = check_of(modem);
+  if (c->lock == NULL)
+  {
+    *out = stateUnknown;
+    return;
+  }
+  xSemaphoreTake(c->lock, portMAX_DELAY);
+  *out = c->state;
+  xSemaphoreGive(c->lock);
+}
+
+void at_check_get_state(at_modem_state_t *out)
+{
+  at_check_get_state_on(NULL, out);
+}
+
+// 从 "<prefix> xxx\r\n" 中取出 ICCID，前缀由命令集给出
+static bool parse_iccid(const char *response, const char *prefix, char *iccid, size_t size)
+{
+  char *start = strstr(response, prefix);
+  if (start)
+  {
+    start += strlen(prefix);         // 跳过前缀
+    start += strspn(start, " ");     // 以及其后的空格
+    char *end = strchr(start, '\r'); // 查找行尾标志
+    if (end)
+    {
+      size_t len = end - start;
+      if (len < size) // 确保不会溢出
+      {
+        strncpy(iccid, start, len);
+        iccid[len] = '\0'; // 确保以空字符结尾
+        return true;
+      }
+    }
   }
   return false;
 }
 
 // AT Check Component
-bool at_check_base()
+// 缓存有效时直接返回；否则只补齐未知的部分，AT、CSQ 与 CGATT 每次都重新确认
+bool at_check_base_on(at_modem_t *modem)
 {
+  at_check_ctx_t *c = state_init(modem);
+  at_modem_state_t cached;
+  at_check_get_state_on(c->modem, &cached);
+  int64_t now = esp_timer_get_time();
+  if (cached.valid && now - cached.checkedAt_us < (int64_t)AT_CHECK_STATE_TTL_MS * 1000)
+  {
+    return true;
+  }
+
   ESP_LOGI(TAG, "Performing AT check...");
 
   // Check AT command communication
-  if (!at_send_command("AT", "OK", 5000, NULL, false))
+  if (!check_command(c, "AT", "OK", 5000, NULL))
   {
     ESP_LOGE(TAG, "Failed to communicate with module using AT command");
+    at_check_invalidate_on(c->modem);
     return false;
   }
+  // 首次检查时确定命令集，之后不再发送
+  at_modem_probe_dialect(c->modem);
 
   // Retrieve ICCID
-  if (!at_send_command("AT+ICCID", "+ICCID", 5000, NULL, false))
+  if (cached.iccid[0] == '\0')
   {
-    ESP_LOGE(TAG, "Failed to retrieve ICCID");
-    return false;
+    const at_dialect_t *d = at_modem_dialect(c->modem);
+    at_scratch_t *scratch = at_modem_scratch_take(c->modem);
+    bool ok = check_command(c, d->iccid_query, d->iccid_prefix, 5000, scratch->response) &&
+              parse_iccid(scratch->response, d->iccid_prefix, cached.iccid, sizeof(cached.iccid));
+    at_modem_scratch_give(c->modem, scratch);
+    if (!ok)
+    {
+      ESP_LOGE(TAG, "Failed to retrieve ICCID");
+      return false;
+    }
   }
 
   // Disable echo
-  if (!at_send_command("ATE0", "OK", 5000, NULL, false))
+  if (!cached.echoOff)
   {
-    ESP_LOGE(TAG, "Failed to disable echo");
-    return false;
+    if (!check_command(c, "ATE0", "OK", 5000, NULL))
+    {
+      ESP_LOGE(TAG, "Failed to disable echo");
+      return false;
+    }
+    cached.echoOff = true;
   }
 
   // Check signal quality
-  if (!at_send_command("AT+CSQ", "OK", 5000, NULL, false))
+  at_scratch_t *scratch = at_modem_scratch_take(c->modem);
+  if (!check_command(c, "AT+CSQ", "OK", 5000, scratch->response))
   {
+    at_modem_scratch_give(c->modem, scratch);
     ESP_LOGE(TAG, "Failed to retrieve signal quality");
     return false;
   }
+  char *csq = strstr(scratch->response, "+CSQ:");
+  if (csq == NULL || sscanf(csq, "+CSQ: %d,%d", &cached.rssi, &cached.ber) != 2)
+  {
+    cached.rssi = cached.ber = -1;
+  }
+  at_modem_scratch_give(c->modem, scratch);
 
-  // Check network attachment status
-  if (!at_send_command("AT+CGATT?", "+CGATT: 1", 5000, NULL, false))
+  // Check network attachment status，+CGATT: 行由 cgatt_urc_handler 写入缓存
+  if (!check_command(c, "AT+CGATT?", "OK", 5000, NULL))
+  {
+    ESP_LOGE(TAG, "Failed to query network attachment");
+    return false;
+  }
+
+  xSemaphoreTake(c->lock, portMAX_DELAY);
+  bool attached = c->state.attached == 1;
+  memcpy(c->state.iccid, cached.iccid, sizeof(c->state.iccid));
+  c->state.echoOff = cached.echoOff;
+  c->state.rssi = cached.rssi;
+  c->state.ber = cached.ber;
+  c->state.valid = attached;
+  c->state.checkedAt_us = now;
+  xSemaphoreGive(c->lock);
+  state_persist(c);
+  if (!attached)
   {
     ESP_LOGE(TAG, "Module is not attached to the network");
     return false;
@@ -98,96 +367,236 @@ bool at_check_base()
   return true;
 }
 
-char *at_get_iccid()
+bool at_check_base()
 {
-  static char iccid[21]; // ICCID 长度固定为 20 字符，加 1 用于空字符
-  char response[UART_BUF_SIZE];
+  return at_check_base_on(NULL);
+}
+
+char *at_get_iccid_on(at_modem_t *modem)
+{
+  at_check_ctx_t *c = state_init(modem);
+  char *iccid = c->iccid; // ICCID 长度固定为 20 字符，加 1 用于空字符
+
+  xSemaphoreTake(c->lock, portMAX_DELAY);
+  bool cached = c->state.iccid[0] != '\0';
+  if (cached)
+  {
+    memcpy(iccid, c->state.iccid, sizeof(c->iccid));
+  }
+  xSemaphoreGive(c->lock);
+  if (cached)
+  {
+    return iccid;
+  }
 
   // 发送 AT 命令并获取响应
-  if (!at_send_command("AT+ICCID", "+ICCID", 5000, response, false))
+  const at_dialect_t *d = at_modem_dialect(c->modem);
+  at_scratch_t *scratch = at_modem_scratch_take(c->modem);
+  if (!check_command(c, d->iccid_query, d->iccid_prefix, 5000, scratch->response))
   {
+    at_modem_scratch_give(c->modem, scratch);
     ESP_LOGE(TAG, "Failed to retrieve ICCID");
     return NULL;
   }
 
   // 日志记录完整响应
-  ESP_LOGI(TAG, "Response: %s", response);
+  ESP_LOGI(TAG, "Response: %s", scratch->response);
 
-  // 提取 "+ICCID: " 后的 ICCID 值
-  char *start = strstr(response, "+ICCID: ");
-  if (start)
+  // 提取前缀后的 ICCID 值
+  bool parsed = parse_iccid(scratch->response, d->iccid_prefix, iccid, sizeof(c->iccid));
+  at_modem_scratch_give(c->modem, scratch);
+  if (parsed)
   {
-    start += strlen("+ICCID: ");     // 跳过 "+ICCID: " 部分
-    char *end = strchr(start, '\r'); // 查找行尾标志
-    if (end)
+    xSemaphoreTake(c->lock, portMAX_DELAY);
+    memcpy(c->state.iccid, iccid, sizeof(c->state.iccid));
+    xSemaphoreGive(c->lock);
+    state_persist(c);
+    return iccid;
+  }
+
+  ESP_LOGE(TAG, "Invalid ICCID response format");
+  return NULL;
+}
+
+char *at_get_iccid()
+{
+  return at_get_iccid_on(NULL);
+}
+
+static bool pdp_active(at_check_ctx_t *c)
+{
+  xSemaphoreTake(c->lock, portMAX_DELAY);
+  bool active = c->state.pdpActive;
+  xSemaphoreGive(c->lock);
+  return active;
+}
+
+// 查询承载状态：1 为已分配 IP，0 为地址 0.0.0.0 或为空，-1 为查询失败；ip 可为 NULL
+// 应答行如 "+SAPBR: 1,1,\"10.0.0.2\"" 或 "+CGPADDR: 1,10.0.0.2"，地址都是最后一个字段
+static int pdp_query(at_check_ctx_t *c, const at_dialect_t *d, int timeout_ms, char *ip, size_t size)
+{
+  at_scratch_t *scratch = at_modem_scratch_take(c->modem);
+  int result = -1;
+  if (check_command(c, d->pdp_query, "OK", timeout_ms, scratch->response))
+  {
+    ESP_LOGI(TAG, "IP context status: %s", scratch->response);
+    char *line = strstr(scratch->response, d->pdp_query_prefix);
+    char address[16] = {0};
+    if (line != NULL)
     {
-      size_t len = end - start;
-      if (len < sizeof(iccid)) // 确保不会溢出
+      line[strcspn(line, "\r\n")] = '\0';
+      char *field = strrchr(line, ',');
+      field = field ? field + 1 : line + strlen(d->pdp_query_prefix);
+      field += strspn(field, " \"");
+      size_t len = strcspn(field, "\"");
+      if (len < sizeof(address))
       {
-        strncpy(iccid, start, len);
-        iccid[len] = '\0'; // 确保以空字符结尾
-        return iccid;
+        memcpy(address, field, len);
       }
     }
+    result = address[0] != '\0' && strcmp(address, "0.0.0.0") != 0;
+    if (ip && result == 1 && strlen(address) < size)
+    {
+      strcpy(ip, address);
+    }
   }
-
-  ESP_LOGE(TAG, "Invalid ICCID response format");
-  return NULL;
+  at_modem_scratch_give(c->modem, scratch);
+  return result;
 }
 
-static bool isPDPActive = false;
-bool at_check_pdp()
+// 按命令集配置并激活 PDP 上下文；原生 PDP 的模组附着后通常已有地址，先查询，
+// 查到地址时省去配置与激活命令
+bool at_check_pdp_on(at_modem_t *modem)
 {
-  char response[UART_BUF_SIZE];
-  // 设置 GPRS PDP 上下文 确保 PDP 激活
-  if (!isPDPActive)
+  at_check_ctx_t *c = state_init(modem);
+  if (pdp_active(c))
+  {
+    return true;
+  }
+  const at_dialect_t *d = at_modem_dialect(c->modem);
+  char address[sizeof(c->state.ip)] = {0};
+  int ip = d->caps & AT_DIALECT_CAP_NATIVE_PDP ? pdp_query(c, d, 3000, address, sizeof(address)) : 0;
+  if (ip != 1)
   {
-    if (!at_send_command("AT+SAPBR=3,1,\"CONTYPE\",\"GPRS\"", "OK", 1000, NULL, false))
+    for (const char *const *setup = d->pdp_setup; *setup != NULL; setup++)
     {
-      ESP_LOGE(TAG, "Failed to set GPRS connection type");
+      if (!check_command(c, *setup, "OK", 1000, NULL))
+      {
+        ESP_LOGE(TAG, "Failed to configure PDP context: %s", *setup);
+        return false;
+      }
+    }
+    // 查询 PDP 状态，确保 IP 地址有效
+    ip = pdp_query(c, d, 3000, address, sizeof(address));
+    if (ip < 0)
+    {
+      ESP_LOGE(TAG, "Failed to query PDP context status");
       return false;
     }
-    if (!at_send_command("AT+SAPBR=3,1,\"APN\",\"\"", "OK", 1000, NULL, false))
+  }
+  if (ip == 0)
+  {
+    ESP_LOGW(TAG, "Invalid IP address, PDP is not Active ,Activating PDP context...");
+    // 激活 PDP 上下文
+    if (!check_command(c, d->pdp_activate, "OK", d->pdp_activate_timeout_ms, NULL))
     {
-      ESP_LOGE(TAG, "Failed to set APN");
+      ESP_LOGE(TAG, "Failed to activate PDP context");
       return false;
     }
-    // 查询 PDP 状态，确保 IP 地址有效
-    if (!at_send_command("AT+SAPBR=2,1", "+SAPBR:", 3000, response, false))
+
+    // 再次查询 PDP 状态
+    ip = pdp_query(c, d, 3000, address, sizeof(address));
+    if (ip < 0)
     {
       ESP_LOGE(TAG, "Failed to query PDP context status");
       return false;
     }
-    ESP_LOGI(TAG, "IP context status: %s", response);
-    if (strstr(response, "\"0.0.0.0\"") != NULL)
+    if (ip == 0)
     {
-      ESP_LOGW(TAG, "Invalid IP address, PDP is not Active ,Activating PDP context...");
-      // 激活 PDP 上下文
-      if (!at_send_command("AT+SAPBR=1,1", "OK", 3000, NULL, false))
-      {
-        ESP_LOGE(TAG, "Failed to activate PDP context");
-        return false;
-      }
-
-      // 再次查询 PDP 状态
-      if (!at_send_command("AT+SAPBR=2,1", "+SAPBR:", 3000, response, false))
-      {
-        ESP_LOGE(TAG, "Failed to query PDP context status");
-        return false;
-      }
-      ESP_LOGI(TAG, "IP context status: %s", response);
-      if (strstr(response, "\"0.0.0.0\"") != NULL)
-      {
-        ESP_LOGE(TAG, "Failed to activate PDP context");
-        return false;
-      }
+      ESP_LOGE(TAG, "Failed to activate PDP context");
+      return false;
     }
-    // 设置 PDP 激活标志
-    isPDPActive = true;
-    return true;
+  }
+  // 设置 PDP 激活标志，承载去激活的 URC 会清除
+  xSemaphoreTake(c->lock, portMAX_DELAY);
+  c->state.pdpActive = true;
+  memcpy(c->state.ip, address, sizeof(c->state.ip));
+  xSemaphoreGive(c->lock);
+  state_persist(c);
+  return true;
+}
+
+bool at_check_pdp()
+{
+  return at_check_pdp_on(NULL);
+}
+
+// 热启动探测的超时：波特率不对时只会收到乱码，不必等满 3 秒
+#define AT_CHECK_WARM_PROBE_MS 500
+
+// 热启动缓存只记录默认实例
+bool at_check_warm_start()
+{
+  at_check_ctx_t *c = state_init(NULL);
+  at_boot_state_t *boot = at_boot_take();
+  at_boot_state_t saved = *boot;
+  at_boot_give(boot, false);
+  if (saved.baud_rate == 0 || saved.iccid[0] == '\0')
+  {
+    ESP_LOGI(TAG, "No warm boot state, cold start");
+    return false;
+  }
+
+  at_uart_link_t previous;
+  at_uart_get_link(&previous);
+  at_uart_link_t link = previous;
+  link.baud_rate = saved.baud_rate;
+  link.flow_ctrl = saved.flow_ctrl;
+  // 热启动不再探测，沿用上次探测到的命令集
+  const at_dialect_t *dialect = saved.dialect ? at_dialect_get(saved.dialect - 1) : NULL;
+  if (dialect != NULL && !at_modem_dialect_known(NULL))
+  {
+    at_modem_set_dialect(NULL, dialect);
+  }
+  char ip[sizeof(c->state.ip)] = {0};
+  int bearer = at_uart_resume_link(&link) ? pdp_query(c, at_uart_dialect(), AT_CHECK_WARM_PROBE_MS, ip, sizeof(ip)) : -1;
+  if (bearer < 0)
+  {
+    // 模组已重新上电或停在别的波特率，交给冷启动流程重新协商
+    ESP_LOGW(TAG, "Modem not responding at cached %u baud, cold start", (unsigned)saved.baud_rate);
+    at_uart_resume_link(&previous);
+    boot = at_boot_take();
+    boot->warmBoots = 0;
+    at_boot_give(boot, true);
+    return false;
+  }
+
+  bool warm = saved.valid && saved.pdpActive && bearer == 1;
+  xSemaphoreTake(c->lock, portMAX_DELAY);
+  memcpy(c->state.iccid, saved.iccid, sizeof(c->state.iccid));
+  c->state.echoOff = saved.echoOff;
+  if (warm)
+  {
+    c->state.valid = true;
+    c->state.attached = 1;
+    c->state.pdpActive = true;
+    memcpy(c->state.ip, ip, sizeof(c->state.ip));
+    c->state.checkedAt_us = esp_timer_get_time();
+  }
+  xSemaphoreGive(c->lock);
+  state_persist(c);
+
+  boot = at_boot_take();
+  boot->warmBoots = warm ? boot->warmBoots + 1 : 0;
+  at_boot_give(boot, true);
+  if (warm)
+  {
+    ESP_LOGI(TAG, "Warm start #%u: %s at %u baud, bearer %s", (unsigned)saved.warmBoots + 1, saved.iccid,
+             (unsigned)saved.baud_rate, ip);
   }
   else
   {
-    return true;
+    ESP_LOGW(TAG, "Bearer lost since last boot, reusing identity only");
   }
-}
\ No newline at end of file
+  return warm;
+}
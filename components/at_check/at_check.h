@@ -2,9 +2,44 @@
 #ifndef AT_CHECK_H
 #define AT_CHECK_H
 #include <stdbool.h>
+#include <stdint.h>
+#include "at_uart.h"
+
+// 模组状态缓存，由 at_check_base 填充，+CGATT / 承载去激活 / +CPIN 上报时失效；
+// 每次变化同步写入 at_boot 热启动缓存
+typedef struct
+{
+  bool valid;           // 基础检查已通过，TTL 内无需再次检查
+  bool echoOff;
+  char iccid[21];       // 空字符串为未知
+  int attached;         // +CGATT，-1 为未知
+  int rssi;             // +CSQ，-1 为未知
+  int ber;
+  bool pdpActive;       // 承载已激活
+  char ip[16];          // 承载分配的地址，空字符串为未知
+  int64_t checkedAt_us; // 上次完整检查的时间
+} at_modem_state_t;
+
+// 缓存有效时直接返回 true，不发送任何命令
 bool at_check_base();
 bool at_check_ping();
 bool at_check_pdp();
 bool at_check_reset();
 char *at_get_iccid();
+void at_check_get_state(at_modem_state_t *out);
+// 丢弃缓存，下次 at_check_base / at_check_pdp 重新检查
+void at_check_invalidate();
+// 热启动：按上次保存的波特率切换串口，只发一条承载查询（如 AT+SAPBR=2,1）确认链路与承载，
+// 通过后恢复状态缓存并返回 true，at_check_base / at_check_pdp 不再发送命令；
+// 承载已断开时仍恢复 ICCID 与回显状态，返回 false，由调用者走冷启动流程
+bool at_check_warm_start();
+
+// 以下与同名函数相同，作用于指定模组实例，各实例的状态缓存相互独立；modem 为 NULL 即默认实例。
+// 复位引脚与热启动缓存只属于默认实例
+bool at_check_base_on(at_modem_t *modem);
+bool at_check_ping_on(at_modem_t *modem);
+bool at_check_pdp_on(at_modem_t *modem);
+char *at_get_iccid_on(at_modem_t *modem);
+void at_check_get_state_on(at_modem_t *modem, at_modem_state_t *out);
+void at_check_invalidate_on(at_modem_t *modem);
 #endif
\ No newline at end of file
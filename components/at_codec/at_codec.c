@@ -0,0 +1,198 @@
+#include "at_codec.h"
+#include <string.h>
+
+static inline void put(at_codec_out_t *out, const char *data, size_t len)
+{
+  out->total += len;
+  if (out->buf == NULL)
+  {
+    return;
+  }
+  if (out->pos + len > out->cap)
+  {
+    if (out->flush == NULL)
+    {
+      // 截断模式：放不下就不再写，total 仍给出所需长度
+      out->cap = out->pos;
+      return;
+    }
+    at_codec_out_flush(out);
+    // 比缓冲区还大的片段直接写出，不做拷贝
+    if (len > out->cap)
+    {
+      out->flush(data, len);
+      return;
+    }
+  }
+  memcpy(out->buf + out->pos, data, len);
+  out->pos += len;
+}
+
+void at_codec_out_put(at_codec_out_t *out, const char *data, size_t len)
+{
+  put(out, data, len);
+}
+
+void at_codec_out_flush(at_codec_out_t *out)
+{
+  if (out->flush && out->buf && out->pos > 0)
+  {
+    out->flush(out->buf, out->pos);
+  }
+  out->pos = 0;
+}
+
+static const char digitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// 整数直接转十进制，不经过 double，也不走 printf
+void at_codec_out_u64(at_codec_out_t *out, uint64_t value)
+{
+  char digits[20];
+  char *p = digits + sizeof(digits);
+  while (value >= 100)
+  {
+    unsigned pair = (unsigned)(value % 100) * 2;
+    value /= 100;
+    *--p = digitPairs[pair + 1];
+    *--p = digitPairs[pair];
+  }
+  if (value >= 10)
+  {
+    *--p = digitPairs[value * 2 + 1];
+    *--p = digitPairs[value * 2];
+  }
+  else
+  {
+    *--p = (char)('0' + value);
+  }
+  put(out, p, digits + sizeof(digits) - p);
+}
+
+// 输出 JSON 字符串，不需要转义的连续片段整段写出
+void at_codec_out_string(at_codec_out_t *out, const char *str)
+{
+  if (str == NULL)
+  {
+    put(out, "null", 4);
+    return;
+  }
+  at_codec_out_string_len(out, str, strlen(str));
+}
+
+void at_codec_out_string_len(at_codec_out_t *out, const char *str, size_t len)
+{
+  static const char hex[] = "0123456789abcdef";
+  put(out, "\"", 1);
+  const char *run = str;
+  const char *p = str;
+  for (; p < str + len; p++)
+  {
+    unsigned char c = (unsigned char)*p;
+    if (c != '"' && c != '\\' && c >= 0x20)
+    {
+      continue;
+    }
+    put(out, run, p - run);
+    char esc[6] = {'\\', 0};
+    size_t n = 2;
+    switch (c)
+    {
+    case '"':
+    case '\\':
+      esc[1] = c;
+      break;
+    case '\n':
+      esc[1] = 'n';
+      break;
+    case '\r':
+      esc[1] = 'r';
+      break;
+    case '\t':
+      esc[1] = 't';
+      break;
+    default:
+      memcpy(esc + 1, "u00", 3);
+      esc[4] = hex[c >> 4];
+      esc[5] = hex[c & 0xf];
+      n = 6;
+      break;
+    }
+    put(out, esc, n);
+    run = p + 1;
+  }
+  put(out, run, p - run);
+  put(out, "\"", 1);
+}
+
+static inline void emit_STR(at_codec_out_t *out, const char *const *value)
+{
+  at_codec_out_string(out, *value);
+}
+
+static inline void emit_U64(at_codec_out_t *out, const uint64_t *value)
+{
+  at_codec_out_u64(out, *value);
+}
+
+static inline void emit_EVT(at_codec_out_t *out, const at_codec_event_t *value)
+{
+  at_codec_out_string(out, value->name);
+}
+
+static inline void emit_UUID(at_codec_out_t *out, const char *const *value)
+{
+  at_codec_out_string(out, *value);
+}
+
+static inline void emit_RAW(at_codec_out_t *out, const at_codec_raw_t *value)
+{
+  if (value->json == NULL)
+  {
+    put(out, "null", 4);
+    return;
+  }
+  put(out, value->json, value->len);
+}
+
+// 每个字段展开成一次键名写出和一次取值写出，键名带前导逗号在编译期拼好，
+// 第一个字段跳过逗号，由 '{' 代替
+#define AT_CODEC_EMIT_FIELD(schema, type, name)                              \
+  put(out, ",\"" #name "\":" + first, sizeof(",\"" #name "\":") - 1 - first); \
+  first = 0;                                                                 \
+  emit_##type(out, &value->name);
+
+#define AT_CODEC_FUNC_DEF(schema, FIELDS)                                                  \
+  void at_codec_emit_##schema(const at_codec_##schema##_t *value, at_codec_out_t *out)     \
+  {                                                                                        \
+    size_t first = 1;                                                                      \
+    put(out, "{", 1);                                                                      \
+    FIELDS(AT_CODEC_EMIT_FIELD)                                                            \
+    put(out, "}", 1);                                                                      \
+  }                                                                                        \
+  size_t at_codec_size_##schema(const at_codec_##schema##_t *value)                         \
+  {                                                                                        \
+    at_codec_out_t out = {0};                                                              \
+    at_codec_emit_##schema(value, &out);                                                   \
+    return out.total;                                                                      \
+  }                                                                                        \
+  size_t at_codec_encode_##schema(const at_codec_##schema##_t *value, char *buf, size_t cap) \
+  {                                                                                        \
+    at_codec_out_t out = {.buf = buf, .cap = cap};                                         \
+    at_codec_emit_##schema(value, &out);                                                   \
+    if (buf != NULL && cap > 0)                                                            \
+    {                                                                                      \
+      buf[out.total < cap ? out.total : out.pos < cap ? out.pos : cap - 1] = '\0';         \
+    }                                                                                      \
+    return out.total;                                                                      \
+  }
+AT_CODEC_SCHEMAS(AT_CODEC_FUNC_DEF)
@@ -0,0 +1,92 @@
+#ifndef AT_CODEC_H
+#define AT_CODEC_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "at_codec_schema.h"
+
+// 固定结构报文的 JSON 编码器，字段表见 at_codec_schema.h
+// 不分配内存，输出到调用者的缓冲区或写出函数
+
+typedef struct
+{
+  const char *json; // NULL 输出 null
+  size_t len;
+} at_codec_raw_t;
+
+// 事件同时给出名称与编号，JSON 输出名称，CBOR 输出编号
+typedef struct
+{
+  const char *name;
+  uint32_t code;
+} at_codec_event_t;
+
+#define AT_CODEC_CTYPE_STR const char *
+#define AT_CODEC_CTYPE_U64 uint64_t
+#define AT_CODEC_CTYPE_RAW at_codec_raw_t
+#define AT_CODEC_CTYPE_EVT at_codec_event_t
+#define AT_CODEC_CTYPE_UUID const char *
+
+// 由字段表生成 at_codec_<schema>_t
+#define AT_CODEC_FIELD_DECL(schema, type, name) AT_CODEC_CTYPE_##type name;
+#define AT_CODEC_STRUCT_DECL(schema, FIELDS) \
+  typedef struct                             \
+  {                                          \
+    FIELDS(AT_CODEC_FIELD_DECL)              \
+  } at_codec_##schema##_t;
+AT_CODEC_SCHEMAS(AT_CODEC_STRUCT_DECL)
+
+// 输出端：buf 为 NULL 时只计数；buf 写满时有 flush 则写出后复用，否则截断
+typedef struct
+{
+  char *buf;
+  size_t cap;
+  size_t pos;
+  size_t total; // 完整输出所需的字节数
+  void (*flush)(const void *data, size_t len);
+} at_codec_out_t;
+
+void at_codec_out_put(at_codec_out_t *out, const char *data, size_t len);
+void at_codec_out_flush(at_codec_out_t *out);
+void at_codec_out_string(at_codec_out_t *out, const char *str);
+// 同上，str 不必以 0 结尾
+void at_codec_out_string_len(at_codec_out_t *out, const char *str, size_t len);
+void at_codec_out_u64(at_codec_out_t *out, uint64_t value);
+
+// 每个报文生成三个函数：
+//   at_codec_emit_<schema>   输出到 out
+//   at_codec_size_<schema>   精确长度，不含结尾 0
+//   at_codec_encode_<schema> 写入 buf，语义同 snprintf：返回完整长度，
+//                            长度 < cap 时写入完整内容并以 0 结尾
+#define AT_CODEC_FUNC_DECL(schema, FIELDS)                                            \
+  void at_codec_emit_##schema(const at_codec_##schema##_t *value, at_codec_out_t *out); \
+  size_t at_codec_size_##schema(const at_codec_##schema##_t *value);                    \
+  size_t at_codec_encode_##schema(const at_codec_##schema##_t *value, char *buf, size_t cap);
+AT_CODEC_SCHEMAS(AT_CODEC_FUNC_DECL)
+
+// ---------------- CBOR ----------------
+// 同一字段表的 CBOR (RFC 8949) 编码，按流量计费的链路上代替 JSON：
+// map 的键取 AT_CODEC_CBOR_KEYS 中的整数，整数按 CBOR 变长头编码，
+// EVT 输出编号，UUID 输出 16 字节二进制（不是标准 UUID 文本时退回文本），
+// RAW 字段中的 JSON 在输出时转码，不需要额外的缓冲区
+//   at_codec_cbor_emit_<schema>   输出到 out
+//   at_codec_cbor_size_<schema>   精确长度
+//   at_codec_cbor_encode_<schema> 写入 buf，返回完整长度，不追加结尾 0
+#define AT_CODEC_CBOR_FUNC_DECL(schema, FIELDS)                                              \
+  void at_codec_cbor_emit_##schema(const at_codec_##schema##_t *value, at_codec_out_t *out); \
+  size_t at_codec_cbor_size_##schema(const at_codec_##schema##_t *value);                    \
+  size_t at_codec_cbor_encode_##schema(const at_codec_##schema##_t *value, void *buf, size_t cap);
+AT_CODEC_SCHEMAS(AT_CODEC_CBOR_FUNC_DECL)
+
+// 把一段 JSON 转码为 CBOR：键按字典换成整数，整数保持整数，小数输出 float32（无损时）或 float64，
+// "id" 键的 UUID 文本输出 16 字节二进制；对象与数组输出为不定长 map/array，只读一遍。
+// JSON 不合法时返回 false，out 中只有已转换的部分，但仍是合法的 CBOR
+bool at_codec_cbor_from_json(const char *json, size_t len, at_codec_out_t *out);
+// 把 CBOR 还原为 JSON：整数键按字典还原为键名，"event" 的编号按 events 还原为名称
+// （events 为 NULL 或越界时保留数字），16 字节二进制输出为 UUID 文本；
+// 不是合法 CBOR 或嵌套过深时返回 false
+bool at_codec_cbor_to_json(const void *cbor, size_t len, at_codec_out_t *out, const char *const *events, size_t eventCount);
+// 首字节是 CBOR map 或 array 的头，JSON 文本不会以这些字节开头
+bool at_codec_is_cbor(const void *data, size_t len);
+
+#endif
@@ -0,0 +1,893 @@
+#include "at_codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// CBOR 主类型
+#define CBOR_UINT 0
+#define CBOR_NEGINT 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_TAG 6
+#define CBOR_SIMPLE 7
+
+#define CBOR_FALSE 0xF4
+#define CBOR_TRUE 0xF5
+#define CBOR_NULL 0xF6
+#define CBOR_FLOAT32 0xFA
+#define CBOR_FLOAT64 0xFB
+#define CBOR_BREAK 0xFF
+
+#define CBOR_MAX_DEPTH 16 // JSON 与 CBOR 的最大嵌套层数
+#define CBOR_UUID_LEN 16
+#define CBOR_KEY_MAX 32   // 超过该长度的键不查字典
+
+// 字典：AT_CODEC_KEY_<name> 为整数键，keyNames 按整数键取回名称
+#define AT_CODEC_KEY_ENUM(n, name) AT_CODEC_KEY_##name = n,
+enum
+{
+  AT_CODEC_CBOR_KEYS(AT_CODEC_KEY_ENUM)
+};
+#define AT_CODEC_KEY_NAME(n, name) [n] = #name,
+static const char *const keyNames[] = {AT_CODEC_CBOR_KEYS(AT_CODEC_KEY_NAME)};
+#define KEY_COUNT (sizeof(keyNames) / sizeof(keyNames[0]))
+
+static int key_lookup(const char *name, size_t len)
+{
+  for (size_t i = 0; i < KEY_COUNT; i++)
+  {
+    if (keyNames[i] && strncmp(keyNames[i], name, len) == 0 && keyNames[i][len] == '\0')
+    {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+// 头部：主类型 + 变长的参数，小于 24 的值直接放在首字节
+static void cbor_head(at_codec_out_t *out, uint8_t major, uint64_t value)
+{
+  uint8_t buf[9];
+  size_t n;
+  if (value < 24)
+  {
+    buf[0] = (uint8_t)(major << 5 | value);
+    n = 1;
+  }
+  else if (value <= 0xFF)
+  {
+    buf[0] = major << 5 | 24;
+    n = 2;
+  }
+  else if (value <= 0xFFFF)
+  {
+    buf[0] = major << 5 | 25;
+    n = 3;
+  }
+  else if (value <= 0xFFFFFFFF)
+  {
+    buf[0] = major << 5 | 26;
+    n = 5;
+  }
+  else
+  {
+    buf[0] = major << 5 | 27;
+    n = 9;
+  }
+  for (size_t i = n - 1; i > 0; i--)
+  {
+    buf[i] = (uint8_t)value;
+    value >>= 8;
+  }
+  at_codec_out_put(out, (const char *)buf, n);
+}
+
+static void cbor_byte(at_codec_out_t *out, uint8_t byte)
+{
+  at_codec_out_put(out, (const char *)&byte, 1);
+}
+
+static int hex_value(char c)
+{
+  if (c >= '0' && c <= '9')
+  {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f')
+  {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F')
+  {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// "6B8B4567-23C6-427B-9869-643C66334873" -> 16 字节
+static bool uuid_parse(const char *str, size_t len, uint8_t *uuid)
+{
+  if (len != 36)
+  {
+    return false;
+  }
+  int n = 0;
+  for (size_t i = 0; i < len; i++)
+  {
+    if (i == 8 || i == 13 || i == 18 || i == 23)
+    {
+      if (str[i] != '-')
+      {
+        return false;
+      }
+      continue;
+    }
+    int hi = hex_value(str[i]);
+    int lo = hex_value(str[++i]);
+    if (hi < 0 || lo < 0)
+    {
+      return false;
+    }
+    uuid[n++] = (uint8_t)(hi << 4 | lo);
+  }
+  return true;
+}
+
+static void cbor_text(at_codec_out_t *out, const char *str, size_t len)
+{
+  cbor_head(out, CBOR_TEXT, len);
+  at_codec_out_put(out, str, len);
+}
+
+// 能无损表示为 float32 时只用 5 字节
+static void cbor_double(at_codec_out_t *out, double value)
+{
+  uint8_t buf[9];
+  float narrow = (float)value;
+  if ((double)narrow == value)
+  {
+    uint32_t bits;
+    memcpy(&bits, &narrow, sizeof(bits));
+    buf[0] = CBOR_FLOAT32;
+    for (int i = 4; i > 0; i--, bits >>= 8)
+    {
+      buf[i] = (uint8_t)bits;
+    }
+    at_codec_out_put(out, (const char *)buf, 5);
+    return;
+  }
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  buf[0] = CBOR_FLOAT64;
+  for (int i = 8; i > 0; i--, bits >>= 8)
+  {
+    buf[i] = (uint8_t)bits;
+  }
+  at_codec_out_put(out, (const char *)buf, 9);
+}
+
+// ---------------- JSON -> CBOR ----------------
+typedef struct
+{
+  const char *p;
+  const char *end;
+  at_codec_out_t *out;
+} json_reader_t;
+
+static void json_ws(json_reader_t *r)
+{
+  while (r->p < r->end && (*r->p == ' ' || *r->p == '\t' || *r->p == '\r' || *r->p == '\n'))
+  {
+    r->p++;
+  }
+}
+
+static void utf8_put(uint32_t cp, char *buf, size_t *n)
+{
+  if (cp < 0x80)
+  {
+    buf[(*n)++] = (char)cp;
+  }
+  else if (cp < 0x800)
+  {
+    buf[(*n)++] = (char)(0xC0 | cp >> 6);
+    buf[(*n)++] = (char)(0x80 | (cp & 0x3F));
+  }
+  else if (cp < 0x10000)
+  {
+    buf[(*n)++] = (char)(0xE0 | cp >> 12);
+    buf[(*n)++] = (char)(0x80 | (cp >> 6 & 0x3F));
+    buf[(*n)++] = (char)(0x80 | (cp & 0x3F));
+  }
+  else
+  {
+    buf[(*n)++] = (char)(0xF0 | cp >> 18);
+    buf[(*n)++] = (char)(0x80 | (cp >> 12 & 0x3F));
+    buf[(*n)++] = (char)(0x80 | (cp >> 6 & 0x3F));
+    buf[(*n)++] = (char)(0x80 | (cp & 0x3F));
+  }
+}
+
+static bool json_hex4(const char *p, const char *end, uint32_t *value)
+{
+  if (end - p < 4)
+  {
+    return false;
+  }
+  *value = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    int h = hex_value(p[i]);
+    if (h < 0)
+    {
+      return false;
+    }
+    *value = *value << 4 | h;
+  }
+  return true;
+}
+
+// 扫描 r->p 处的字符串（含引号），返回去转义后的字节数；out 非 NULL 时同时写出内容。
+// 不需要转义的连续片段整段写出
+static bool json_string(json_reader_t *r, at_codec_out_t *out, size_t *len)
+{
+  const char *p = r->p + 1;
+  const char *run = p;
+  *len = 0;
+  while (p < r->end && *p != '"')
+  {
+    if ((unsigned char)*p < 0x20)
+    {
+      return false;
+    }
+    if (*p != '\\')
+    {
+      p++;
+      continue;
+    }
+    if (out)
+    {
+      at_codec_out_put(out, run, p - run);
+    }
+    *len += p - run;
+    if (++p >= r->end)
+    {
+      return false;
+    }
+    char buf[4];
+    size_t n = 0;
+    switch (*p)
+    {
+    case '"':
+    case '\\':
+    case '/':
+      buf[n++] = *p;
+      break;
+    case 'b':
+      buf[n++] = '\b';
+      break;
+    case 'f':
+      buf[n++] = '\f';
+      break;
+    case 'n':
+      buf[n++] = '\n';
+      break;
+    case 'r':
+      buf[n++] = '\r';
+      break;
+    case 't':
+      buf[n++] = '\t';
+      break;
+    case 'u':
+    {
+      uint32_t cp;
+      if (!json_hex4(p + 1, r->end, &cp))
+      {
+        return false;
+      }
+      p += 4;
+      // 代理对
+      uint32_t low;
+      if (cp >= 0xD800 && cp < 0xDC00 && r->end - p > 6 && p[1] == '\\' && p[2] == 'u' &&
+          json_hex4(p + 3, r->end, &low) && low >= 0xDC00 && low < 0xE000)
+      {
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        p += 6;
+      }
+      utf8_put(cp, buf, &n);
+      break;
+    }
+    default:
+      return false;
+    }
+    if (out)
+    {
+      at_codec_out_put(out, buf, n);
+    }
+    *len += n;
+    run = ++p;
+  }
+  if (p >= r->end)
+  {
+    return false;
+  }
+  if (out)
+  {
+    at_codec_out_put(out, run, p - run);
+  }
+  *len += p - run;
+  r->p = p + 1;
+  return true;
+}
+
+static bool json_value(json_reader_t *r, int depth, int key);
+
+// 输出不定长 array/map，边读边写只走一遍，不用先数出元素个数。
+// 出错时补上 null 与结尾，已写出的部分仍是合法 CBOR
+static bool json_container(json_reader_t *r, int depth, char close)
+{
+  if (depth >= CBOR_MAX_DEPTH)
+  {
+    return false;
+  }
+  cbor_byte(r->out, (close == '}' ? CBOR_MAP : CBOR_ARRAY) << 5 | 31);
+  r->p++;
+  json_ws(r);
+  bool ok = r->p < r->end;
+  if (ok && *r->p == close)
+  {
+    r->p++;
+    cbor_byte(r->out, CBOR_BREAK);
+    return true;
+  }
+  while (ok)
+  {
+    int key = -1;
+    size_t before = r->out->total;
+    if (close == '}')
+    {
+      // 键先去转义到栈上查字典，查不到按文本输出
+      json_reader_t probe = *r;
+      size_t len;
+      if (r->p >= r->end || *r->p != '"' || !json_string(&probe, NULL, &len))
+      {
+        break;
+      }
+      char name[CBOR_KEY_MAX];
+      at_codec_out_t nameOut = {.buf = name, .cap = sizeof(name)};
+      json_reader_t keyReader = *r;
+      if (len <= sizeof(name))
+      {
+        json_string(&keyReader, &nameOut, &len);
+        key = key_lookup(name, len);
+      }
+      if (key >= 0)
+      {
+        cbor_head(r->out, CBOR_UINT, key);
+      }
+      else
+      {
+        cbor_head(r->out, CBOR_TEXT, len);
+        keyReader = *r;
+        json_string(&keyReader, r->out, &len);
+      }
+      r->p = probe.p;
+      json_ws(r);
+      before = r->out->total;
+      ok = r->p < r->end && *r->p++ == ':';
+    }
+    ok = ok && json_value(r, depth + 1, key);
+    if (!ok)
+    {
+      // 值一个字节都没写出时补 null，map 的键值保持成对
+      if (close == '}' && r->out->total == before)
+      {
+        cbor_byte(r->out, CBOR_NULL);
+      }
+      break;
+    }
+    json_ws(r);
+    if (r->p < r->end && *r->p == ',')
+    {
+      r->p++;
+      json_ws(r);
+      continue;
+    }
+    ok = r->p < r->end && *r->p++ == close;
+    break;
+  }
+  cbor_byte(r->out, CBOR_BREAK);
+  return ok;
+}
+
+static bool json_number(json_reader_t *r)
+{
+  const char *start = r->p;
+  bool integer = true;
+  while (r->p < r->end && strchr("+-0123456789.eE", *r->p) != NULL)
+  {
+    if (*r->p == '.' || *r->p == 'e' || *r->p == 'E')
+    {
+      integer = false;
+    }
+    r->p++;
+  }
+  size_t len = r->p - start;
+  if (len == 0 || len > 40)
+  {
+    return false;
+  }
+  if (integer)
+  {
+    bool negative = *start == '-';
+    const char *d = start + negative;
+    uint64_t value = 0;
+    bool overflow = d == r->p;
+    for (; d < r->p && !overflow; d++)
+    {
+      if (*d < '0' || *d > '9' || value > (UINT64_MAX - (*d - '0')) / 10)
+      {
+        overflow = true;
+        break;
+      }
+      value = value * 10 + (*d - '0');
+    }
+    if (!overflow && !(negative && value == 0))
+    {
+      // -n 编码为主类型 1 的 n-1
+      cbor_head(r->out, negative ? CBOR_NEGINT : CBOR_UINT, negative ? value - 1 : value);
+      return true;
+    }
+  }
+  char buf[41];
+  memcpy(buf, start, len);
+  buf[len] = '\0';
+  char *endp;
+  double value = strtod(buf, &endp);
+  if (*endp != '\0')
+  {
+    return false;
+  }
+  cbor_double(r->out, value);
+  return true;
+}
+
+static bool json_literal(json_reader_t *r, const char *word, uint8_t byte)
+{
+  size_t len = strlen(word);
+  if ((size_t)(r->end - r->p) < len || memcmp(r->p, word, len) != 0)
+  {
+    return false;
+  }
+  r->p += len;
+  cbor_byte(r->out, byte);
+  return true;
+}
+
+// key 为所在 map 的字典键，"id" 的 UUID 文本输出为二进制
+static bool json_value(json_reader_t *r, int depth, int key)
+{
+  json_ws(r);
+  if (r->p >= r->end)
+  {
+    return false;
+  }
+  switch (*r->p)
+  {
+  case '{':
+    return json_container(r, depth, '}');
+  case '[':
+    return json_container(r, depth, ']');
+  case '"':
+  {
+    json_reader_t probe = *r;
+    size_t len;
+    if (!json_string(&probe, NULL, &len))
+    {
+      return false;
+    }
+    uint8_t uuid[CBOR_UUID_LEN];
+    // 没有转义时原文即内容，长度为引号之间的字节数
+    if (key == AT_CODEC_KEY_id && len == (size_t)(probe.p - r->p - 2) && uuid_parse(r->p + 1, len, uuid))
+    {
+      cbor_head(r->out, CBOR_BYTES, sizeof(uuid));
+      at_codec_out_put(r->out, (const char *)uuid, sizeof(uuid));
+    }
+    else
+    {
+      cbor_head(r->out, CBOR_TEXT, len);
+      json_string(r, r->out, &len);
+    }
+    r->p = probe.p;
+    return true;
+  }
+  case 't':
+    return json_literal(r, "true", CBOR_TRUE);
+  case 'f':
+    return json_literal(r, "false", CBOR_FALSE);
+  case 'n':
+    return json_literal(r, "null", CBOR_NULL);
+  default:
+    return json_number(r);
+  }
+}
+
+bool at_codec_cbor_from_json(const char *json, size_t len, at_codec_out_t *out)
+{
+  json_reader_t r = {.p = json, .end = json + len, .out = out};
+  if (!json_value(&r, 0, -1))
+  {
+    return false;
+  }
+  json_ws(&r);
+  return r.p == r.end;
+}
+
+// ---------------- 字段表 -> CBOR ----------------
+static void cbor_STR(at_codec_out_t *out, const char *const *value)
+{
+  if (*value == NULL)
+  {
+    cbor_byte(out, CBOR_NULL);
+    return;
+  }
+  cbor_text(out, *value, strlen(*value));
+}
+
+static void cbor_U64(at_codec_out_t *out, const uint64_t *value)
+{
+  cbor_head(out, CBOR_UINT, *value);
+}
+
+static void cbor_EVT(at_codec_out_t *out, const at_codec_event_t *value)
+{
+  cbor_head(out, CBOR_UINT, value->code);
+}
+
+static void cbor_UUID(at_codec_out_t *out, const char *const *value)
+{
+  uint8_t uuid[CBOR_UUID_LEN];
+  if (*value != NULL && uuid_parse(*value, strlen(*value), uuid))
+  {
+    cbor_head(out, CBOR_BYTES, sizeof(uuid));
+    at_codec_out_put(out, (const char *)uuid, sizeof(uuid));
+    return;
+  }
+  cbor_STR(out, value);
+}
+
+// JSON 片段直接转码一遍，不另做校验：不合法时输出已转换的部分，结果确定，计数与写出两遍一致
+static void cbor_RAW(at_codec_out_t *out, const at_codec_raw_t *value)
+{
+  size_t before = out->total;
+  if (value->json == NULL || (!at_codec_cbor_from_json(value->json, value->len, out) && out->total == before))
+  {
+    cbor_byte(out, CBOR_NULL);
+  }
+}
+
+#define AT_CODEC_CBOR_COUNT_FIELD(schema, type, name) +1
+#define AT_CODEC_CBOR_EMIT_FIELD(schema, type, name) \
+  cbor_head(out, CBOR_UINT, AT_CODEC_KEY_##name);    \
+  cbor_##type(out, &value->name);
+
+#define AT_CODEC_CBOR_FUNC_DEF(schema, FIELDS)                                                  \
+  void at_codec_cbor_emit_##schema(const at_codec_##schema##_t *value, at_codec_out_t *out)     \
+  {                                                                                             \
+    cbor_head(out, CBOR_MAP, 0 FIELDS(AT_CODEC_CBOR_COUNT_FIELD));                              \
+    FIELDS(AT_CODEC_CBOR_EMIT_FIELD)                                                            \
+  }                                                                                             \
+  size_t at_codec_cbor_size_##schema(const at_codec_##schema##_t *value)                         \
+  {                                                                                             \
+    at_codec_out_t out = {0};                                                                   \
+    at_codec_cbor_emit_##schema(value, &out);                                                   \
+    return out.total;                                                                           \
+  }                                                                                             \
+  size_t at_codec_cbor_encode_##schema(const at_codec_##schema##_t *value, void *buf, size_t cap) \
+  {                                                                                             \
+    at_codec_out_t out = {.buf = buf, .cap = cap};                                              \
+    at_codec_cbor_emit_##schema(value, &out);                                                   \
+    return out.total;                                                                           \
+  }
+AT_CODEC_SCHEMAS(AT_CODEC_CBOR_FUNC_DEF)
+
+// ---------------- CBOR -> JSON ----------------
+typedef struct
+{
+  const uint8_t *p;
+  const uint8_t *end;
+  at_codec_out_t *out;
+  const char *const *events;
+  size_t eventCount;
+} cbor_reader_t;
+
+// 读出头部；info 为 31 时是不定长，value 无意义
+static bool cbor_read_head(cbor_reader_t *r, uint8_t *major, uint8_t *info, uint64_t *value)
+{
+  if (r->p >= r->end)
+  {
+    return false;
+  }
+  *major = *r->p >> 5;
+  *info = *r->p & 0x1F;
+  r->p++;
+  *value = *info;
+  if (*info < 24 || *info == 31)
+  {
+    return true;
+  }
+  if (*info > 27)
+  {
+    return false;
+  }
+  size_t n = (size_t)1 << (*info - 24);
+  if ((size_t)(r->end - r->p) < n)
+  {
+    return false;
+  }
+  *value = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    *value = *value << 8 | *r->p++;
+  }
+  return true;
+}
+
+static void cbor_put_double(at_codec_out_t *out, double value, int digits)
+{
+  // NaN 与无穷在 JSON 中没有表示
+  if (value != value || value - value != 0)
+  {
+    at_codec_out_put(out, "null", 4);
+    return;
+  }
+  char buf[32];
+  int n = snprintf(buf, sizeof(buf), "%.*g", digits, value);
+  at_codec_out_put(out, buf, n);
+}
+
+static double half_to_double(uint16_t half)
+{
+  int exp = half >> 10 & 0x1F;
+  int mant = half & 0x3FF;
+  double value;
+  if (exp == 0)
+  {
+    value = mant / 16777216.0; // mant * 2^-24
+  }
+  else if (exp != 31)
+  {
+    value = (mant + 1024) / 1024.0;
+    for (int e = exp - 15; e > 0; e--)
+    {
+      value *= 2;
+    }
+    for (int e = exp - 15; e < 0; e++)
+    {
+      value /= 2;
+    }
+  }
+  else
+  {
+    value = mant == 0 ? 1.0 / 0.0 : 0.0 / 0.0;
+  }
+  return half & 0x8000 ? -value : value;
+}
+
+static void cbor_put_uuid(at_codec_out_t *out, const uint8_t *uuid)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  char text[38];
+  size_t n = 0;
+  text[n++] = '"';
+  for (int i = 0; i < CBOR_UUID_LEN; i++)
+  {
+    if (i == 4 || i == 6 || i == 8 || i == 10)
+    {
+      text[n++] = '-';
+    }
+    text[n++] = hex[uuid[i] >> 4];
+    text[n++] = hex[uuid[i] & 0xF];
+  }
+  text[n++] = '"';
+  at_codec_out_put(out, text, n);
+}
+
+static bool cbor_item(cbor_reader_t *r, int depth, int key);
+
+static bool cbor_container(cbor_reader_t *r, int depth, bool map, uint8_t info, uint64_t count)
+{
+  if (depth >= CBOR_MAX_DEPTH)
+  {
+    return false;
+  }
+  bool indefinite = info == 31;
+  at_codec_out_put(r->out, map ? "{" : "[", 1);
+  for (uint64_t i = 0; indefinite || i < count; i++)
+  {
+    if (indefinite && r->p < r->end && *r->p == CBOR_BREAK)
+    {
+      r->p++;
+      break;
+    }
+    if (i > 0)
+    {
+      at_codec_out_put(r->out, ",", 1);
+    }
+    int key = -1;
+    if (map)
+    {
+      uint8_t major, keyInfo;
+      uint64_t value;
+      if (!cbor_read_head(r, &major, &keyInfo, &value))
+      {
+        return false;
+      }
+      if (major == CBOR_UINT)
+      {
+        key = value < KEY_COUNT && keyNames[value] ? (int)value : -1;
+        if (key >= 0)
+        {
+          at_codec_out_string(r->out, keyNames[key]);
+        }
+        else
+        {
+          // 字典之外的整数键按数字文本输出
+          at_codec_out_put(r->out, "\"", 1);
+          at_codec_out_u64(r->out, value);
+          at_codec_out_put(r->out, "\"", 1);
+        }
+      }
+      else if (major == CBOR_TEXT && keyInfo != 31 && value <= (uint64_t)(r->end - r->p))
+      {
+        at_codec_out_string_len(r->out, (const char *)r->p, value);
+        key = key_lookup((const char *)r->p, value);
+        r->p += value;
+      }
+      else
+      {
+        return false;
+      }
+      at_codec_out_put(r->out, ":", 1);
+    }
+    if (!cbor_item(r, depth + 1, key))
+    {
+      return false;
+    }
+  }
+  at_codec_out_put(r->out, map ? "}" : "]", 1);
+  return true;
+}
+
+static bool cbor_item(cbor_reader_t *r, int depth, int key)
+{
+  uint8_t major, info;
+  uint64_t value;
+  // 标签链也计入层数，恶意输入不能无限递归
+  if (depth >= CBOR_MAX_DEPTH)
+  {
+    return false;
+  }
+  if (!cbor_read_head(r, &major, &info, &value))
+  {
+    return false;
+  }
+  switch (major)
+  {
+  case CBOR_UINT:
+    if (key == AT_CODEC_KEY_event && r->events && value < r->eventCount && r->events[value])
+    {
+      at_codec_out_string(r->out, r->events[value]);
+      return true;
+    }
+    at_codec_out_u64(r->out, value);
+    return true;
+  case CBOR_NEGINT:
+    at_codec_out_put(r->out, "-", 1);
+    if (value == UINT64_MAX)
+    {
+      at_codec_out_put(r->out, "18446744073709551616", 20);
+      return true;
+    }
+    at_codec_out_u64(r->out, value + 1);
+    return true;
+  case CBOR_BYTES:
+  case CBOR_TEXT:
+  {
+    // 不支持分块的不定长字符串
+    if (info == 31 || value > (uint64_t)(r->end - r->p))
+    {
+      return false;
+    }
+    const uint8_t *data = r->p;
+    r->p += value;
+    if (major == CBOR_TEXT)
+    {
+      at_codec_out_string_len(r->out, (const char *)data, value);
+    }
+    else if (value == CBOR_UUID_LEN)
+    {
+      cbor_put_uuid(r->out, data);
+    }
+    else
+    {
+      // 其余二进制输出为十六进制文本
+      static const char hex[] = "0123456789abcdef";
+      at_codec_out_put(r->out, "\"", 1);
+      for (uint64_t i = 0; i < value; i++)
+      {
+        char pair[2] = {hex[data[i] >> 4], hex[data[i] & 0xF]};
+        at_codec_out_put(r->out, pair, 2);
+      }
+      at_codec_out_put(r->out, "\"", 1);
+    }
+    return true;
+  }
+  case CBOR_ARRAY:
+  case CBOR_MAP:
+    return cbor_container(r, depth, major == CBOR_MAP, info, value);
+  case CBOR_TAG:
+    // 标签只是语义提示，直接输出被标记的值
+    return cbor_item(r, depth + 1, key);
+  default:
+    break;
+  }
+  // 主类型 7：简单值与浮点
+  switch (info)
+  {
+  case 20:
+    at_codec_out_put(r->out, "false", 5);
+    return true;
+  case 21:
+    at_codec_out_put(r->out, "true", 4);
+    return true;
+  case 22:
+  case 23:
+    at_codec_out_put(r->out, "null", 4);
+    return true;
+  case 25:
+    cbor_put_double(r->out, half_to_double((uint16_t)value), 5);
+    return true;
+  case 26:
+  {
+    uint32_t bits = (uint32_t)value;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    cbor_put_double(r->out, f, 9);
+    return true;
+  }
+  case 27:
+  {
+    double d;
+    memcpy(&d, &value, sizeof(d));
+    cbor_put_double(r->out, d, 17);
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+bool at_codec_cbor_to_json(const void *cbor, size_t len, at_codec_out_t *out, const char *const *events, size_t eventCount)
+{
+  cbor_reader_t r = {
+      .p = cbor,
+      .end = (const uint8_t *)cbor + len,
+      .out = out,
+      .events = events,
+      .eventCount = eventCount,
+  };
+  return cbor_item(&r, 0, -1) && r.p == r.end;
+}
+
+bool at_codec_is_cbor(const void *data, size_t len)
+{
+  if (len == 0)
+  {
+    return false;
+  }
+  uint8_t major = *(const uint8_t *)data >> 5;
+  return major == CBOR_ARRAY || major == CBOR_MAP;
+}
@@ -0,0 +1,98 @@
+#ifndef AT_CODEC_SCHEMA_H
+#define AT_CODEC_SCHEMA_H
+
+// 固定报文的字段表，F(schema, 类型, 字段名)，顺序即输出顺序
+// 类型：STR 字符串(转义) / U64 无符号整数 / RAW 已编码好的 JSON 片段 /
+//       EVT 事件（JSON 为名称，CBOR 为编号）/ UUID 文本 UUID（CBOR 为 16 字节二进制）
+
+// MQ 信封，对应 mqMessage_t（topic 走 AT 命令，不进报文）
+#define AT_CODEC_SCHEMA_ENVELOPE(F) \
+  F(envelope, RAW, data)            \
+  F(envelope, EVT, event)           \
+  F(envelope, UUID, id)             \
+  F(envelope, U64, time)            \
+  F(envelope, U64, ttl)
+
+// 设备注册 /platform/<username>/regist
+#define AT_CODEC_SCHEMA_REGIST(F) \
+  F(regist, STR, deviceId)        \
+  F(regist, STR, deviceName)      \
+  F(regist, STR, deviceCate)      \
+  F(regist, STR, mqttUserName)    \
+  F(regist, STR, projectInfoCode)
+
+// 心跳 /device/<clientId>/ping
+#define AT_CODEC_SCHEMA_PING(F) \
+  F(ping, STR, deviceId)        \
+  F(ping, STR, projectInfoCode)
+
+// 单个 AT 动词的统计，hist 为 log2 毫秒桶的计数数组
+#define AT_CODEC_SCHEMA_METRIC(F) \
+  F(metric, STR, verb)            \
+  F(metric, U64, count)           \
+  F(metric, U64, ok)              \
+  F(metric, U64, error)           \
+  F(metric, U64, timeout)         \
+  F(metric, U64, tx)              \
+  F(metric, U64, rx)              \
+  F(metric, U64, p50)             \
+  F(metric, U64, p99)             \
+  F(metric, U64, max)             \
+  F(metric, RAW, hist)
+
+// 遥测 /device/<clientId>/telemetry，commands 为 metric 数组；
+// json* 为 cJSON 池的块数与 arena 字节高水位，以及退回系统堆的次数
+#define AT_CODEC_SCHEMA_TELEMETRY(F) \
+  F(telemetry, U64, interval)        \
+  F(telemetry, U64, baud)            \
+  F(telemetry, U64, rxDropped)       \
+  F(telemetry, U64, jsonBlocks)      \
+  F(telemetry, U64, jsonArena)       \
+  F(telemetry, U64, jsonHeap)        \
+  F(telemetry, RAW, commands)
+
+// CBOR 键字典：JSON 键名与 CBOR 整数键一一对应，服务端按同一张表解码。
+// 编号一经发布不可改动，新键只能追加；0~23 编码为 1 字节，留给最常出现的键。
+// 字段表中的每个字段名都必须在此出现，转码 JSON 时不在表中的键按原文保留
+#define AT_CODEC_CBOR_KEYS(K) \
+  K(0, data)                  \
+  K(1, event)                 \
+  K(2, id)                    \
+  K(3, time)                  \
+  K(4, ttl)                   \
+  K(5, deviceId)              \
+  K(6, deviceName)            \
+  K(7, deviceCate)            \
+  K(8, mqttUserName)          \
+  K(9, projectInfoCode)       \
+  K(10, Status)               \
+  K(11, Msg)                  \
+  K(12, message)              \
+  K(13, verb)                 \
+  K(14, count)                \
+  K(15, ok)                   \
+  K(16, error)                \
+  K(17, timeout)              \
+  K(18, tx)                   \
+  K(19, rx)                   \
+  K(20, p50)                  \
+  K(21, p99)                  \
+  K(22, max)                  \
+  K(23, hist)                 \
+  K(24, interval)             \
+  K(25, baud)                 \
+  K(26, rxDropped)            \
+  K(27, jsonBlocks)           \
+  K(28, jsonArena)            \
+  K(29, jsonHeap)             \
+  K(30, commands)
+
+// 所有报文，S(schema, 字段表)
+#define AT_CODEC_SCHEMAS(S)                 \
+  S(envelope, AT_CODEC_SCHEMA_ENVELOPE)     \
+  S(regist, AT_CODEC_SCHEMA_REGIST)         \
+  S(ping, AT_CODEC_SCHEMA_PING)             \
+  S(metric, AT_CODEC_SCHEMA_METRIC)         \
+  S(telemetry, AT_CODEC_SCHEMA_TELEMETRY)
+
+#endif
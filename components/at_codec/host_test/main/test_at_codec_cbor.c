@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "at_codec.h"
+
+// CBOR 编解码的主机侧测试：畸形、截断、深层嵌套与标签链输入都应返回 false 而不越界，
+// JSON -> CBOR -> JSON 往返保持内容
+
+#define TEST_BUF_SIZE 1024
+#define TEST_DEPTH 16 // 与 at_codec_cbor.c 中的 CBOR_MAX_DEPTH 一致
+
+static const char *const events[] = {"online", "ping", "registDevice"};
+static uint8_t cbor[TEST_BUF_SIZE];
+static char json[TEST_BUF_SIZE];
+
+// JSON 转 CBOR，返回是否合法，*len 为写出的字节数
+static bool from_json(const char *text, size_t *len)
+{
+  at_codec_out_t out = {.buf = (char *)cbor, .cap = sizeof(cbor)};
+  bool ok = at_codec_cbor_from_json(text, strlen(text), &out);
+  TEST_ASSERT_LESS_OR_EQUAL(sizeof(cbor), out.total);
+  *len = out.total;
+  return ok;
+}
+
+// CBOR 转 JSON，结果以 0 结尾放在 json 中
+static bool to_json(const uint8_t *data, size_t len)
+{
+  at_codec_out_t out = {.buf = json, .cap = sizeof(json) - 1};
+  bool ok = at_codec_cbor_to_json(data, len, &out, events, sizeof(events) / sizeof(events[0]));
+  json[out.pos] = '\0';
+  return ok;
+}
+
+static void round_trip(const char *in, const char *expected)
+{
+  size_t len;
+  TEST_ASSERT_TRUE_MESSAGE(from_json(in, &len), in);
+  TEST_ASSERT_TRUE_MESSAGE(to_json(cbor, len), in);
+  TEST_ASSERT_EQUAL_STRING(expected, json);
+}
+
+static void test_round_trip(void)
+{
+  round_trip("{\"a\":[1,-1,-24,-25,0,255,256,65536,4294967296,18446744073709551615,-9223372036854775808,1.5],"
+             "\"b\":true,\"c\":null,\"d\":false}",
+             "{\"a\":[1,-1,-24,-25,0,255,256,65536,4294967296,18446744073709551615,-9223372036854775808,1.5],"
+             "\"b\":true,\"c\":null,\"d\":false}");
+  round_trip("{\"s\":\"tab\\t\\\"q\\\" \\u00e9\\ud83d\\ude00 \\/\",\"x\":{},\"y\":[],\"z\":[[[]]]}",
+             "{\"s\":\"tab\\t\\\"q\\\" \xc3\xa9\xf0\x9f\x98\x80 /\",\"x\":{},\"y\":[],\"z\":[[[]]]}");
+  // 字典中的键、event 编号与 id 的 UUID 都还原为原文
+  round_trip(" [ 1 , { \"event\" : 2 , \"id\" : \"6B8B4567-23C6-427B-9869-643C66334873\" } ] ",
+             "[1,{\"event\":\"registDevice\",\"id\":\"6B8B4567-23C6-427B-9869-643C66334873\"}]");
+  round_trip("{\"id\":\"not-a-uuid\",\"ttl\":5000}", "{\"id\":\"not-a-uuid\",\"ttl\":5000}");
+  // JSON 中没有 NaN 与无穷
+  round_trip("[1e400]", "[null]");
+}
+
+static void test_envelope_round_trip(void)
+{
+  static const char data[] = "{\"deviceId\":\"89860412102070123456\",\"projectInfoCode\":\"PJ202406050002\"}";
+  at_codec_envelope_t env = {
+      .data = {data, sizeof(data) - 1},
+      .event = {"ping", 1},
+      .id = "6B8B4567-23C6-427B-9869-643C66334873",
+      .time = 1737008394298ULL,
+      .ttl = 5000,
+  };
+  size_t len = at_codec_cbor_encode_envelope(&env, cbor, sizeof(cbor));
+  TEST_ASSERT_EQUAL(at_codec_cbor_size_envelope(&env), len);
+  TEST_ASSERT_TRUE(at_codec_is_cbor(cbor, len));
+  TEST_ASSERT_TRUE(to_json(cbor, len));
+  TEST_ASSERT_EQUAL_STRING("{\"data\":{\"deviceId\":\"89860412102070123456\",\"projectInfoCode\":\"PJ202406050002\"},"
+                           "\"event\":\"ping\",\"id\":\"6B8B4567-23C6-427B-9869-643C66334873\","
+                           "\"time\":1737008394298,\"ttl\":5000}",
+                           json);
+}
+
+static void test_malformed_json(void)
+{
+  // 不合法的 JSON 返回 false，已写出的部分仍能解码
+  static const char *const inputs[] = {"{\"a\":1,}", "{\"a\" 1}", "[1 2]", "\"unterminated", "01x", "{bad", "[", "{\"a\":",
+                                       "[tru]", "{\"a\":[1,{\"b\":}]}"};
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+  {
+    size_t len;
+    TEST_ASSERT_FALSE_MESSAGE(from_json(inputs[i], &len), inputs[i]);
+    if (len > 0)
+    {
+      TEST_ASSERT_TRUE_MESSAGE(to_json(cbor, len), inputs[i]);
+    }
+  }
+}
+
+static void test_malformed_cbor(void)
+{
+  static const struct
+  {
+    const char *name;
+    uint8_t data[8];
+    size_t len;
+  } cases[] = {
+      {"empty", {0}, 0},
+      {"reserved info", {0x1C}, 1},
+      {"reserved simple", {0xFC}, 1},
+      {"break at top", {0xFF}, 1},
+      {"indefinite text", {0x7F, 0x61, 'a', 0xFF}, 4},
+      {"text past end", {0x65, 'a', 'b'}, 3},
+      {"huge length", {0x7B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, 8},
+      {"array key", {0xA1, 0x80, 0x01}, 3},
+      {"missing value", {0xA1, 0x01}, 2},
+      {"missing break", {0x9F, 0x01, 0x02}, 3},
+      {"short array", {0x83, 0x01, 0x02}, 3},
+      {"trailing byte", {0x01, 0x02}, 2},
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+  {
+    TEST_ASSERT_FALSE_MESSAGE(to_json(cases[i].data, cases[i].len), cases[i].name);
+  }
+}
+
+static void test_truncated_cbor(void)
+{
+  size_t len;
+  TEST_ASSERT_TRUE(from_json("{\"event\":1,\"id\":\"6B8B4567-23C6-427B-9869-643C66334873\",\"a\":[1.5,0.1,\"text\",-300]}",
+                             &len));
+  // 每个前缀都不完整，只读到 len 为止
+  for (size_t n = 0; n < len; n++)
+  {
+    uint8_t *copy = malloc(n > 0 ? n : 1);
+    memcpy(copy, cbor, n);
+    TEST_ASSERT_FALSE(to_json(copy, n));
+    free(copy);
+  }
+  TEST_ASSERT_TRUE(to_json(cbor, len));
+}
+
+static void test_deep_nesting(void)
+{
+  static uint8_t deep[4096];
+  // TEST_DEPTH 层空数组可以还原，再多一层返回 false
+  memset(deep, 0x81, TEST_DEPTH - 1);
+  deep[TEST_DEPTH - 1] = 0x80;
+  TEST_ASSERT_TRUE(to_json(deep, TEST_DEPTH));
+  memset(deep, 0x81, TEST_DEPTH);
+  deep[TEST_DEPTH] = 0x80;
+  TEST_ASSERT_FALSE(to_json(deep, TEST_DEPTH + 1));
+  memset(deep, 0x9F, sizeof(deep));
+  TEST_ASSERT_FALSE(to_json(deep, sizeof(deep)));
+
+  char text[2 * TEST_DEPTH + 3];
+  memset(text, '[', TEST_DEPTH);
+  memset(text + TEST_DEPTH, ']', TEST_DEPTH);
+  text[2 * TEST_DEPTH] = '\0';
+  size_t len;
+  TEST_ASSERT_TRUE(from_json(text, &len));
+  memset(text, '[', TEST_DEPTH + 1);
+  memset(text + TEST_DEPTH + 1, ']', TEST_DEPTH + 1);
+  text[2 * TEST_DEPTH + 2] = '\0';
+  TEST_ASSERT_FALSE(from_json(text, &len));
+  TEST_ASSERT_TRUE(to_json(cbor, len));
+}
+
+static void test_tag_chain(void)
+{
+  // 标签被跳过，只输出被标记的值
+  static const uint8_t tagged[] = {0xC1, 0x1A, 0x65, 0x53, 0xF1, 0x00};
+  TEST_ASSERT_TRUE(to_json(tagged, sizeof(tagged)));
+  TEST_ASSERT_EQUAL_STRING("1700000000", json);
+
+  static uint8_t chain[100000];
+  memset(chain, 0xC1, sizeof(chain) - 1);
+  chain[sizeof(chain) - 1] = 0x01;
+  TEST_ASSERT_FALSE(to_json(chain + sizeof(chain) - TEST_DEPTH - 1, TEST_DEPTH + 1));
+  TEST_ASSERT_TRUE(to_json(chain + sizeof(chain) - TEST_DEPTH, TEST_DEPTH));
+  TEST_ASSERT_FALSE(to_json(chain, sizeof(chain)));
+}
+
+void app_main(void)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_envelope_round_trip);
+  RUN_TEST(test_malformed_json);
+  RUN_TEST(test_malformed_cbor);
+  RUN_TEST(test_truncated_cbor);
+  RUN_TEST(test_deep_nesting);
+  RUN_TEST(test_tag_chain);
+  exit(UNITY_END());
+}
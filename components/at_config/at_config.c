@@ -25,6 +25,22 @@ char *deviceCateOptionStrings[] = {
     "Elevator",
 };
 
+typedef enum
+{
+  MQ_ENCODING_JSON,
+  MQ_ENCODING_CBOR,
+} mqEncoding_t;
+
+// 各设备类别的默认报文编码，蜂窝上行按流量计费的类别使用 CBOR
+static const mqEncoding_t deviceCateEncodings[] = {
+    MQ_ENCODING_JSON, // Consumer
+    MQ_ENCODING_JSON, // GateWay
+    MQ_ENCODING_CBOR, // Door
+    MQ_ENCODING_CBOR, // GateDoor
+    MQ_ENCODING_CBOR, // SmartLock
+    MQ_ENCODING_CBOR, // Elevator
+};
+
 typedef struct
 {
   char *server;
@@ -58,6 +74,15 @@ char *getDeviceCateString(const deviceCateEnum option)
   return "Invalid Option";
 }
 
+mqEncoding_t getDeviceCateEncoding(const deviceCateEnum option)
+{
+  if (option >= Consumer && option <= Elevator)
+  {
+    return deviceCateEncodings[option];
+  }
+  return MQ_ENCODING_JSON;
+}
+
 typedef enum
 {
   Online,
@@ -67,6 +92,7 @@ typedef enum
   ServerTime,
   SystemTime,
   Offline,
+  Telemetry,
 } eventEnum;
 
 char *eventOptionStrings[] = {
@@ -77,6 +103,7 @@ char *eventOptionStrings[] = {
     "ServerTime",
     "systemTime",
     "offline",
+    "telemetry",
 };
 
 typedef struct
@@ -84,6 +111,7 @@ typedef struct
   char *topic;
   char *id;
   cJSON *data;
+  const char *rawData;
   eventEnum event;
   uint64_t time;
   uint64_t ttl;
@@ -91,7 +119,7 @@ typedef struct
 
 char *getEventString(const eventEnum option)
 {
-  if (option >= Online && option <= Offline)
+  if (option >= Online && option <= Telemetry)
   {
     return eventOptionStrings[option];
   }
@@ -108,7 +136,7 @@ bool validateMqMessage(const mqMessage_t *message)
   // 校验每个字段是否为空
   return message->topic &&
          message->id &&
-         message->data &&
+         (message->data || message->rawData) &&
          message->time &&
          message->ttl;
 }
@@ -16,6 +16,14 @@ typedef enum
   NONE,
 } deviceCateEnum;
 
+// MQ 报文的线上编码：JSON 文本，或 CBOR（整数键、事件编号、16 字节 id），
+// 按流量计费的链路上 CBOR 约为 JSON 的一半
+typedef enum
+{
+  MQ_ENCODING_JSON,
+  MQ_ENCODING_CBOR,
+} mqEncoding_t;
+
 typedef struct
 {
   char *server;
@@ -34,6 +42,7 @@ typedef enum
   ServerTime,
   SystemTime,
   Offline,
+  Telemetry,
 } eventEnum;
 
 typedef struct
@@ -41,6 +50,7 @@ typedef struct
   char *topic;
   char *id;
   cJSON *data;
+  const char *rawData; // 已编码好的 data JSON，非 NULL 时代替 data
   eventEnum event;
   uint64_t time;
   uint64_t ttl;
@@ -50,5 +60,6 @@ bool validateMqConfig(const mqConfig_t *config);
 bool validateMqMessage(const mqMessage_t *message);
 char *getEventString(const eventEnum option);
 char *getDeviceCateString(const deviceCateEnum option);
+mqEncoding_t getDeviceCateEncoding(const deviceCateEnum option);
 
 #endif
\ No newline at end of file
@@ -4,267 +4,678 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include "freertos/FreeRTOS.h"
-#include "cJSON.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/timers.h"
+#include "esp_timer.h"
 #include "at_config.h"
+#include "at_http.h"
+#include "at_task.h"
 
 static char *TAG = "HTTP";
 
-bool close()
+// ---------------- HTTP 会话 ----------------
+// HTTP 服务在请求之间保持初始化，参数只在与模组上的当前值不同时才重新设置；
+// 空闲超时或出错时才 HTTPTERM
+typedef enum
 {
-  // 终止 HTTP 会话
-  if (!at_send_command("AT+HTTPTERM", "OK", 10000, NULL, false))
+  HTTP_PARAM_URL,
+  HTTP_PARAM_CONTENT,
+  HTTP_PARAM_USERDATA,
+  HTTP_PARAM_COUNT,
+} http_param_t;
+
+static const char *const httpParamKeys[HTTP_PARAM_COUNT] = {"URL", "CONTENT", "USERDATA"};
+
+typedef struct
+{
+  SemaphoreHandle_t lock; // 同一时间只有一个请求使用会话
+  TimerHandle_t idleTimer;
+  bool inited;
+  bool paramSet[HTTP_PARAM_COUNT];
+  char params[HTTP_PARAM_COUNT][AT_HTTP_PARAM_MAX]; // 模组上的当前值
+  // 持有 lock 的请求使用的暂存区，不占调用者的栈
+  char userdata[AT_HTTP_PARAM_MAX];
+  char command[UART_BUF_SIZE];
+  char response[UART_BUF_SIZE];
+} http_session_t;
+
+#define HTTP_IDLE_RETRY_MS 1000 // 空闲关闭提交失败后的重试间隔
+
+static http_session_t session;
+static uint32_t idleTimeoutMs = AT_HTTP_IDLE_TIMEOUT_MS;
+
+static void http_session_term()
+{
+  if (!at_send_command_on(AT_CHAN_DATA, "AT+HTTPTERM", "OK", 10000, NULL))
   {
     ESP_LOGW(TAG, "Failed to terminate HTTP session");
-    // 终止任务或返回错误
-    return false;
   }
+  session.inited = false;
+}
 
-  vTaskDelay(pdMS_TO_TICKS(3000));
+// 定时器任务中调用，不可阻塞：会话正在使用时跳过，HTTPTERM 异步提交且不等通道；
+// 通道正被其他提交者占用时保留会话，稍后重试
+static void http_idle_cb(TimerHandle_t timer)
+{
+  if (xSemaphoreTake(session.lock, 0) != pdTRUE)
+  {
+    return;
+  }
+  if (session.inited)
+  {
+    ESP_LOGI(TAG, "HTTP session idle, terminating");
+    at_cmd_t cmd = {
+        .command = "AT+HTTPTERM",
+        .expected = "OK",
+        .timeout_ms = 10000,
+        .submit_wait_ms = 0,
+        .channel = AT_CHAN_DATA,
+    };
+    if (at_submit(&cmd))
+    {
+      session.inited = false;
+    }
+    else
+    {
+      xTimerChangePeriod(timer, pdMS_TO_TICKS(HTTP_IDLE_RETRY_MS), 0);
+    }
+  }
+  xSemaphoreGive(session.lock);
+}
 
+// 会话对象由 at_http_init 创建，之前的调用直接失败
+static bool http_session_ready()
+{
+  if (session.lock == NULL)
+  {
+    ESP_LOGE(TAG, "HTTP not initialized, call at_http_init first");
+    return false;
+  }
   return true;
 }
 
-bool at_http_get(const char *path)
+static bool http_init_service()
 {
-  if (path == NULL || strlen(path) == 0)
+  if (at_send_command_on(AT_CHAN_DATA, "AT+HTTPINIT", "OK", 5000, NULL))
   {
-    ESP_LOGE(TAG, "Invalid path");
-    return false;
+    return true;
   }
-  char response[UART_BUF_SIZE];
-  int method, status_code, data_len;
+  // 模组上可能还留着上次（例如本机重启前）的会话
+  ESP_LOGW(TAG, "HTTPINIT failed, terminating stale session and retrying");
+  at_send_command_on(AT_CHAN_DATA, "AT+HTTPTERM", "OK", 10000, NULL);
+  return at_send_command_on(AT_CHAN_DATA, "AT+HTTPINIT", "OK", 5000, NULL);
+}
 
-  // 基本检查
-  if (!at_check_base())
+// 取得会话，必要时初始化 HTTP 服务；失败时不持有会话
+static bool http_session_open()
+{
+  if (!http_session_ready())
+  {
     return false;
-  // PDP 检查
-  if (!at_check_pdp())
+  }
+  xSemaphoreTake(session.lock, portMAX_DELAY);
+  xTimerStop(session.idleTimer, 0);
+  // 基本检查与 PDP 检查，状态缓存有效时不发送命令
+  if (!at_check_base() || !at_check_pdp())
+  {
+    xSemaphoreGive(session.lock);
     return false;
+  }
+  if (session.inited)
+  {
+    return true;
+  }
   // 初始化 HTTP
-  if (!at_send_command("AT+HTTPINIT", "OK", 5000, NULL, false))
+  if (!http_init_service())
   {
     ESP_LOGE(TAG, "Failed to initialize HTTP");
+    xSemaphoreGive(session.lock);
     return false;
   }
-  // 设置 PDP 上下文为 CID 1
-  if (!at_send_command("AT+HTTPPARA=\"CID\",1", "OK", 3000, NULL, false))
+  // 绑定承载，如 SIM800 的 CID 1；原生 PDP 的模组不需要
+  const char *bearer = at_uart_dialect()->http_bearer;
+  if (bearer != NULL && !at_send_command_on(AT_CHAN_DATA, bearer, "OK", 3000, NULL))
   {
     ESP_LOGE(TAG, "Failed to set HTTP CID");
-    close();
+    http_session_term();
+    xSemaphoreGive(session.lock);
     return false;
   }
-  // 设置目标URL
-  char url[256];
-  snprintf(url, sizeof(url), "AT+HTTPPARA=\"URL\",\"%s\"", path);
-  if (!at_send_command(url, "OK", 15000, NULL, false))
+  session.inited = true;
+  memset(session.paramSet, 0, sizeof(session.paramSet));
+  // HTTPINIT 之后没有自定义请求头
+  session.params[HTTP_PARAM_USERDATA][0] = '\0';
+  session.paramSet[HTTP_PARAM_USERDATA] = true;
+  return true;
+}
+
+// 参数与模组上的当前值相同则跳过
+static bool http_session_param(http_param_t param, const char *value)
+{
+  if (session.paramSet[param] && strcmp(session.params[param], value) == 0)
+  {
+    return true;
+  }
+  if (strlen(value) >= AT_HTTP_PARAM_MAX)
   {
-    ESP_LOGE(TAG, "Failed to set HTTP URL");
-    close();
+    ESP_LOGE(TAG, "HTTP %s too long", httpParamKeys[param]);
     return false;
   }
-  // 执行 HTTP GET
-  if (!at_send_command("AT+HTTPACTION=0", "+HTTPACTION:", 3000, response, false))
+  char *command = session.command;
+  if (snprintf(command, sizeof(session.command), "AT+HTTPPARA=\"%s\",\"%s\"", httpParamKeys[param], value) >= (int)sizeof(session.command))
   {
-    ESP_LOGE(TAG, "HTTP GET action failed");
-    close();
+    ESP_LOGE(TAG, "HTTP %s too long", httpParamKeys[param]);
     return false;
   }
-  if (strlen(response) == 0)
+  session.paramSet[param] = false;
+  if (!at_send_command_on(AT_CHAN_DATA, command, "OK", 15000, NULL))
   {
-    ESP_LOGE(TAG, "Empty response received for HTTPACTION");
-    close();
+    ESP_LOGE(TAG, "Failed to set HTTP %s", httpParamKeys[param]);
     return false;
   }
-  if (strstr(response, "+HTTPACTION:") != NULL)
+  strcpy(session.params[param], value);
+  session.paramSet[param] = true;
+  return true;
+}
+
+// 请求出错：模组上的 HTTP 状态不可信，终止会话，下次请求重新初始化
+static bool http_session_fail()
+{
+  http_session_term();
+  xSemaphoreGive(session.lock);
+  return false;
+}
+
+// 请求结束（包括非 200 的应答），保留会话并重新开始空闲计时
+static bool http_session_done(bool ok)
+{
+  xTimerChangePeriod(session.idleTimer, pdMS_TO_TICKS(idleTimeoutMs), 0);
+  xSemaphoreGive(session.lock);
+  return ok;
+}
+
+void at_http_set_idle_timeout(uint32_t timeout_ms)
+{
+  idleTimeoutMs = timeout_ms > 0 ? timeout_ms : AT_HTTP_IDLE_TIMEOUT_MS;
+}
+
+void at_http_session_close()
+{
+  if (!http_session_ready())
   {
-    // ESP_LOGI(TAG, "HTTPACTION response: %s", response);
-    char *action_start = strstr(response, "+HTTPACTION:");
-    if (action_start)
+    return;
+  }
+  xSemaphoreTake(session.lock, portMAX_DELAY);
+  xTimerStop(session.idleTimer, 0);
+  if (session.inited)
+  {
+    http_session_term();
+  }
+  xSemaphoreGive(session.lock);
+}
+
+// 一块响应体缓冲区，对应一条在途的 AT+HTTPREAD
+typedef struct
+{
+  uint8_t *buf;
+  size_t cap;
+  size_t len;
+  bool ok;
+  SemaphoreHandle_t done;
+  StaticSemaphore_t doneBuf;
+} http_chunk_t;
+
+// 引擎任务中调用，只做拷贝
+static void http_chunk_data(const void *data, size_t len, void *ctx)
+{
+  http_chunk_t *chunk = ctx;
+  size_t room = chunk->cap - chunk->len;
+  if (len > room)
+  {
+    len = room;
+  }
+  memcpy(chunk->buf + chunk->len, data, len);
+  chunk->len += len;
+}
+
+static void http_chunk_done(const at_result_t *result, void *ctx)
+{
+  http_chunk_t *chunk = ctx;
+  chunk->ok = result->status == AT_STATUS_OK;
+  xSemaphoreGive(chunk->done);
+}
+
+static bool http_read_submit(const at_dialect_t *d, http_chunk_t *chunk, size_t offset, size_t len)
+{
+  char command[48];
+  snprintf(command, sizeof(command), d->http_read, (unsigned)offset, (unsigned)len);
+  chunk->len = 0;
+  chunk->ok = false;
+  at_cmd_t cmd = {
+      .command = command,
+      .expected = "OK",
+      .timeout_ms = 13000,
+      .data_prefix = d->http_read_prefix,
+      .data_fn = http_chunk_data,
+      .data_ctx = chunk,
+      .cb = http_chunk_done,
+      .ctx = chunk,
+      .submit_wait_ms = -1,
+      .channel = AT_CHAN_DATA,
+  };
+  return at_submit(&cmd);
+}
+
+// 按 AT+HTTPREAD=<offset>,<len> 分块读取响应体，始终保持两条读取在途：
+// sink 处理一块时，下一块已经在串口上传输；块大小受命令集的上限约束
+static bool http_read_body(size_t total, const at_http_reader_t *reader, at_http_result_t *result)
+{
+  const at_dialect_t *d = at_uart_dialect();
+  size_t chunkSize = reader->chunk_size ? reader->chunk_size : d->http_chunk;
+  if (chunkSize > d->http_chunk_max)
+  {
+    chunkSize = d->http_chunk_max;
+  }
+  if (chunkSize > total)
+  {
+    chunkSize = total;
+  }
+  uint8_t *mem = malloc(chunkSize * 2);
+  if (mem == NULL)
+  {
+    ESP_LOGE(TAG, "Failed to allocate %u bytes for HTTP read", (unsigned)(chunkSize * 2));
+    return false;
+  }
+  http_chunk_t chunks[2];
+  for (int i = 0; i < 2; i++)
+  {
+    chunks[i].buf = mem + i * chunkSize;
+    chunks[i].cap = chunkSize;
+    chunks[i].done = xSemaphoreCreateBinaryStatic(&chunks[i].doneBuf);
+  }
+
+  int64_t start = esp_timer_get_time();
+  size_t requested = 0;
+  int cur = 0;
+  int inFlight = 0;
+  bool ok = true;
+  while (inFlight < 2 && requested < total)
+  {
+    size_t n = total - requested < chunkSize ? total - requested : chunkSize;
+    if (!http_read_submit(d, &chunks[(cur + inFlight) % 2], requested, n))
     {
-      if (sscanf(action_start, "+HTTPACTION: %d,%d,%d", &method, &status_code, &data_len) == 3)
-      {
-        ESP_LOGI(TAG, "Parsed HTTPACTION: method=%d, status=%d, length=%d", method, status_code, data_len);
-      }
-      else
+      ok = false;
+      break;
+    }
+    requested += n;
+    inFlight++;
+  }
+  while (inFlight > 0)
+  {
+    // 读取按提交顺序完成，失败后仍要等在途的那一块结束才能释放缓冲区
+    http_chunk_t *chunk = &chunks[cur];
+    xSemaphoreTake(chunk->done, portMAX_DELAY);
+    inFlight--;
+    size_t expected = total - result->received < chunkSize ? total - result->received : chunkSize;
+    if (ok && (!chunk->ok || chunk->len != expected))
+    {
+      ESP_LOGE(TAG, "HTTP read at %u failed, got %u of %u bytes", (unsigned)result->received, (unsigned)chunk->len, (unsigned)expected);
+      ok = false;
+    }
+    if (ok && !reader->sink(chunk->buf, chunk->len, reader->ctx))
+    {
+      ESP_LOGW(TAG, "HTTP read aborted by sink at %u bytes", (unsigned)result->received);
+      ok = false;
+    }
+    if (ok)
+    {
+      result->received += chunk->len;
+      if (requested < total)
       {
-        ESP_LOGE(TAG, "Failed to parse HTTPACTION response: %s", response);
-        close();
-        return false;
+        size_t n = total - requested < chunkSize ? total - requested : chunkSize;
+        if (http_read_submit(d, chunk, requested, n))
+        {
+          requested += n;
+          inFlight++;
+        }
+        else
+        {
+          ok = false;
+        }
       }
     }
+    cur ^= 1;
+  }
+  result->elapsed_us = esp_timer_get_time() - start;
+  vSemaphoreDelete(chunks[0].done);
+  vSemaphoreDelete(chunks[1].done);
+  free(mem);
+
+  int64_t ms = result->elapsed_us / 1000;
+  ESP_LOGI(TAG, "HTTP body %u/%u bytes in %lld ms (%u KB/s, chunk %u)", (unsigned)result->received, (unsigned)total,
+           (long long)ms, (unsigned)(ms > 0 ? result->received * 1000 / 1024 / ms : 0), (unsigned)chunkSize);
+  return ok && result->received == total;
+}
+
+// at_http_get / at_http_post 的响应体只记录日志
+static bool http_log_sink(const void *data, size_t len, void *ctx)
+{
+  ESP_LOGI(TAG, "HTTP response: %.*s", (int)len, (const char *)data);
+  return true;
+}
+
+// 没有 sink 时响应体不读取
+static bool http_discard_sink(const void *data, size_t len, void *ctx)
+{
+  return true;
+}
+
+// 请求头拼成 USERDATA，头之间以字面的 \r\n 分隔，由模组转换
+static bool http_build_userdata(const at_http_request_t *req, char *out, size_t cap)
+{
+  size_t pos = 0;
+  out[0] = '\0';
+  for (int i = 0; i < req->header_count; i++)
+  {
+    const at_http_header_t *header = &req->headers[i];
+    int n = snprintf(out + pos, cap - pos, "%s%s: %s", i > 0 ? "\\r\\n" : "", header->name, header->value);
+    if (n < 0 || (size_t)n >= cap - pos)
+    {
+      return false;
+    }
+    pos += n;
+  }
+  return true;
+}
+
+// 提示符到达后由引擎调用，把生产者的请求体分块写入串口
+typedef struct
+{
+  const at_http_request_t *req;
+  size_t written;
+} http_body_ctx_t;
+
+static void http_write_body(at_write_fn_t write, void *ctx)
+{
+  http_body_ctx_t *body = ctx;
+  uint8_t chunk[128];
+  while (body->written < body->req->body_len)
+  {
+    size_t want = body->req->body_len - body->written;
+    size_t n = body->req->body_fn(chunk, want < sizeof(chunk) ? want : sizeof(chunk), body->req->body_ctx);
+    if (n == 0)
+    {
+      // 模组按声明的长度等待，剩余部分只能等 HTTPDATA 超时
+      ESP_LOGE(TAG, "Body producer ended at %u of %u bytes", (unsigned)body->written, (unsigned)body->req->body_len);
+      return;
+    }
+    write(chunk, n);
+    body->written += n;
+  }
+}
+
+static bool http_upload_body(const at_http_request_t *req)
+{
+  // 数据输入时间按 115200 波特率估算并留出余量
+  int inputMs = 10000 + (int)(req->body_len / 8);
+  char command[48];
+  snprintf(command, sizeof(command), "AT+HTTPDATA=%u,%d", (unsigned)req->body_len, inputMs);
+  // 设置post发送数据长度和超时时间，收到 DOWNLOAD 后发送post数据
+  http_body_ctx_t body = {.req = req};
+  at_cmd_t cmd = {
+      .command = command,
+      .expected = "OK",
+      .timeout_ms = inputMs + 2000,
+      .prompt = "DOWNLOAD",
+      .channel = AT_CHAN_DATA,
+  };
+  if (req->body_fn)
+  {
+    cmd.payload_fn = http_write_body;
+    cmd.payload_ctx = &body;
   }
   else
   {
-    ESP_LOGE(TAG, "Expected +HTTPACTION not found in response: %s", response);
-    close();
+    cmd.payload = req->body;
+    cmd.payload_len = req->body_len;
+  }
+  return at_send(&cmd, NULL);
+}
+
+bool at_http_request(const at_http_request_t *req, at_http_result_t *result)
+{
+  if (req == NULL || req->url == NULL || strlen(req->url) == 0 || req->method < AT_HTTP_GET || req->method > AT_HTTP_PUT ||
+      (req->body_len > 0 && req->body == NULL && req->body_fn == NULL))
+  {
+    ESP_LOGE(TAG, "Invalid HTTP request");
     return false;
   }
-  if (status_code != 200)
+  at_http_result_t local;
+  if (result == NULL)
+  {
+    result = &local;
+  }
+  memset(result, 0, sizeof(*result));
+  int method, status_code, data_len;
+
+  if (!http_session_open())
   {
-    ESP_LOGE(TAG, "HTTP request failed with status code: %d", status_code);
-    close();
     return false;
   }
-  // ESP_LOGI(TAG, "HTTP request succeeded, data length: %d", data_len);
-  // 读取 HTTP 响应
-  if (data_len > 0)
+  if (!http_build_userdata(req, session.userdata, sizeof(session.userdata)))
+  {
+    ESP_LOGE(TAG, "HTTP headers too long");
+    return http_session_done(false);
+  }
+  char *response = session.response;
+  // 设置http请求头
+  if (req->content_type && !http_session_param(HTTP_PARAM_CONTENT, req->content_type))
+  {
+    return http_session_fail();
+  }
+  if (!http_session_param(HTTP_PARAM_USERDATA, session.userdata))
+  {
+    return http_session_fail();
+  }
+  // 设置目标URL
+  if (!http_session_param(HTTP_PARAM_URL, req->url))
+  {
+    return http_session_fail();
+  }
+  if (req->body_len > 0 && !http_upload_body(req))
+  {
+    ESP_LOGE(TAG, "Failed to send request body");
+    return http_session_fail();
+  }
+
+  // 执行 HTTP 请求，OK 之后等待网络完成时上报的 +HTTPACTION
+  const at_dialect_t *d = at_uart_dialect();
+  char action[24];
+  snprintf(action, sizeof(action), d->http_action, (int)req->method);
+  int timeout = req->timeout_ms > 0 ? req->timeout_ms : AT_HTTP_ACTION_TIMEOUT_MS;
+  if (!at_send_command_on(AT_CHAN_DATA, action, d->http_action_prefix, timeout, response))
+  {
+    ESP_LOGE(TAG, "HTTP action %d failed", (int)req->method);
+    return http_session_fail();
+  }
+  char *action_start = strstr(response, d->http_action_prefix);
+  if (action_start == NULL || sscanf(action_start, d->http_action_format, &method, &status_code, &data_len) != 3)
+  {
+    ESP_LOGE(TAG, "Failed to parse HTTPACTION response: %s", response);
+    return http_session_fail();
+  }
+  ESP_LOGI(TAG, "Parsed HTTPACTION: method=%d, status=%d, length=%d", method, status_code, data_len);
+  result->status = status_code;
+  result->length = data_len > 0 ? data_len : 0;
+
+  // 读取 HTTP 响应，HEAD 没有响应体
+  if (data_len > 0 && req->method != AT_HTTP_HEAD)
   {
-    char read_command[64];
-    snprintf(read_command, sizeof(read_command), "AT+HTTPREAD=0,%d", data_len);
-    if (!at_send_command(read_command, "OK", 13000, response, false))
+    at_http_reader_t reader = req->reader;
+    if (reader.sink == NULL)
+    {
+      reader.sink = http_discard_sink;
+    }
+    if (!http_read_body(data_len, &reader, result))
     {
       ESP_LOGE(TAG, "Failed to read HTTP response");
-      close();
-      return false;
+      return http_session_fail();
     }
-    ESP_LOGI(TAG, "HTTP response: %s", response);
-    // 处理http get 返回
   }
-  else
+  return http_session_done(true);
+}
+
+// ---------------- 异步请求 ----------------
+// 请求排队交给 at_http 任务执行，调用者不必为整个请求过程保留大栈
+#define HTTP_QUEUE_SIZE 4
+#define HTTP_TASK_STACK 3072 // at_http 任务栈预算，含完成回调
+
+typedef struct
+{
+  at_http_request_t req;
+  at_http_done_fn_t done;
+  void *ctx;
+} http_job_t;
+
+static QueueHandle_t httpQueue = NULL;
+AT_TASK_DEFINE(httpTask, HTTP_TASK_STACK);
+
+static void http_task()
+{
+  http_job_t job;
+  while (1)
   {
-    ESP_LOGE(TAG, "No data available to read");
-    close();
-    return false;
+    if (xQueueReceive(httpQueue, &job, portMAX_DELAY) != pdTRUE)
+    {
+      continue;
+    }
+    at_http_result_t result;
+    bool ok = at_http_request(&job.req, &result);
+    if (job.done)
+    {
+      job.done(ok, &result, job.ctx);
+    }
   }
-  close();
-  return true;
 }
 
-bool at_http_post(const char *path)
+// 启动流程中调用，此时还没有并发的调用者；会话锁最后创建，它非空即表示全部就绪
+bool at_http_init()
 {
-  if (path == NULL || strlen(path) == 0)
+  if (session.lock != NULL)
   {
-    ESP_LOGE(TAG, "Invalid path");
-    return false;
+    return true;
   }
-  char response[UART_BUF_SIZE];
-  int method, status_code, data_len;
-
-  // 基本检查
-  if (!at_check_base())
-    return false;
-  // PDP 检查
-  if (!at_check_pdp())
-    return false;
-  // 初始化 HTTP
-  if (!at_send_command("AT+HTTPINIT", "OK", 5000, NULL, false))
+  if (httpQueue == NULL)
   {
-    ESP_LOGE(TAG, "Failed to initialize HTTP");
-    return false;
+    httpQueue = xQueueCreate(HTTP_QUEUE_SIZE, sizeof(http_job_t));
   }
-  // 设置 PDP 上下文为 CID 1
-  if (!at_send_command("AT+HTTPPARA=\"CID\",1", "OK", 1000, NULL, false))
+  if (session.idleTimer == NULL)
   {
-    ESP_LOGE(TAG, "Failed to set HTTP CID");
-    close();
+    session.idleTimer = xTimerCreate("at_http_idle", pdMS_TO_TICKS(idleTimeoutMs), pdFALSE, NULL, http_idle_cb);
+  }
+  if (httpQueue == NULL || session.idleTimer == NULL)
+  {
+    ESP_LOGE(TAG, "Failed to create HTTP session");
     return false;
   }
-  // 设置http请求头
-  if (!at_send_command("AT+HTTPPARA=\"CONTENT\",\"application/json\"", "OK", 1000, NULL, false))
+  if (!at_task_start(&httpTask, http_task, "at_http", NULL, 5, 0))
   {
-    ESP_LOGE(TAG, "Failed to set HTTP CONTENT");
-    close();
+    ESP_LOGE(TAG, "Failed to start HTTP task");
     return false;
   }
-  // 设置目标URL
-  char url[256];
-  snprintf(url, sizeof(url), "AT+HTTPPARA=\"URL\",\"%s\"", path);
-  if (!at_send_command(url, "OK", 15000, NULL, false))
+  SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+  if (lock == NULL)
   {
-    ESP_LOGE(TAG, "Failed to set HTTP URL");
-    close();
+    ESP_LOGE(TAG, "Failed to create HTTP session");
     return false;
   }
+  session.lock = lock;
+  return true;
+}
 
-  char *json_string = NULL;
-  cJSON *obj = cJSON_CreateObject();
-  // 添加字段
-  cJSON_AddStringToObject(obj, "test", "123");
-  cJSON_AddBoolToObject(obj, "bool", true);
-  json_string = cJSON_PrintUnformatted(obj);
-  char post_data[512];
-  snprintf(post_data, sizeof(post_data), "AT+HTTPDATA=%d,10000", strlen(json_string));
-  // 设置post发送数据长度和超时时间
-  if (!at_send_command(post_data, "DOWNLOAD", 1000, NULL, false))
+bool at_http_request_async(const at_http_request_t *req, at_http_done_fn_t done, void *ctx)
+{
+  if (req == NULL)
   {
-    ESP_LOGE(TAG, "Failed to set HTTPDATA");
-    close();
     return false;
   }
-
-  // 发送post数据
-  if (!at_send_command(json_string, "OK", 1000, NULL, true))
+  if (!http_session_ready())
   {
-    ESP_LOGE(TAG, "Failed to send post data");
-    close();
     return false;
   }
-
-  // 执行 HTTP POST
-  if (!at_send_command("AT+HTTPACTION=1", "+HTTPACTION:", 3000, response, false))
+  http_job_t job = {
+      .req = *req,
+      .done = done,
+      .ctx = ctx,
+  };
+  if (xQueueSend(httpQueue, &job, 0) != pdTRUE)
   {
-    ESP_LOGE(TAG, "HTTP POST action failed");
-    close();
+    ESP_LOGE(TAG, "HTTP queue full");
     return false;
   }
-  if (strlen(response) == 0)
+  return true;
+}
+
+bool at_http_get(const char *path)
+{
+  at_http_reader_t reader = {
+      .sink = http_log_sink,
+  };
+  return at_http_get_stream(path, &reader, NULL);
+}
+
+bool at_http_get_stream(const char *path, const at_http_reader_t *reader, at_http_result_t *result)
+{
+  if (path == NULL || strlen(path) == 0 || reader == NULL || reader->sink == NULL)
   {
-    ESP_LOGE(TAG, "Empty response received for HTTPACTION");
-    close();
+    ESP_LOGE(TAG, "Invalid path");
     return false;
   }
-  if (strstr(response, "+HTTPACTION:") != NULL)
+  at_http_result_t local;
+  if (result == NULL)
   {
-    ESP_LOGI(TAG, "HTTPACTION response: %s", response);
-    char *action_start = strstr(response, "+HTTPACTION:");
-    if (action_start)
-    {
-      if (sscanf(action_start, "+HTTPACTION: %d,%d,%d", &method, &status_code, &data_len) == 3)
-      {
-        ESP_LOGI(TAG, "Parsed HTTPACTION: method=%d, status=%d, length=%d", method, status_code, data_len);
-      }
-      else
-      {
-        ESP_LOGE(TAG, "Failed to parse HTTPACTION response: %s", response);
-        close();
-        return false;
-      }
-    }
+    result = &local;
   }
-  else
+  at_http_request_t req = {
+      .method = AT_HTTP_GET,
+      .url = path,
+      .reader = *reader,
+  };
+  if (!at_http_request(&req, result))
   {
-    ESP_LOGE(TAG, "Expected +HTTPACTION not found in response: %s", response);
-    close();
     return false;
   }
-  // if (status_code != 200)
-  // {
-  //   ESP_LOGE(TAG, "HTTP request failed with status code: %d", status_code);
-  //   close();
-  //   return false;
-  // }
-  ESP_LOGI(TAG, "HTTP request succeeded, data length: %d", data_len);
-  // 读取 HTTP 响应
-  if (data_len > 0)
-  {
-    char read_command[64];
-    snprintf(read_command, sizeof(read_command), "AT+HTTPREAD=0,%d", data_len);
-    if (!at_send_command(read_command, "OK", 13000, response, false))
-    {
-      ESP_LOGE(TAG, "Failed to read HTTP response");
-      close();
-      return false;
-    }
-    ESP_LOGI(TAG, "HTTP response: %s", response);
-    // 处理http get 返回
+  if (result->status != 200)
+  {
+    ESP_LOGE(TAG, "HTTP request failed with status code: %d", result->status);
+    return false;
   }
-  else
+  return true;
+}
+
+bool at_http_post(const char *path, const char *json)
+{
+  if (path == NULL || strlen(path) == 0 || json == NULL)
   {
-    ESP_LOGE(TAG, "No data available to read");
-    close();
+    ESP_LOGE(TAG, "Invalid path");
     return false;
   }
-  close();
+  at_http_request_t req = {
+      .method = AT_HTTP_POST,
+      .url = path,
+      .content_type = "application/json",
+      .body = json,
+      .body_len = strlen(json),
+      .reader = {.sink = http_log_sink},
+  };
+  at_http_result_t result;
+  if (!at_http_request(&req, &result))
+  {
+    return false;
+  }
+  ESP_LOGI(TAG, "HTTP request succeeded, status %d, data length: %u", result.status, (unsigned)result.length);
   return true;
-}
\ No newline at end of file
+}
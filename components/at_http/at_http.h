@@ -1,6 +1,86 @@
 
 #ifndef AT_HTTP_H
 #define AT_HTTP_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AT_HTTP_IDLE_TIMEOUT_MS 30000 // 会话空闲多久后 HTTPTERM
+#define AT_HTTP_PARAM_MAX 224         // URL 等参数的最大长度，受命令缓冲区限制
+#define AT_HTTP_ACTION_TIMEOUT_MS 15000 // 等待 +HTTPACTION 的默认时间
+
+// 响应体接收函数，在调用者任务中按顺序调用，返回 false 中止读取
+typedef bool (*at_http_sink_t)(const void *data, size_t len, void *ctx);
+
+typedef struct
+{
+  size_t chunk_size; // 每条 AT+HTTPREAD 读取的字节数，0 取命令集的默认值，超过命令集上限时按上限
+  at_http_sink_t sink;
+  void *ctx;
+} at_http_reader_t;
+
+typedef struct
+{
+  int status;         // HTTP 状态码
+  size_t length;      // HTTPACTION 报告的响应体长度
+  size_t received;    // 已交给 sink 的字节数
+  int64_t elapsed_us; // 读取响应体的耗时
+} at_http_result_t;
+
+// 取值即 AT+HTTPACTION 的 method 参数
+typedef enum
+{
+  AT_HTTP_GET = 0,
+  AT_HTTP_POST = 1,
+  AT_HTTP_HEAD = 2,
+  AT_HTTP_DELETE = 3,
+  AT_HTTP_PUT = 4,
+} at_http_method_t;
+
+typedef struct
+{
+  const char *name;
+  const char *value;
+} at_http_header_t;
+
+// 请求体生产者：提示符到达后在引擎任务中反复调用，向 buf 填入至多 cap 字节并返回字节数，
+// 不可阻塞；合计必须正好 body_len 字节
+typedef size_t (*at_http_body_fn_t)(uint8_t *buf, size_t cap, void *ctx);
+
+typedef struct
+{
+  at_http_method_t method;
+  const char *url;
+  const char *content_type;        // NULL 时沿用会话上的设置
+  const at_http_header_t *headers; // 通过 USERDATA 发送
+  int header_count;
+  const void *body;                // 请求体，body_len 为 0 时不发送
+  size_t body_len;
+  at_http_body_fn_t body_fn;       // 设置后代替 body，请求体经 AT+HTTPDATA 分块写出
+  void *body_ctx;
+  at_http_reader_t reader;         // 响应体接收，sink 为 NULL 时丢弃
+  int timeout_ms;                  // 等待 +HTTPACTION 的时间，0 取 AT_HTTP_ACTION_TIMEOUT_MS
+} at_http_request_t;
+
+// 异步请求完成回调，在 at_http 任务中调用
+typedef void (*at_http_done_fn_t)(bool ok, const at_http_result_t *result, void *ctx);
+
+// 创建会话锁、空闲定时器、请求队列并启动 at_http 任务，在启动流程中调用一次；
+// 任一步失败返回 false。之前发起的请求直接返回 false
+bool at_http_init();
+// 执行一次请求并等待完成；ok 表示请求完成且响应体已读完，状态码见 result->status
+bool at_http_request(const at_http_request_t *req, at_http_result_t *result);
+// 排队后立即返回，由 at_http 任务执行；req 按值复制，其中的指针与 reader 由调用者保持有效直到回调
+bool at_http_request_async(const at_http_request_t *req, at_http_done_fn_t done, void *ctx);
+
 bool at_http_get(const char *path);
-bool at_http_post(const char *path);
+// 分块读取响应体交给 reader->sink，内存占用只有两块 chunk_size 的缓冲区
+// result 可以为 NULL
+bool at_http_get_stream(const char *path, const at_http_reader_t *reader, at_http_result_t *result);
+bool at_http_post(const char *path, const char *json);
+
+// 会话在请求之间保持，空闲超时后自动终止；0 恢复默认值
+void at_http_set_idle_timeout(uint32_t timeout_ms);
+// 立即终止会话，例如进入休眠前
+void at_http_session_close();
 #endif
\ No newline at end of file
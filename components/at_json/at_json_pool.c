@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "cJSON.h"
+#include "at_json_pool.h"
+
+#define AT_JSON_ALIGN 8
+
+static const char *TAG = "JSON_POOL";
+
+_Static_assert(AT_JSON_BLOCK_SIZE >= sizeof(cJSON), "AT_JSON_BLOCK_SIZE must hold a cJSON node");
+
+typedef struct
+{
+  uint8_t *base;
+  size_t top;
+  uint32_t live;      // 尚未释放的分配数，归零时整体复位
+  TaskHandle_t owner; // 复位前只供该任务使用
+} at_json_arena_t;
+
+static uint8_t blocks[AT_JSON_POOL_BLOCKS][AT_JSON_BLOCK_SIZE] __attribute__((aligned(AT_JSON_ALIGN)));
+static uint8_t arenaStorage[AT_JSON_ARENAS][AT_JSON_ARENA_SIZE] __attribute__((aligned(AT_JSON_ALIGN)));
+static at_json_arena_t arenas[AT_JSON_ARENAS];
+static void *freeList = NULL; // 空闲块链表，链接指针存放在块的开头
+static size_t arenaTotal = 0;
+static SemaphoreHandle_t poolLock = NULL;
+static at_json_pool_stats_t stats;
+
+static void *block_take(void)
+{
+  void *block = freeList;
+  if (block != NULL)
+  {
+    freeList = *(void **)block;
+    if (++stats.blocks_used > stats.blocks_high)
+    {
+      stats.blocks_high = stats.blocks_used;
+    }
+  }
+  return block;
+}
+
+// 优先用本任务已占用的 arena，放不下时再占一个空闲的
+static void *arena_take(size_t size)
+{
+  size_t need = (size + AT_JSON_ALIGN - 1) & ~(size_t)(AT_JSON_ALIGN - 1);
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  at_json_arena_t *arena = NULL;
+  for (int i = 0; i < AT_JSON_ARENAS; i++)
+  {
+    at_json_arena_t *candidate = &arenas[i];
+    if (need > AT_JSON_ARENA_SIZE - candidate->top)
+    {
+      continue;
+    }
+    if (candidate->live > 0 && candidate->owner == self)
+    {
+      arena = candidate;
+      break;
+    }
+    if (candidate->live == 0 && arena == NULL)
+    {
+      arena = candidate;
+    }
+  }
+  if (arena == NULL)
+  {
+    return NULL;
+  }
+  void *p = arena->base + arena->top;
+  arena->top += need;
+  arena->live++;
+  arena->owner = self;
+  arenaTotal += need;
+  stats.arena_used = arenaTotal;
+  if (arenaTotal > stats.arena_high)
+  {
+    stats.arena_high = arenaTotal;
+  }
+  return p;
+}
+
+static void *pool_malloc(size_t size)
+{
+  xSemaphoreTake(poolLock, portMAX_DELAY);
+  // 块池用尽时小分配也可以落到 arena
+  void *p = size <= AT_JSON_BLOCK_SIZE ? block_take() : NULL;
+  if (p == NULL)
+  {
+    p = arena_take(size);
+  }
+  if (p == NULL)
+  {
+    stats.heap_allocs++;
+  }
+  xSemaphoreGive(poolLock);
+  return p != NULL ? p : malloc(size);
+}
+
+static void pool_free(void *ptr)
+{
+  uint8_t *p = ptr;
+  if (p >= &blocks[0][0] && p < (uint8_t *)blocks + sizeof(blocks))
+  {
+    xSemaphoreTake(poolLock, portMAX_DELAY);
+    *(void **)p = freeList;
+    freeList = p;
+    stats.blocks_used--;
+    xSemaphoreGive(poolLock);
+  }
+  else if (p >= &arenaStorage[0][0] && p < (uint8_t *)arenaStorage + sizeof(arenaStorage))
+  {
+    at_json_arena_t *arena = &arenas[(p - &arenaStorage[0][0]) / AT_JSON_ARENA_SIZE];
+    xSemaphoreTake(poolLock, portMAX_DELAY);
+    // 单独释放不回收空间，最后一块释放时整体复位
+    if (--arena->live == 0)
+    {
+      arenaTotal -= arena->top;
+      arena->top = 0;
+      stats.arena_used = arenaTotal;
+      stats.arena_resets++;
+    }
+    xSemaphoreGive(poolLock);
+  }
+  else
+  {
+    free(ptr);
+  }
+}
+
+void at_json_pool_init(void)
+{
+  if (poolLock != NULL)
+  {
+    return;
+  }
+  poolLock = xSemaphoreCreateMutex();
+  if (poolLock == NULL)
+  {
+    ESP_LOGE(TAG, "Failed to create pool lock, cJSON stays on the system heap");
+    return;
+  }
+  for (int i = 0; i < AT_JSON_ARENAS; i++)
+  {
+    arenas[i] = (at_json_arena_t){.base = arenaStorage[i]};
+  }
+  for (int i = AT_JSON_POOL_BLOCKS - 1; i >= 0; i--)
+  {
+    *(void **)blocks[i] = freeList;
+    freeList = blocks[i];
+  }
+  cJSON_Hooks hooks = {
+      .malloc_fn = pool_malloc,
+      .free_fn = pool_free,
+  };
+  cJSON_InitHooks(&hooks);
+}
+
+void at_json_pool_get_stats(at_json_pool_stats_t *out, bool reset)
+{
+  if (poolLock == NULL)
+  {
+    memset(out, 0, sizeof(*out));
+    return;
+  }
+  xSemaphoreTake(poolLock, portMAX_DELAY);
+  *out = stats;
+  if (reset)
+  {
+    stats.blocks_high = stats.blocks_used;
+    stats.arena_high = stats.arena_used;
+    stats.heap_allocs = 0;
+  }
+  xSemaphoreGive(poolLock);
+}
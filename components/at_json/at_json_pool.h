@@ -0,0 +1,32 @@
+#ifndef AT_JSON_POOL_H
+#define AT_JSON_POOL_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// cJSON 专用分配器，通过 cJSON_InitHooks 安装，不再在系统堆上反复申请释放小块内存
+// 不超过一块的分配（节点、键名、短字符串）来自定长块池，更大的（值字符串、打印缓冲区）
+// 来自线性 arena：每个 arena 由第一次在其中分配的任务独占，即一条消息的发布或解析，
+// 其中最后一块释放时整体复位，即 cJSON_Delete 之后一次性回收
+// 两者都用尽时退回系统堆并计数，稳态下该计数应为 0
+
+#define AT_JSON_BLOCK_SIZE 64    // 定长块大小，须不小于 sizeof(cJSON)
+#define AT_JSON_POOL_BLOCKS 96   // 定长块数量
+#define AT_JSON_ARENAS 3         // arena 个数，即可同时处理 JSON 的任务数
+#define AT_JSON_ARENA_SIZE 2048  // 每个 arena 的大小
+
+typedef struct
+{
+  uint32_t blocks_used;
+  uint32_t blocks_high;  // 同时占用的块数高水位
+  uint32_t arena_used;   // 所有 arena 合计
+  uint32_t arena_high;   // arena 合计占用字节高水位
+  uint32_t arena_resets; // arena 整体复位次数
+  uint32_t heap_allocs;  // 退回系统堆的分配次数
+} at_json_pool_stats_t;
+
+// 在创建任何 cJSON 对象之前调用；此前从系统堆分配的对象仍可正常释放
+void at_json_pool_init(void);
+// reset 为 true 时高水位回到当前占用、heap_allocs 清零，用于按周期上报
+void at_json_pool_get_stats(at_json_pool_stats_t *out, bool reset);
+#endif
@@ -3,179 +3,1830 @@
 #include "esp_log.h"
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
+#include "esp_timer.h"
 #include "cJSON.h"
 #include "at_config.h"
 #include "at_utils.h"
+#include "at_codec.h"
+#include "at_outbox.h"
+#include "at_metrics.h"
+#include "at_json_pool.h"
+#include "at_task.h"
+#include "at_mq.h"
 
 static char *TAG = "MQ";
 
-static mqConfig_t mqconfig = {
-    .username = NULL,
-    .password = NULL,
-    .server = NULL,
-    .port = NULL,
-};
+#define MQ_DATA_SCRATCH_SIZE 1024
+#define MQ_PING_TOPIC_SIZE 128
+#define MQ_SUBSCRIPTIONS 4        // 每个会话记下的订阅，重连后重新订阅
+#define MQ_SUB_TOPIC_SIZE 128
+#define MQ_PUBLISH_TIMEOUT_MS 6000
+// CBOR 下行消息还原成的 JSON，只在各实例的 message_handler_task 中使用，放不下时退回堆分配
+#define MQ_ROUTE_JSON_SIZE 2048
 
-static bool close()
+// 每个模组实例一个 MQTT 会话：连接参数、链路状态、发布缓冲与保活各自独立。
+// 下行路由表、编码规则、攒批与发件箱在会话之间共享
+typedef struct
+{
+  at_modem_t *modem;
+  bool used; // 调用过 at_mq_connect_on
+  mqConfig_t config;
+  volatile bool linkUp;
+  // 发布路径的 data 序列化缓冲区、命令与回复，由 publishLock 保护
+  SemaphoreHandle_t publishLock;
+  char dataScratch[MQ_DATA_SCRATCH_SIZE];
+  char publishCommand[UART_BUF_SIZE];
+  char publishResponse[UART_BUF_SIZE];
+  // 最近一次成功发布或收到下行消息的时间（ms），保活据此跳过心跳；
+  // 32 位保证在各任务间读写不撕裂，差值按无符号计算不受回绕影响
+  volatile uint32_t lastActivityMs;
+  volatile uint32_t published;
+  volatile uint32_t failovers;
+  char routeJson[MQ_ROUTE_JSON_SIZE];
+  // 保活，见下方“保活”一节
+  TimerHandle_t keepaliveTimer;
+  mqKeepaliveStats_t keepalive;
+  int keepaliveFails;
+  int keepaliveStreak;
+  uint32_t pingIdleMs; // 发出心跳时已空闲的时长
+  // 心跳报文在定时器任务中编码，在引擎任务中写出，同一时间只有一个在途
+  char pingTopic[MQ_PING_TOPIC_SIZE];
+  char pingCommand[UART_BUF_SIZE];
+  char pingId[37];
+  char pingData[128];
+  at_codec_envelope_t pingEnv;
+  // 重连：保活连续失败后由重连任务重建会话，见“保活”一节
+  volatile bool reconnecting;
+  uint32_t reconnectDelayMs;
+  char subs[MQ_SUBSCRIPTIONS][MQ_SUB_TOPIC_SIZE];
+  int subCount;
+} mq_session_t;
+
+static mq_session_t sessions[AT_MODEM_MAX];
+static mqPolicy_t policy = MQ_POLICY_FAILOVER;
+static volatile uint32_t balanceNext = 0;
+
+// 断网暂存：所有会话都断开时消息写入发件箱，任一会话重新连上后补发
+static bool outboxEnabled = false;
+
+static uint32_t mq_now_ms()
+{
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void mq_touch(mq_session_t *s)
+{
+  s->lastActivityMs = mq_now_ms();
+}
+
+static mq_session_t *mq_session_of(at_modem_t *modem)
+{
+  at_modem_t *m = modem ? modem : at_modem_default();
+  mq_session_t *s = &sessions[at_modem_index(m)];
+  s->modem = m;
+  return s;
+}
+
+// 主会话：序号最小的已连接过的会话，负责订阅与需要同步回复的发布
+static mq_session_t *mq_session_primary()
+{
+  for (int i = 0; i < AT_MODEM_MAX; i++)
+  {
+    if (sessions[i].used)
+    {
+      return &sessions[i];
+    }
+  }
+  return NULL;
+}
+
+// 按策略选一个链路正常的会话：FAILOVER 取序号最小的，BALANCE 在正常的会话间轮转；
+// 都断开时返回 NULL
+static mq_session_t *mq_session_up()
+{
+  int start = policy == MQ_POLICY_BALANCE ? (int)(balanceNext++ % AT_MODEM_MAX) : 0;
+  for (int i = 0; i < AT_MODEM_MAX; i++)
+  {
+    mq_session_t *s = &sessions[(start + i) % AT_MODEM_MAX];
+    if (s->used && s->linkUp)
+    {
+      return s;
+    }
+  }
+  return NULL;
+}
+
+static bool mq_any_up()
+{
+  for (int i = 0; i < AT_MODEM_MAX; i++)
+  {
+    if (sessions[i].used && sessions[i].linkUp)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool mq_close(mq_session_t *s)
 {
   // AT+MIPCLOSE
-  if (!at_send_command("AT+MDISCONNECT", "OK", 1000, NULL, false))
+  const at_dialect_t *d = at_modem_dialect(s->modem);
+  if (!at_modem_send_command(s->modem, AT_CHAN_MQ, d->mq_disconnect, "OK", 1000, NULL))
+  {
+    ESP_LOGE(TAG, "AT+MDISCONNECT failed");
+    return false;
+  }
+
+  if (!at_modem_send_command(s->modem, AT_CHAN_MQ, d->mq_close, "OK", 1000, NULL))
+  {
+    ESP_LOGE(TAG, "AT+MIPCLOSE failed");
+    return false;
+  }
+
+  return true;
+}
+
+bool at_mq_free()
+{
+  bool ok = true;
+  for (int i = 0; i < AT_MODEM_MAX; i++)
+  {
+    if (sessions[i].used)
+    {
+      ok = mq_close(&sessions[i]) && ok;
+      sessions[i].linkUp = false;
+    }
+  }
+  return ok;
+}
+
+static bool mq_subscribe(mq_session_t *s, const char *topic)
+{
+  // 订阅topic
+  const at_dialect_t *d = at_modem_dialect(s->modem);
+  at_scratch_t *scratch = at_modem_scratch_take(s->modem);
+  snprintf(scratch->command, UART_BUF_SIZE, d->mq_subscribe, topic);
+  bool ok = at_modem_send_command(s->modem, AT_CHAN_MQ, scratch->command, d->mq_subscribe_ok, 3000, NULL);
+  at_modem_scratch_give(s->modem, scratch);
+  if (!ok)
+  {
+    ESP_LOGE(TAG, "AT+MSUB failed");
+    return false;
+  }
+  ESP_LOGW(TAG, "Subscribed to %s", topic);
+  return true;
+}
+
+void at_mq_subscribe_on(at_modem_t *modem, const char *topic)
+{
+  if (topic == NULL)
+  {
+    ESP_LOGE(TAG, "topic is NULL");
+    return;
+  }
+  mq_session_t *s = mq_session_of(modem);
+  if (!mq_subscribe(s, topic))
+  {
+    return;
+  }
+  // 记下订阅，重连后恢复
+  for (int i = 0; i < s->subCount; i++)
+  {
+    if (strcmp(s->subs[i], topic) == 0)
+    {
+      return;
+    }
+  }
+  if (s->subCount >= MQ_SUBSCRIPTIONS || strlen(topic) >= MQ_SUB_TOPIC_SIZE)
+  {
+    ESP_LOGW(TAG, "Subscription %s will not be restored after reconnect", topic);
+    return;
+  }
+  strcpy(s->subs[s->subCount++], topic);
+}
+
+void at_mq_subscribe(const char *topic)
+{
+  mq_session_t *s = mq_session_primary();
+  at_mq_subscribe_on(s ? s->modem : NULL, topic);
+}
+
+void at_mq_set_policy(mqPolicy_t p)
+{
+  policy = p;
+}
+
+void at_mq_session_get_stats(at_modem_t *modem, mqSessionStats_t *out)
+{
+  mq_session_t *s = mq_session_of(modem);
+  *out = (mqSessionStats_t){
+      .connected = s->used,
+      .linkUp = s->linkUp,
+      .published = s->published,
+      .failovers = s->failovers,
+  };
+}
+
+// ---------------- 报文编码 ----------------
+// 按 topic 过滤器选择 JSON 或 CBOR，先注册的先匹配，都不匹配时用默认编码；
+// 下行消息按首字节自动识别，不需要配置
+#define MQ_ENCODING_RULES 8
+#define MQ_ENCODING_FILTER_SIZE 128
+
+typedef struct
+{
+  char filter[MQ_ENCODING_FILTER_SIZE];
+  mqEncoding_t encoding;
+} mq_encoding_rule_t;
+
+static mq_encoding_rule_t encodingRules[MQ_ENCODING_RULES];
+static int encodingRuleCount = 0;
+static mqEncoding_t defaultEncoding = MQ_ENCODING_JSON;
+
+// MQTT 过滤器匹配，+ 匹配一层，# 匹配其余所有层（含父层本身）
+static bool mq_filter_matches(const char *filter, const char *topic)
+{
+  while (*filter)
+  {
+    if (filter[0] == '#')
+    {
+      return true;
+    }
+    if (filter[0] == '+')
+    {
+      topic += strcspn(topic, "/");
+      filter++;
+    }
+    else
+    {
+      size_t len = strcspn(filter, "/");
+      if (strncmp(filter, topic, len) != 0 || (topic[len] != '/' && topic[len] != '\0'))
+      {
+        return false;
+      }
+      filter += len;
+      topic += len;
+    }
+    if (*filter == '\0')
+    {
+      return *topic == '\0';
+    }
+    // filter 在 '/'
+    if (*topic == '\0')
+    {
+      return strcmp(filter, "/#") == 0;
+    }
+    filter++;
+    topic++;
+  }
+  return *topic == '\0';
+}
+
+bool at_mq_set_encoding(const char *filter, mqEncoding_t encoding)
+{
+  if (filter == NULL || strlen(filter) >= MQ_ENCODING_FILTER_SIZE)
+  {
+    ESP_LOGE(TAG, "Invalid encoding filter");
+    return false;
+  }
+  for (int i = 0; i < encodingRuleCount; i++)
+  {
+    if (strcmp(encodingRules[i].filter, filter) == 0)
+    {
+      encodingRules[i].encoding = encoding;
+      return true;
+    }
+  }
+  if (encodingRuleCount >= MQ_ENCODING_RULES)
+  {
+    ESP_LOGE(TAG, "Encoding table full, %s not added", filter);
+    return false;
+  }
+  mq_encoding_rule_t *rule = &encodingRules[encodingRuleCount++];
+  snprintf(rule->filter, sizeof(rule->filter), "%s", filter);
+  rule->encoding = encoding;
+  return true;
+}
+
+void at_mq_set_default_encoding(mqEncoding_t encoding)
+{
+  defaultEncoding = encoding;
+}
+
+mqEncoding_t at_mq_encoding_for(const char *topic)
+{
+  for (int i = 0; i < encodingRuleCount; i++)
+  {
+    if (mq_filter_matches(encodingRules[i].filter, topic))
+    {
+      return encodingRules[i].encoding;
+    }
+  }
+  return defaultEncoding;
+}
+
+// 提示符到达后由引擎调用，信封按固定字段表直接分块写入串口
+static void mq_write_envelope(at_write_fn_t write, void *ctx)
+{
+  char chunk[64];
+  at_codec_out_t out = {.buf = chunk, .cap = sizeof(chunk), .flush = write};
+  at_codec_emit_envelope(ctx, &out);
+  at_codec_out_flush(&out);
+}
+
+static void mq_write_envelope_cbor(at_write_fn_t write, void *ctx)
+{
+  char chunk[64];
+  at_codec_out_t out = {.buf = chunk, .cap = sizeof(chunk), .flush = write};
+  at_codec_cbor_emit_envelope(ctx, &out);
+  at_codec_out_flush(&out);
+}
+
+static size_t mq_envelope_size(const at_codec_envelope_t *env, mqEncoding_t encoding)
+{
+  return encoding == MQ_ENCODING_CBOR ? at_codec_cbor_size_envelope(env) : at_codec_size_envelope(env);
+}
+
+static at_payload_fn_t mq_envelope_writer(mqEncoding_t encoding)
+{
+  return encoding == MQ_ENCODING_CBOR ? mq_write_envelope_cbor : mq_write_envelope;
+}
+
+// 取得 data 的 JSON 并释放 cJSON 对象：rawData 直接使用，否则序列化到 scratch，
+// 放不下时由 cJSON 分配（开启 cJSON 池后来自池），调用者用 cJSON_free 释放 *heapData
+static at_codec_raw_t mq_encode_data(const mqMessage_t *message, char *scratch, size_t cap, char **heapData)
+{
+  at_codec_raw_t data = {0};
+  *heapData = NULL;
+  if (message->rawData != NULL)
+  {
+    // 调用者已用 at_codec 编码好 data，无需经过 cJSON
+    data.json = message->rawData;
+    data.len = strlen(message->rawData);
+  }
+  else if (cJSON_PrintPreallocated(message->data, scratch, cap, false))
+  {
+    data.json = scratch;
+    data.len = strlen(scratch);
+  }
+  else
+  {
+    *heapData = cJSON_PrintUnformatted(message->data);
+    data.json = *heapData;
+    data.len = *heapData ? strlen(*heapData) : 0;
+  }
+  cJSON_Delete(message->data);
+  return data;
+}
+
+// 在会话 s 上发出信封，调用者持有 response 所属会话的 publishLock
+static bool mq_send_envelope(mq_session_t *s, const char *topic, at_codec_envelope_t *env, mqEncoding_t encoding,
+                             const char *expected_response, char *response)
+{
+  // 先计数得到精确长度，再在提示符到达后流式写出
+  snprintf(s->publishCommand, sizeof(s->publishCommand), at_modem_dialect(s->modem)->mq_publish, topic,
+           (unsigned)mq_envelope_size(env, encoding));
+  at_cmd_t cmd = {
+      .command = s->publishCommand,
+      .expected = expected_response,
+      .timeout_ms = MQ_PUBLISH_TIMEOUT_MS,
+      .prompt = ">",
+      .payload_fn = mq_envelope_writer(encoding),
+      .payload_ctx = env,
+      .channel = AT_CHAN_MQ,
+      .modem = s->modem,
+  };
+  return at_send(&cmd, response);
+}
+
+// 心跳和需要等待回复的消息补发没有意义，不进入发件箱
+static bool mq_storable(const mqMessage_t *message, const char *responseJSON)
+{
+  return outboxEnabled && message->event != Ping && responseJSON == NULL;
+}
+
+static bool mq_store(const mqMessage_t *message, const at_codec_raw_t *data)
+{
+  at_outbox_msg_t msg = {
+      .topic = message->topic,
+      .id = message->id,
+      .data = data->json,
+      .dataLen = data->len,
+      .event = message->event,
+      .time = message->time,
+      .ttl = message->ttl,
+  };
+  if (!at_outbox_put(&msg))
+  {
+    ESP_LOGE(TAG, "Failed to store message for %s", message->topic);
+    return false;
+  }
+  ESP_LOGW(TAG, "Link down, message for %s stored in outbox", message->topic);
+  return true;
+}
+
+// 所有会话都断开后第一个恢复的会话触发发件箱补发
+static void mq_set_link(mq_session_t *s, bool up)
+{
+  bool wasUp = mq_any_up();
+  s->linkUp = up;
+  if (up && !wasUp && outboxEnabled)
+  {
+    at_outbox_drain();
+  }
+}
+
+// 发布消息，mqMessage.data 的所有权交给本函数，无论成功与否都会释放
+// 设置了 rawData 时直接使用，data 可以为 NULL
+// 开启发件箱后，所有会话都断开或发送失败时消息写入发件箱，此时同样返回 true
+bool at_mq_publish(const mqMessage_t mqMessage, char *expected_response, char *responseJSON)
+{
+  if (!validateMqMessage(&mqMessage))
+  {
+    ESP_LOGE(TAG, "Invalid mqMessage");
+    cJSON_Delete(mqMessage.data);
+    return false;
+  }
+  bool storable = mq_storable(&mqMessage, responseJSON);
+  // 同步回复只会送到订阅所在的主会话，其余消息按策略选择会话
+  mq_session_t *s = responseJSON != NULL ? NULL : mq_session_up();
+  if (s == NULL)
+  {
+    s = mq_session_primary();
+  }
+  if (!storable && (s == NULL || !validateMqConfig(&s->config)))
+  {
+    ESP_LOGE(TAG, "Invalid mqconfig");
+    cJSON_Delete(mqMessage.data);
+    return false;
+  }
+  if (expected_response == NULL)
+  {
+    expected_response = "+MSUB:";
+  }
+  if (s == NULL)
+  {
+    // 还没有任何会话，发件箱的初始化保证了 sessions[0] 的锁可用
+    s = &sessions[0];
+  }
+
+  xSemaphoreTake(s->publishLock, portMAX_DELAY);
+  at_codec_envelope_t env = {
+      .event = {getEventString(mqMessage.event), mqMessage.event},
+      .id = mqMessage.id,
+      .time = mqMessage.time,
+      .ttl = mqMessage.ttl,
+  };
+  char *heapData = NULL;
+  env.data = mq_encode_data(&mqMessage, s->dataScratch, sizeof(s->dataScratch), &heapData);
+  if (env.data.json == NULL)
+  {
+    ESP_LOGE(TAG, "Failed to serialize data");
+    xSemaphoreGive(s->publishLock);
+    return false;
+  }
+
+  bool ok;
+  if (storable && (!s->used || !s->linkUp || !validateMqConfig(&s->config)))
+  {
+    ok = mq_store(&mqMessage, &env.data);
+    cJSON_free(heapData);
+    xSemaphoreGive(s->publishLock);
+    return ok;
+  }
+  // 同步取回复时回复经由文本缓冲区返回，只能是 JSON，此时请求也用 JSON
+  mqEncoding_t encoding = responseJSON != NULL ? MQ_ENCODING_JSON : at_mq_encoding_for(mqMessage.topic);
+  ok = mq_send_envelope(s, mqMessage.topic, &env, encoding, expected_response, s->publishResponse);
+  mq_session_t *sent = s;
+  // 发送失败视为该会话链路断开，改由其余正常的会话发送；数据仍在 s 的缓冲区中，
+  // 先把 s 标记为断开再选下一个，两个任务不会互相等待对方的锁
+  while (!ok && responseJSON == NULL)
+  {
+    mq_set_link(sent, false);
+    mq_session_t *next = mq_session_up();
+    if (next == NULL || xSemaphoreTake(next->publishLock, pdMS_TO_TICKS(MQ_PUBLISH_TIMEOUT_MS)) != pdTRUE)
+    {
+      break;
+    }
+    ESP_LOGW(TAG, "Publish to %s failed on modem %d, failing over to modem %d", mqMessage.topic,
+             at_modem_index(sent->modem), at_modem_index(next->modem));
+    next->failovers++;
+    ok = mq_send_envelope(next, mqMessage.topic, &env, encoding, expected_response, next->publishResponse);
+    xSemaphoreGive(next->publishLock);
+    sent = next;
+  }
+  if (!ok && storable)
+  {
+    // 所有会话都失败，之后的消息直接进入发件箱
+    mq_set_link(sent, false);
+    ok = mq_store(&mqMessage, &env.data);
+    cJSON_free(heapData);
+    xSemaphoreGive(s->publishLock);
+    return ok;
+  }
+  cJSON_free(heapData);
+  if (ok && responseJSON != NULL)
+  {
+    parse_json(s->publishResponse, responseJSON);
+  }
+  xSemaphoreGive(s->publishLock);
+  if (!ok)
+  {
+    ESP_LOGE(TAG, "AT+MPUBX send failed");
+    return false;
+  }
+  sent->published++;
+  mq_touch(sent);
+  mq_set_link(sent, true);
+  return true;
+}
+
+// 发件箱补发，在发件箱任务中调用，只等待模组 OK
+static bool mq_outbox_send(const at_outbox_msg_t *msg, void *ctx)
+{
+  mq_session_t *s = mq_session_up();
+  if (s == NULL)
+  {
+    return false;
+  }
+  at_codec_envelope_t env = {
+      .data = {.json = msg->data, .len = msg->dataLen},
+      .event = {getEventString(msg->event), msg->event},
+      .id = msg->id,
+      .time = msg->time,
+      .ttl = msg->ttl,
+  };
+  xSemaphoreTake(s->publishLock, portMAX_DELAY);
+  bool ok = mq_send_envelope(s, msg->topic, &env, at_mq_encoding_for(msg->topic), "OK", NULL);
+  xSemaphoreGive(s->publishLock);
+  if (!ok)
+  {
+    ESP_LOGE(TAG, "Outbox resend to %s failed on modem %d", msg->topic, at_modem_index(s->modem));
+    s->linkUp = false;
+    return false;
+  }
+  s->published++;
+  mq_touch(s);
+  return true;
+}
+
+static void mq_session_init(mq_session_t *s)
+{
+  if (s->publishLock == NULL)
+  {
+    s->publishLock = xSemaphoreCreateMutex();
+  }
+}
+
+bool at_mq_outbox_enable()
+{
+  mq_session_init(mq_session_of(NULL));
+  if (!at_outbox_init(mq_outbox_send, NULL))
+  {
+    ESP_LOGE(TAG, "Failed to init outbox, messages will not be stored");
+    return false;
+  }
+  outboxEnabled = true;
+  if (mq_any_up())
+  {
+    at_outbox_drain();
+  }
+  return true;
+}
+
+// ---------------- 发布攒批 ----------------
+// 每个 topic 一个批次，双缓冲：一块在发送（异步，等待模组 OK），另一块继续收集。
+// 缓冲区里存的是消息字段而不是编码结果，数组在提示符到达后按编码流式写出；
+// 发送失败时逐条交回 at_mq_publish，与单条发布一样走故障转移和发件箱
+#define MQ_BATCH_TOPICS 4
+#define MQ_BATCH_BUF_SIZE 1024
+#define MQ_BATCH_TOPIC_SIZE 128
+#define MQ_BATCH_STACK 3072 // 批量发送任务栈预算，字节；补发时经 at_mq_publish，与遥测任务相同
+
+// 缓冲区中的一条消息，之后依次是 id 与 data，各以 0 结尾；按字节拷贝读写，不要求对齐
+typedef struct
+{
+  uint64_t time;
+  uint64_t ttl;
+  uint16_t dataLen;
+  uint8_t idLen;
+  uint8_t event;
+} mq_batch_entry_t;
+
+typedef struct
+{
+  char topic[MQ_BATCH_TOPIC_SIZE];
+  char buf[2][MQ_BATCH_BUF_SIZE];
+  int active;               // 正在收集的缓冲区
+  size_t used;              // active 缓冲区已存的字节数
+  size_t len;               // active 缓冲区编码后的长度，含 '[' 或 CBOR 不定长数组头
+  int count;                // active 缓冲区中的消息数
+  mqEncoding_t encoding;    // CBOR 批次为不定长数组，没有分隔符
+  int64_t firstAt;          // 第一条消息入批时间
+  SemaphoreHandle_t sendDone; // 另一块缓冲区空闲时可取，发送失败时补发结束才归还
+  StaticSemaphore_t sendDoneBuf;
+  volatile bool failed;     // 发送失败，等批量任务补发
+  char sendingTopic[MQ_BATCH_TOPIC_SIZE]; // 发送期间 topic 可能已被其他消息占用
+  int sendingBuf;
+  mqEncoding_t sendingEncoding;
+  size_t sending;           // 发送中的批次字节数，回调中统计
+  int sendingCount;
+  size_t sendingCmdLen;
+  size_t sendingOverhead;   // 数组本身占用的字节
+  mq_session_t *sendingSession; // 发送时按策略选定
+} mq_batch_t;
+
+#define MQ_CBOR_ARRAY_START 0x9F
+#define MQ_CBOR_BREAK 0xFF
+
+static SemaphoreHandle_t batchLock = NULL;
+AT_TASK_DEFINE(batchTask, MQ_BATCH_STACK);
+static mqBatchConfig_t batchConfig;
+static mqBatchStats_t batchStats; // 在引擎回调中更新，由 statsLock 保护
+static SemaphoreHandle_t statsLock = NULL;
+static mq_batch_t batches[MQ_BATCH_TOPICS];
+static char batchScratch[MQ_DATA_SCRATCH_SIZE];
+static char batchCommand[UART_BUF_SIZE]; // 由 batchLock 保护，at_submit 入队时复制
+
+static size_t mq_batch_entry_size(size_t idLen, size_t dataLen)
+{
+  return sizeof(mq_batch_entry_t) + idLen + 1 + dataLen + 1;
+}
+
+// 读出 off 处的消息，返回下一条的偏移
+static size_t mq_batch_entry_read(char *buf, size_t off, mq_batch_entry_t *entry, at_codec_envelope_t *env)
+{
+  memcpy(entry, buf + off, sizeof(*entry));
+  char *id = buf + off + sizeof(*entry);
+  char *data = id + entry->idLen + 1;
+  *env = (at_codec_envelope_t){
+      .data = {.json = data, .len = entry->dataLen},
+      .event = {getEventString(entry->event), entry->event},
+      .id = id,
+      .time = entry->time,
+      .ttl = entry->ttl,
+  };
+  return off + mq_batch_entry_size(entry->idLen, entry->dataLen);
+}
+
+// 提示符到达后由引擎调用，逐条编码写出；只有一条时不包数组，与 at_mq_publish 的格式相同
+static void mq_batch_write(at_write_fn_t write, void *ctx)
+{
+  mq_batch_t *batch = ctx;
+  bool cbor = batch->sendingEncoding == MQ_ENCODING_CBOR;
+  bool array = batch->sendingCount > 1;
+  char chunk[64];
+  at_codec_out_t out = {.buf = chunk, .cap = sizeof(chunk), .flush = write};
+  if (array)
+  {
+    char start = cbor ? (char)MQ_CBOR_ARRAY_START : '[';
+    at_codec_out_put(&out, &start, 1);
+  }
+  size_t off = 0;
+  for (int i = 0; i < batch->sendingCount; i++)
+  {
+    mq_batch_entry_t entry;
+    at_codec_envelope_t env;
+    off = mq_batch_entry_read(batch->buf[batch->sendingBuf], off, &entry, &env);
+    if (cbor)
+    {
+      at_codec_cbor_emit_envelope(&env, &out);
+    }
+    else
+    {
+      if (i > 0)
+      {
+        at_codec_out_put(&out, ",", 1);
+      }
+      at_codec_emit_envelope(&env, &out);
+    }
+  }
+  if (array)
+  {
+    char end = cbor ? (char)MQ_CBOR_BREAK : ']';
+    at_codec_out_put(&out, &end, 1);
+  }
+  at_codec_out_flush(&out);
+}
+
+// 发送失败交给批量任务补发，sendDone 在补发结束前不归还；调用者持有 statsLock
+static void mq_batch_failed(mq_batch_t *batch)
+{
+  batchStats.failures++;
+  batch->failed = true;
+  xTaskNotifyGive(batchTask.handle);
+}
+
+static void mq_batch_sent(const at_result_t *result, void *ctx)
+{
+  mq_batch_t *batch = ctx;
+  xSemaphoreTake(statsLock, portMAX_DELAY);
+  if (result->status == AT_STATUS_OK)
+  {
+    mq_touch(batch->sendingSession);
+    batch->sendingSession->published += batch->sendingCount;
+    // 逐条发送时每条都要一条命令，合并后只有一条命令加上数组本身
+    int n = batch->sendingCount;
+    batchStats.transactions++;
+    batchStats.messages += n;
+    batchStats.bytes_sent += batch->sendingCmdLen + batch->sending;
+    if (n > 1)
+    {
+      batchStats.bytes_saved += (uint64_t)(n - 1) * batch->sendingCmdLen - batch->sendingOverhead;
+    }
+    xSemaphoreGive(statsLock);
+    xSemaphoreGive(batch->sendDone);
+    // 到期的批次可能因等这一块缓冲区而没有发出
+    xTaskNotifyGive(batchTask.handle);
+    return;
+  }
+  ESP_LOGE(TAG, "Batch publish to %s failed on modem %d (%d messages)", batch->sendingTopic,
+           at_modem_index(batch->sendingSession->modem), batch->sendingCount);
+  mq_batch_failed(batch);
+  xSemaphoreGive(statsLock);
+}
+
+// 批量任务中调用，不持有 batchLock：与单条发布一样先把失败的会话标记为断开，
+// 再逐条交给 at_mq_publish 由其余会话发出，都失败时进入发件箱
+static void mq_batch_replay(mq_batch_t *batch)
+{
+  batch->failed = false;
+  mq_set_link(batch->sendingSession, false);
+  ESP_LOGW(TAG, "Replaying %d messages for %s", batch->sendingCount, batch->sendingTopic);
+  int replayed = 0;
+  size_t off = 0;
+  for (int i = 0; i < batch->sendingCount; i++)
+  {
+    mq_batch_entry_t entry;
+    at_codec_envelope_t env;
+    off = mq_batch_entry_read(batch->buf[batch->sendingBuf], off, &entry, &env);
+    mqMessage_t message = {
+        .topic = batch->sendingTopic,
+        .id = (char *)env.id,
+        .rawData = env.data.json,
+        .event = entry.event,
+        .time = entry.time,
+        .ttl = entry.ttl,
+    };
+    if (at_mq_publish(message, "OK", NULL))
+    {
+      replayed++;
+    }
+  }
+  xSemaphoreTake(statsLock, portMAX_DELAY);
+  batchStats.replayed += replayed;
+  xSemaphoreGive(statsLock);
+  xSemaphoreGive(batch->sendDone);
+}
+
+// 发出 active 缓冲区并切换到另一块，需持有 batchLock。
+// 上一批还在发送时另一块缓冲区不能复用：wait 为 false 直接返回 false；
+// 否则先放开 batchLock 再等，不让一个 topic 的发送挡住其他 topic 入批，
+// 等待期间批次可能已被发出或改作其他 topic，返回 false 由调用者重新判断
+static bool mq_batch_flush_locked(mq_batch_t *batch, bool wait)
+{
+  if (batch->count == 0)
+  {
+    return true;
+  }
+  if (xSemaphoreTake(batch->sendDone, 0) != pdTRUE)
+  {
+    if (wait)
+    {
+      xSemaphoreGive(batchLock);
+      xSemaphoreTake(batch->sendDone, portMAX_DELAY);
+      xSemaphoreGive(batch->sendDone);
+      xSemaphoreTake(batchLock, portMAX_DELAY);
+    }
+    return false;
+  }
+  // 单条不包数组，去掉数组头；多条加上结尾
+  size_t len = batch->count == 1 ? batch->len - 1 : batch->len + 1;
+  // 整批在同一个会话上发出
+  mq_session_t *session = mq_session_up();
+  batch->sendingSession = session ? session : mq_session_of(NULL);
+  int cmdLen = snprintf(batchCommand, sizeof(batchCommand),
+                        at_modem_dialect(batch->sendingSession->modem)->mq_publish, batch->topic, (unsigned)len);
+  strcpy(batch->sendingTopic, batch->topic);
+  batch->sendingBuf = batch->active;
+  batch->sendingEncoding = batch->encoding;
+  batch->sending = len;
+  batch->sendingCount = batch->count;
+  batch->sendingCmdLen = cmdLen + 1;
+  batch->sendingOverhead = batch->encoding == MQ_ENCODING_CBOR ? 2 : batch->count + 1;
+  at_cmd_t cmd = {
+      .command = batchCommand,
+      .expected = "OK",
+      .timeout_ms = 6000,
+      .prompt = ">",
+      .payload_fn = mq_batch_write,
+      .payload_ctx = batch,
+      .cb = mq_batch_sent,
+      .ctx = batch,
+      .submit_wait_ms = -1,
+      .channel = AT_CHAN_MQ,
+      .modem = batch->sendingSession->modem,
+  };
+  if (!at_submit(&cmd))
+  {
+    ESP_LOGE(TAG, "Failed to submit batch for %s", batch->topic);
+    xSemaphoreTake(statsLock, portMAX_DELAY);
+    mq_batch_failed(batch);
+    xSemaphoreGive(statsLock);
+  }
+  batch->active ^= 1;
+  batch->used = 0;
+  batch->len = 0;
+  batch->count = 0;
+  return true;
+}
+
+static size_t mq_batch_limit()
+{
+  size_t limit = batchConfig.max_bytes;
+  if (limit == 0 || limit > MQ_BATCH_BUF_SIZE)
+  {
+    limit = MQ_BATCH_BUF_SIZE;
+  }
+  return limit;
+}
+
+// 补发失败的批次，按窗口发出到期的批次
+static void mq_batch_task()
+{
+  while (1)
+  {
+    // 补发可能要逐条等待多个会话，不持有 batchLock，其他 topic 照常入批
+    for (int i = 0; i < MQ_BATCH_TOPICS; i++)
+    {
+      if (batches[i].failed)
+      {
+        mq_batch_replay(&batches[i]);
+      }
+    }
+    TickType_t wait = portMAX_DELAY;
+    xSemaphoreTake(batchLock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    int64_t window = (int64_t)batchConfig.window_ms * 1000;
+    for (int i = 0; i < MQ_BATCH_TOPICS; i++)
+    {
+      mq_batch_t *batch = &batches[i];
+      if (batch->count == 0)
+      {
+        continue;
+      }
+      int64_t left = batch->firstAt + window - now;
+      if (left <= 0)
+      {
+        // 上一批还在发送时不在这里等（失败的批次要由本任务补发），发送结束会再唤醒本任务
+        mq_batch_flush_locked(batch, false);
+        continue;
+      }
+      TickType_t ticks = pdMS_TO_TICKS((left + 999) / 1000);
+      if (ticks == 0)
+      {
+        ticks = 1;
+      }
+      if (wait == portMAX_DELAY || ticks < wait)
+      {
+        wait = ticks;
+      }
+    }
+    xSemaphoreGive(batchLock);
+    ulTaskNotifyTake(pdTRUE, wait);
+  }
+}
+
+bool at_mq_batch_enable(const mqBatchConfig_t *config)
+{
+  if (config == NULL || config->window_ms == 0)
+  {
+    ESP_LOGE(TAG, "Invalid batch config");
+    return false;
+  }
+  if (batchLock == NULL)
+  {
+    batchLock = xSemaphoreCreateMutex();
+    statsLock = xSemaphoreCreateMutex();
+    for (int i = 0; i < MQ_BATCH_TOPICS; i++)
+    {
+      batches[i].sendDone = xSemaphoreCreateBinaryStatic(&batches[i].sendDoneBuf);
+      xSemaphoreGive(batches[i].sendDone);
+    }
+  }
+  xSemaphoreTake(batchLock, portMAX_DELAY);
+  batchConfig = *config;
+  xSemaphoreGive(batchLock);
+  if (batchTask.handle == NULL)
+  {
+    at_task_start(&batchTask, mq_batch_task, "at_mq_batch", NULL, 5, 0);
+  }
+  else
+  {
+    xTaskNotifyGive(batchTask.handle);
+  }
+  return true;
+}
+
+// 找到 topic 对应的批次，没有则占用一个空批次；都在用时发出最早的一个后复用。
+// 复用要等上一批发送结束时，wait 为 false 直接返回 NULL
+static mq_batch_t *mq_batch_for(const char *topic, bool wait)
+{
+  while (1)
+  {
+    mq_batch_t *victim = NULL;
+    for (int i = 0; i < MQ_BATCH_TOPICS; i++)
+    {
+      mq_batch_t *batch = &batches[i];
+      if (strcmp(batch->topic, topic) == 0)
+      {
+        return batch;
+      }
+      if (victim == NULL || (victim->count > 0 && (batch->count == 0 || batch->firstAt < victim->firstAt)))
+      {
+        victim = batch;
+      }
+    }
+    // 等待时锁曾放开，批次表可能已变化，重新查找
+    if (mq_batch_flush_locked(victim, wait))
+    {
+      snprintf(victim->topic, sizeof(victim->topic), "%s", topic);
+      return victim;
+    }
+    if (!wait)
+    {
+      return NULL;
+    }
+  }
+}
+
+// batchLock 放开等待期间其他生产者会改写 batchScratch，等待前把数据复制出来，调用者 free *owned
+static bool mq_batch_detach(at_codec_raw_t *data, char **owned)
+{
+  if (data->json != batchScratch)
+  {
+    return true;
+  }
+  *owned = malloc(data->len + 1);
+  if (*owned == NULL)
+  {
+    return false;
+  }
+  memcpy(*owned, data->json, data->len + 1);
+  data->json = *owned;
+  return true;
+}
+
+// 把一条消息存入 active 缓冲区，调用者已确认放得下
+static void mq_batch_add(mq_batch_t *batch, const mqMessage_t *message, const at_codec_raw_t *data, size_t size)
+{
+  mq_batch_entry_t entry = {
+      .time = message->time,
+      .ttl = message->ttl,
+      .dataLen = data->len,
+      .idLen = strlen(message->id),
+      .event = message->event,
+  };
+  char *p = batch->buf[batch->active] + batch->used;
+  memcpy(p, &entry, sizeof(entry));
+  p += sizeof(entry);
+  memcpy(p, message->id, entry.idLen + 1);
+  p += entry.idLen + 1;
+  memcpy(p, data->json, data->len);
+  p[data->len] = '\0';
+  batch->used += mq_batch_entry_size(entry.idLen, entry.dataLen);
+  // JSON 每条前有 '[' 或 ','，CBOR 只有第一条前的数组头
+  batch->len += (batch->count == 0 || batch->encoding == MQ_ENCODING_JSON ? 1 : 0) + size;
+  if (batch->count++ == 0)
+  {
+    batch->firstAt = esp_timer_get_time();
+    xTaskNotifyGive(batchTask.handle);
+  }
+}
+
+bool at_mq_publish_batched(const mqMessage_t mqMessage, bool urgent)
+{
+  if (batchLock == NULL)
+  {
+    ESP_LOGE(TAG, "Batching not enabled");
+    cJSON_Delete(mqMessage.data);
+    return false;
+  }
+  if (!validateMqMessage(&mqMessage) || strlen(mqMessage.topic) >= MQ_BATCH_TOPIC_SIZE)
+  {
+    ESP_LOGE(TAG, "Invalid mqMessage");
+    cJSON_Delete(mqMessage.data);
+    return false;
+  }
+  if (outboxEnabled && !mq_any_up())
+  {
+    // 所有会话都断开时不入批，由 at_mq_publish 写入发件箱
+    return at_mq_publish(mqMessage, "OK", NULL);
+  }
+
+  xSemaphoreTake(batchLock, portMAX_DELAY);
+  at_codec_envelope_t env = {
+      .event = {getEventString(mqMessage.event), mqMessage.event},
+      .id = mqMessage.id,
+      .time = mqMessage.time,
+      .ttl = mqMessage.ttl,
+  };
+  char *heapData = NULL;
+  char *owned = NULL;
+  env.data = mq_encode_data(&mqMessage, batchScratch, sizeof(batchScratch), &heapData);
+  if (env.data.json == NULL)
+  {
+    ESP_LOGE(TAG, "Failed to serialize data");
+    xSemaphoreGive(batchLock);
+    return false;
+  }
+
+  size_t limit = mq_batch_limit();
+  mqEncoding_t encoding = at_mq_encoding_for(mqMessage.topic);
+  size_t size = mq_envelope_size(&env, encoding);
+  size_t idLen = strlen(mqMessage.id);
+  size_t stored = mq_batch_entry_size(idLen, env.data.len);
+  bool ok = true;
+  if (size + 2 > limit || stored > MQ_BATCH_BUF_SIZE || idLen > UINT8_MAX)
+  {
+    // 单条就超出批次上限，直接逐条发布
+    mqMessage_t single = mqMessage;
+    single.data = NULL;
+    single.rawData = env.data.json;
+    ok = at_mq_publish(single, "OK", NULL);
+  }
+  else
+  {
+    // 先不等待；要等上一批发送结束时数据先离开 batchScratch
+    mq_batch_t *batch = mq_batch_for(mqMessage.topic, false);
+    if (batch == NULL)
+    {
+      ok = mq_batch_detach(&env.data, &owned);
+      batch = ok ? mq_batch_for(mqMessage.topic, true) : NULL;
+    }
+    // 加上分隔符和结尾的 ']' 放不下，或编码配置已改变，先把已有的发出去；
+    // 等上一批时锁曾放开，批次可能已改作其他 topic，重新查找
+    while (batch != NULL && batch->count > 0 &&
+           (batch->len + 1 + size + 1 > limit || batch->used + stored > MQ_BATCH_BUF_SIZE ||
+            batch->encoding != encoding))
+    {
+      if (mq_batch_flush_locked(batch, false))
+      {
+        continue;
+      }
+      if (!mq_batch_detach(&env.data, &owned))
+      {
+        ok = false;
+        batch = NULL;
+      }
+      else if (!mq_batch_flush_locked(batch, true))
+      {
+        batch = mq_batch_for(mqMessage.topic, true);
+      }
+    }
+    if (batch == NULL)
+    {
+      ESP_LOGE(TAG, "No memory to hold message for %s", mqMessage.topic);
+      cJSON_free(heapData);
+      xSemaphoreGive(batchLock);
+      return false;
+    }
+    batch->encoding = encoding;
+    // 数据已复制进批次缓冲区，之后的等待不再引用 batchScratch
+    mq_batch_add(batch, &mqMessage, &env.data, size);
+    if (urgent || (batchConfig.max_messages > 0 && batch->count >= batchConfig.max_messages))
+    {
+      // 等待期间批次被改作其他 topic 时，本条已随之发出
+      while (!mq_batch_flush_locked(batch, true) && strcmp(batch->topic, mqMessage.topic) == 0)
+      {
+      }
+    }
+  }
+  free(owned);
+  cJSON_free(heapData);
+  xSemaphoreGive(batchLock);
+  return ok;
+}
+
+void at_mq_batch_flush()
+{
+  if (batchLock == NULL)
+  {
+    return;
+  }
+  xSemaphoreTake(batchLock, portMAX_DELAY);
+  for (int i = 0; i < MQ_BATCH_TOPICS; i++)
+  {
+    while (!mq_batch_flush_locked(&batches[i], true))
+    {
+    }
+  }
+  xSemaphoreGive(batchLock);
+}
+
+void at_mq_batch_get_stats(mqBatchStats_t *out)
+{
+  if (batchLock == NULL)
   {
-    ESP_LOGE(TAG, "AT+MDISCONNECT failed");
-    return false;
+    memset(out, 0, sizeof(*out));
+    return;
   }
+  xSemaphoreTake(statsLock, portMAX_DELAY);
+  *out = batchStats;
+  xSemaphoreGive(statsLock);
+}
+
+// ---------------- 遥测 ----------------
+// 周期性上报 AT 命令统计的增量，服务端按直方图汇总全量设备的 p50/p99
+#define MQ_TELEMETRY_STACK 3072 // 遥测任务栈预算，字节
+static uint32_t telemetryInterval = 0;
+AT_TASK_DEFINE(telemetryTask, MQ_TELEMETRY_STACK);
+static at_metrics_t telemetryMetrics; // 约 3 KB，不放在任务栈上
+static char telemetryTopic[UART_BUF_SIZE];
+// commands 数组与整条负载共用，只由遥测任务使用；按计数结果增长后复用，稳定后不再分配
+static char *telemetryBuf = NULL;
+static size_t telemetryCap = 0;
 
-  if (!at_send_command("AT+MIPCLOSE", "OK", 1000, NULL, false))
+static char *mq_telemetry_reserve(size_t len)
+{
+  if (len > telemetryCap)
+  {
+    char *buf = realloc(telemetryBuf, len);
+    if (buf == NULL)
+    {
+      ESP_LOGE(TAG, "Failed to allocate %u bytes for telemetry", (unsigned)len);
+      return NULL;
+    }
+    telemetryBuf = buf;
+    telemetryCap = len;
+  }
+  return telemetryBuf;
+}
+
+static void mq_emit_commands(const at_metrics_t *metrics, at_codec_out_t *out)
+{
+  bool first = true;
+  at_codec_out_put(out, "[", 1);
+  for (int i = 0; i < metrics->verb_count; i++)
+  {
+    const at_metrics_verb_t *verb = &metrics->verbs[i];
+    if (verb->count == 0)
+    {
+      continue;
+    }
+    char hist[AT_METRICS_BUCKETS * 11 + 2];
+    at_codec_out_t histOut = {.buf = hist, .cap = sizeof(hist)};
+    at_codec_out_put(&histOut, "[", 1);
+    for (int b = 0; b < AT_METRICS_BUCKETS; b++)
+    {
+      if (b > 0)
+      {
+        at_codec_out_put(&histOut, ",", 1);
+      }
+      at_codec_out_u64(&histOut, verb->hist[b]);
+    }
+    at_codec_out_put(&histOut, "]", 1);
+    at_codec_metric_t metric = {
+        .verb = verb->verb,
+        .count = verb->count,
+        .ok = verb->ok,
+        .error = verb->error,
+        .timeout = verb->timeout,
+        .tx = verb->bytes_tx,
+        .rx = verb->bytes_rx,
+        .p50 = at_metrics_percentile_ms(verb, 50),
+        .p99 = at_metrics_percentile_ms(verb, 99),
+        .max = (verb->max_us + 999) / 1000,
+        .hist = {.json = hist, .len = histOut.pos},
+    };
+    if (!first)
+    {
+      at_codec_out_put(out, ",", 1);
+    }
+    first = false;
+    at_codec_emit_metric(&metric, out);
+  }
+  at_codec_out_put(out, "]", 1);
+}
+
+static bool mq_publish_telemetry()
+{
+  // 统计是全部实例合计的，以主会话的身份上报
+  mq_session_t *primary = mq_session_primary();
+  if (primary == NULL)
+  {
+    return false;
+  }
+  at_metrics_snapshot(&telemetryMetrics, true);
+  at_json_pool_stats_t json;
+  at_json_pool_get_stats(&json, true);
+  // 先计数，commands 与负载依次放进同一块缓冲区
+  at_codec_out_t out = {0};
+  mq_emit_commands(&telemetryMetrics, &out);
+  size_t commandsLen = out.total;
+  at_codec_telemetry_t telemetry = {
+      .interval = (esp_timer_get_time() - telemetryMetrics.since_us) / 1000,
+      .baud = telemetryMetrics.link.baud_rate,
+      .rxDropped = telemetryMetrics.rx_dropped,
+      .jsonBlocks = json.blocks_high,
+      .jsonArena = json.arena_high,
+      .jsonHeap = json.heap_allocs,
+      .commands = {.json = "", .len = commandsLen}, // 计数时只用长度
+  };
+  size_t payloadLen = at_codec_size_telemetry(&telemetry);
+  char *buf = mq_telemetry_reserve(commandsLen + payloadLen + 1);
+  if (buf == NULL)
   {
-    ESP_LOGE(TAG, "AT+MIPCLOSE failed");
     return false;
   }
+  out = (at_codec_out_t){.buf = buf, .cap = commandsLen};
+  mq_emit_commands(&telemetryMetrics, &out);
+  telemetry.commands.json = buf;
+  char *payload = buf + commandsLen;
+  at_codec_encode_telemetry(&telemetry, payload, payloadLen + 1);
+
+  snprintf(telemetryTopic, sizeof(telemetryTopic), "/device/%s/telemetry", primary->config.clientId);
+  char uuid[37];
+  generate_random_uuid(uuid, sizeof(uuid));
+  mqMessage_t message = {
+      .topic = telemetryTopic,
+      .event = Telemetry,
+      .rawData = payload,
+      .time = get_current_timestamp_ms(),
+      .ttl = telemetryInterval,
+      .id = uuid,
+  };
+  // 不等待服务端回复，模组 OK 即可
+  return at_mq_publish(message, "OK", NULL);
+}
+
+static void mq_telemetry_task()
+{
+  while (1)
+  {
+    vTaskDelay(pdMS_TO_TICKS(telemetryInterval));
+    if (!mq_publish_telemetry())
+    {
+      ESP_LOGW(TAG, "Telemetry publish failed");
+    }
+  }
+}
 
+bool at_mq_telemetry_enable(uint32_t interval_ms)
+{
+  if (interval_ms == 0)
+  {
+    ESP_LOGE(TAG, "Invalid telemetry interval");
+    return false;
+  }
+  telemetryInterval = interval_ms;
+  at_task_start(&telemetryTask, mq_telemetry_task, "at_mq_telemetry", NULL, 4, 0);
   return true;
 }
 
-bool at_mq_free()
+// ---------------- 下行路由 ----------------
+// 订阅过滤器按层级存成前缀树，节点从静态池分配，每层的子节点以兄弟链表相连。
+// +MSUB 只解析一次，topic 与 payload 在接收缓冲区中就地以 0 结尾后交给回调，
+// 匹配代价与 topic 层数成正比，不做拷贝
+#define MQ_ROUTE_NODES 48
+
+typedef struct
+{
+  const char *seg; // 指向注册时复制的过滤器
+  uint8_t segLen;
+  int16_t child;   // 第一个子节点，-1 表示没有
+  int16_t sibling;
+  at_mq_handler_t handler;
+  void *ctx;
+} mq_route_node_t;
+
+static mq_route_node_t routeNodes[MQ_ROUTE_NODES]; // 0 为根
+static int routeNodeCount = 0;
+static SemaphoreHandle_t routeLock = NULL;
+static const char *routeEvents[Telemetry + 1]; // 事件编号 -> 名称
+
+static bool mq_seg_is(const mq_route_node_t *node, char c)
 {
-  return close();
+  return node->segLen == 1 && node->seg[0] == c;
 }
 
-void at_mq_subscribe(const char *topic)
+static int mq_route_child(int parent, const char *seg, size_t len, bool create)
 {
-  if (topic == NULL)
+  for (int c = routeNodes[parent].child; c >= 0; c = routeNodes[c].sibling)
   {
-    ESP_LOGE(TAG, "topic is NULL");
-    return;
+    if (routeNodes[c].segLen == len && memcmp(routeNodes[c].seg, seg, len) == 0)
+    {
+      return c;
+    }
   }
-  char command[UART_BUF_SIZE];
-  // 订阅topic
-  sprintf(command, "AT+MSUB=\"%s\",0", topic);
-  if (!at_send_command(command, "SUBACK", 3000, NULL, false))
+  if (!create || routeNodeCount >= MQ_ROUTE_NODES)
   {
-    ESP_LOGE(TAG, "AT+MSUB failed");
+    return -1;
+  }
+  int n = routeNodeCount++;
+  routeNodes[n] = (mq_route_node_t){
+      .seg = seg,
+      .segLen = len,
+      .child = -1,
+      .sibling = routeNodes[parent].child,
+  };
+  routeNodes[parent].child = n;
+  return n;
+}
+
+static void mq_route_dispatch_node(const mq_route_node_t *node, const char *topic, const char *payload, size_t len, int *hits)
+{
+  if (node->handler)
+  {
+    node->handler(topic, payload, len, node->ctx);
+    (*hits)++;
+  }
+}
+
+// 从 node 的子节点开始匹配 level 起的剩余层级，所有匹配的过滤器都会收到消息
+static void mq_route_match(int node, const char *level, const char *topic, const char *payload, size_t len, int *hits)
+{
+  const char *slash = strchr(level, '/');
+  size_t levelLen = slash ? (size_t)(slash - level) : strlen(level);
+  for (int c = routeNodes[node].child; c >= 0; c = routeNodes[c].sibling)
+  {
+    const mq_route_node_t *child = &routeNodes[c];
+    if (mq_seg_is(child, '#'))
+    {
+      mq_route_dispatch_node(child, topic, payload, len, hits);
+      continue;
+    }
+    if (!mq_seg_is(child, '+') && (child->segLen != levelLen || memcmp(child->seg, level, levelLen) != 0))
+    {
+      continue;
+    }
+    if (slash)
+    {
+      mq_route_match(c, slash + 1, topic, payload, len, hits);
+      continue;
+    }
+    mq_route_dispatch_node(child, topic, payload, len, hits);
+    // "a/#" 同样匹配 "a"
+    for (int g = child->child; g >= 0; g = routeNodes[g].sibling)
+    {
+      if (mq_seg_is(&routeNodes[g], '#'))
+      {
+        mq_route_dispatch_node(&routeNodes[g], topic, payload, len, hits);
+      }
+    }
+  }
+}
+
+// 解析 +MSUB: "<topic>",<len> byte,<payload>，在收到消息的实例的 message_handler_task 中调用，
+// ctx 为该实例的会话
+static void mq_route_message(char *message, size_t messageLen, void *ctx)
+{
+  mq_session_t *session = ctx;
+  char *topic = strchr(message, '"');
+  char *topicEnd = topic ? strchr(topic + 1, '"') : NULL;
+  char *payload = topicEnd ? strstr(topicEnd, " byte,") : NULL;
+  if (payload == NULL)
+  {
+    ESP_LOGE(TAG, "Malformed MSUB: %s", message);
     return;
   }
-  ESP_LOGW(TAG, "Subscribed to %s", topic);
-  return;
+  topic++;
+  *topicEnd = '\0';
+  size_t declared = strtoul(topicEnd + 2, NULL, 10);
+  payload += strlen(" byte,");
+  size_t len = message + messageLen - payload;
+  if (declared < len)
+  {
+    len = declared;
+    payload[len] = '\0';
+  }
+  mq_touch(session);
+
+  // CBOR 负载先还原为 JSON，回调只需处理 JSON
+  char *heapJson = NULL;
+  if (at_codec_is_cbor(payload, len))
+  {
+    char *routeJson = session->routeJson;
+    at_codec_out_t out = {.buf = routeJson, .cap = sizeof(session->routeJson) - 1};
+    bool ok = at_codec_cbor_to_json(payload, len, &out, routeEvents, Telemetry + 1);
+    if (ok && out.total >= sizeof(session->routeJson))
+    {
+      heapJson = malloc(out.total + 1);
+      out = (at_codec_out_t){.buf = heapJson, .cap = out.total};
+      ok = heapJson != NULL && at_codec_cbor_to_json(payload, len, &out, routeEvents, Telemetry + 1);
+    }
+    if (!ok)
+    {
+      ESP_LOGE(TAG, "Malformed CBOR on %s (%d bytes)", topic, (int)len);
+      free(heapJson);
+      return;
+    }
+    payload = heapJson ? heapJson : routeJson;
+    len = out.total;
+    payload[len] = '\0';
+  }
+
+  int hits = 0;
+  xSemaphoreTake(routeLock, portMAX_DELAY);
+  mq_route_match(0, topic, topic, payload, len, &hits);
+  xSemaphoreGive(routeLock);
+  if (hits == 0)
+  {
+    ESP_LOGW(TAG, "No route for %s: %.*s", topic, (int)len, payload);
+  }
+  free(heapJson);
 }
 
-bool at_mq_publish(const mqMessage_t mqMessage, char *expected_response, char *responseJSON)
+// '#' 只能是最后一层，通配符必须独占一层
+static bool mq_route_level_valid(const char *level, size_t len, bool last)
 {
-  if (!validateMqConfig(&mqconfig))
+  if (len > UINT8_MAX)
   {
-    ESP_LOGE(TAG, "Invalid mqconfig");
     return false;
   }
-  if (!validateMqMessage(&mqMessage))
+  if (memchr(level, '#', len) != NULL && (len > 1 || !last))
   {
-    ESP_LOGE(TAG, "Invalid mqMessage");
     return false;
   }
-  if (expected_response == NULL)
+  return memchr(level, '+', len) == NULL || len == 1;
+}
+
+// 路由表在所有会话之间共享，每个会话所在实例的下行消息都交给 mq_route_message
+static void mq_route_init(mq_session_t *s)
+{
+  if (routeLock == NULL)
   {
-    expected_response = "+MSUB:";
+    routeLock = xSemaphoreCreateMutex();
+    routeNodes[0] = (mq_route_node_t){.child = -1, .sibling = -1};
+    routeNodeCount = 1;
+    for (eventEnum e = Online; e <= Telemetry; e++)
+    {
+      routeEvents[e] = getEventString(e);
+    }
   }
-  char command[UART_BUF_SIZE];
-  // 发送消息
-  cJSON *root = cJSON_CreateObject();
-  cJSON_AddItemToObject(root, "data", mqMessage.data);
-  cJSON_AddStringToObject(root, "event", getEventString(mqMessage.event));
-  cJSON_AddStringToObject(root, "id", mqMessage.id);
-  cJSON_AddNumberToObject(root, "time", mqMessage.time);
-  cJSON_AddNumberToObject(root, "ttl", mqMessage.ttl);
-  char *payload = cJSON_PrintUnformatted(root);
-  cJSON_Delete(root);
-  char *topcpub = mqMessage.topic;
-  // 发送长数据
-  sprintf(command, "AT+MPUBEX=\"%s\",0,0,%d", topcpub, strlen(payload) + 1);
-  if (!at_send_command(command, ">", 1000, NULL, false))
+  at_modem_set_message_handler(s->modem, mq_route_message, s);
+}
+
+bool at_mq_add_route(const char *filter, at_mq_handler_t handler, void *ctx)
+{
+  if (filter == NULL || handler == NULL)
+  {
+    ESP_LOGE(TAG, "Invalid route");
+    return false;
+  }
+  if (routeLock == NULL)
+  {
+    mq_route_init(mq_session_of(NULL));
+  }
+  // 先整体校验，避免留下半截路径
+  for (const char *level = filter;;)
+  {
+    const char *slash = strchr(level, '/');
+    size_t len = slash ? (size_t)(slash - level) : strlen(level);
+    if (!mq_route_level_valid(level, len, slash == NULL))
+    {
+      ESP_LOGE(TAG, "Invalid route filter %s", filter);
+      return false;
+    }
+    if (slash == NULL)
+    {
+      break;
+    }
+    level = slash + 1;
+  }
+  // 节点直接引用过滤器中的层级，过滤器复制一份长期保存
+  char *copy = strdup(filter);
+  if (copy == NULL)
+  {
+    return false;
+  }
+  xSemaphoreTake(routeLock, portMAX_DELAY);
+  int node = 0;
+  for (const char *level = copy; node >= 0;)
+  {
+    const char *slash = strchr(level, '/');
+    size_t len = slash ? (size_t)(slash - level) : strlen(level);
+    node = mq_route_child(node, level, len, true);
+    if (slash == NULL)
+    {
+      break;
+    }
+    level = slash + 1;
+  }
+  if (node > 0)
+  {
+    routeNodes[node].handler = handler;
+    routeNodes[node].ctx = ctx;
+  }
+  xSemaphoreGive(routeLock);
+  if (node <= 0)
   {
-    ESP_LOGE(TAG, "AT+MPUB failed");
+    // 节点池用尽，已建立的前缀节点保留给之后的过滤器复用
+    ESP_LOGE(TAG, "Route table full, %s not added", filter);
     return false;
   }
+  return true;
+}
+
+// ---------------- 保活 ----------------
+// 定时器驱动，不占用任务：空闲满一个间隔才发心跳，窗口内有发布或下行消息即顺延。
+// 间隔从 MCONNECT keepalive 的 3/4 开始；空闲后的心跳失败说明 NAT 映射可能已过期，
+// 把空闲时长记为 NAT 超时并据此缩短间隔，之后连续成功再逐步放宽。失败按退避重试
+#define MQ_KEEPALIVE_MIN_MS 15000   // 间隔下限
+#define MQ_KEEPALIVE_RETRY_MS 5000  // 失败后的首次重试，之后翻倍，不超过间隔
+#define MQ_KEEPALIVE_MAX_FAILS 3    // 连续失败该次数后视为链路断开
+#define MQ_KEEPALIVE_GROW_AFTER 10  // 连续成功该次数后放宽 1/8
+// 连续失败后停止心跳，由重连任务关闭残留连接并重新 MIPSTART/MCONNECT、恢复订阅，
+// 失败按退避重试，成功后恢复心跳
+#define MQ_RECONNECT_MIN_MS 5000    // 重连失败后的首次等待，之后翻倍
+#define MQ_RECONNECT_MAX_MS 300000  // 等待上限
+#define MQ_RECONNECT_STACK 3072     // 重连任务栈预算，字节；连接链路与 at_mq_connect 相同
+AT_TASK_DEFINE(reconnectTask, MQ_RECONNECT_STACK);
+
+static bool mq_open(mq_session_t *s, bool *refused);
+static void mq_reconnect_task();
+
+static void mq_keepalive_arm(mq_session_t *s, uint32_t ms)
+{
+  xTimerChangePeriod(s->keepaliveTimer, pdMS_TO_TICKS(ms), 0);
+}
+
+// 引擎任务中调用，不可阻塞
+static void mq_keepalive_done(const at_result_t *result, void *ctx)
+{
+  mq_session_t *s = ctx;
+  mqKeepaliveStats_t *keepalive = &s->keepalive;
+  if (result->status == AT_STATUS_OK)
+  {
+    mq_touch(s);
+    s->keepaliveFails = 0;
+    if (!s->linkUp)
+    {
+      ESP_LOGI(TAG, "Keepalive recovered on modem %d", at_modem_index(s->modem));
+      mq_set_link(s, true);
+    }
+    uint32_t ceiling = AT_MQ_KEEPALIVE_S * 1000 * 3 / 4;
+    if (++s->keepaliveStreak >= MQ_KEEPALIVE_GROW_AFTER && keepalive->interval_ms < ceiling)
+    {
+      s->keepaliveStreak = 0;
+      keepalive->interval_ms += keepalive->interval_ms / 8;
+      if (keepalive->interval_ms > ceiling)
+      {
+        keepalive->interval_ms = ceiling;
+      }
+    }
+    mq_keepalive_arm(s, keepalive->interval_ms);
+    return;
+  }
+
+  keepalive->failures++;
+  s->keepaliveStreak = 0;
+  if (s->keepaliveFails == 0 && s->pingIdleMs >= MQ_KEEPALIVE_MIN_MS)
+  {
+    if (keepalive->nat_timeout_ms == 0 || s->pingIdleMs < keepalive->nat_timeout_ms)
+    {
+      keepalive->nat_timeout_ms = s->pingIdleMs;
+    }
+    uint32_t interval = keepalive->nat_timeout_ms * 3 / 4;
+    keepalive->interval_ms = interval > MQ_KEEPALIVE_MIN_MS ? interval : MQ_KEEPALIVE_MIN_MS;
+    ESP_LOGW(TAG, "Keepalive failed after %u ms idle, interval now %u ms", (unsigned)s->pingIdleMs,
+             (unsigned)keepalive->interval_ms);
+  }
+  s->keepaliveFails++;
+  if (s->keepaliveFails >= MQ_KEEPALIVE_MAX_FAILS)
+  {
+    ESP_LOGE(TAG, "Keepalive failed %d times, link down on modem %d, reconnecting", s->keepaliveFails,
+             at_modem_index(s->modem));
+    s->linkUp = false;
+    // 心跳停到重连成功为止
+    s->reconnecting = true;
+    xTaskNotifyGive(reconnectTask.handle);
+    return;
+  }
+  uint32_t retry = MQ_KEEPALIVE_RETRY_MS << (s->keepaliveFails - 1 < 4 ? s->keepaliveFails - 1 : 4);
+  mq_keepalive_arm(s, retry < keepalive->interval_ms ? retry : keepalive->interval_ms);
+}
 
-  char *send_command = NULL;
-  size_t len = snprintf(NULL, 0, "%s", payload) + 1;
-  send_command = (char *)malloc(len);
-  if (send_command == NULL)
+// 定时器任务中调用：submit_wait_ms 为 0，通道忙时立即返回失败，不阻塞定时器任务
+static bool mq_keepalive_ping(mq_session_t *s)
+{
+  at_codec_ping_t ping = {
+      .deviceId = s->config.clientId,
+      .projectInfoCode = "PJ202406050002",
+  };
+  size_t len = at_codec_encode_ping(&ping, s->pingData, sizeof(s->pingData));
+  if (len >= sizeof(s->pingData))
   {
-    // 处理分配失败的情况
-    ESP_LOGE(TAG, "malloc failed");
+    ESP_LOGE(TAG, "Heartbeat payload too long");
     return false;
   }
+  generate_random_uuid(s->pingId, sizeof(s->pingId));
+  s->pingEnv = (at_codec_envelope_t){
+      .data = {.json = s->pingData, .len = len},
+      .event = {getEventString(Ping), Ping},
+      .id = s->pingId,
+      .time = get_current_timestamp_ms(),
+      .ttl = 5000,
+  };
+  mqEncoding_t encoding = at_mq_encoding_for(s->pingTopic);
+  snprintf(s->pingCommand, sizeof(s->pingCommand), at_modem_dialect(s->modem)->mq_publish, s->pingTopic,
+           (unsigned)mq_envelope_size(&s->pingEnv, encoding));
+  // 只等模组 OK，服务端的 /ping/reply 作为下行消息到达
+  at_cmd_t cmd = {
+      .command = s->pingCommand,
+      .expected = "OK",
+      .timeout_ms = MQ_PUBLISH_TIMEOUT_MS,
+      .prompt = ">",
+      .payload_fn = mq_envelope_writer(encoding),
+      .payload_ctx = &s->pingEnv,
+      .cb = mq_keepalive_done,
+      .ctx = s,
+      .submit_wait_ms = 0,
+      .channel = AT_CHAN_MQ,
+      .modem = s->modem,
+  };
+  return at_submit(&cmd);
+}
 
-  sprintf(send_command, "%s", payload);
-  char response[UART_BUF_SIZE];
-  if (!at_send_command(send_command, expected_response, 5000, response, true))
+// 定时器任务中调用，不可阻塞；定时器 ID 为所属会话
+static void mq_keepalive_cb(TimerHandle_t timer)
+{
+  mq_session_t *s = pvTimerGetTimerID(timer);
+  if (s->reconnecting)
   {
-    ESP_LOGE(TAG, "AT+MPUBX send failed");
-    free(send_command);
+    return;
+  }
+  uint32_t idle = mq_now_ms() - s->lastActivityMs;
+  if (s->keepaliveFails == 0 && idle < s->keepalive.interval_ms)
+  {
+    // 窗口内有流量，心跳顺延到空闲满一个间隔
+    s->keepalive.skipped++;
+    mq_keepalive_arm(s, s->keepalive.interval_ms - idle);
+    return;
+  }
+  s->pingIdleMs = idle;
+  if (!mq_keepalive_ping(s))
+  {
+    // 通道正被阻塞的提交者占用或队列已满，说明仍有流量，稍后再试，不计为心跳失败
+    mq_keepalive_arm(s, MQ_KEEPALIVE_RETRY_MS);
+    return;
+  }
+  s->keepalive.pings++;
+}
+
+static bool mq_keepalive_start(mq_session_t *s)
+{
+  if (!validateMqConfig(&s->config))
+  {
+    ESP_LOGE(TAG, "Invalid mqconfig");
     return false;
   }
-  free(send_command);
-  free(payload);
-  if (responseJSON != NULL)
+  if (s->keepaliveTimer != NULL)
+  {
+    return true;
+  }
+  snprintf(s->pingTopic, sizeof(s->pingTopic), "/device/%s/ping", s->config.clientId);
+  s->keepalive.interval_ms = AT_MQ_KEEPALIVE_S * 1000 * 3 / 4;
+  s->keepaliveTimer = xTimerCreate("mq_keepalive", pdMS_TO_TICKS(s->keepalive.interval_ms), pdFALSE, s, mq_keepalive_cb);
+  if (s->keepaliveTimer == NULL)
   {
-    parse_json(response, responseJSON);
+    ESP_LOGE(TAG, "Failed to create keepalive timer");
+    return false;
   }
+  mq_touch(s);
+  xTimerStart(s->keepaliveTimer, 0);
   return true;
 }
 
-bool at_mq_connect(const mqConfig_t config)
+// 每个已连接的会话各自保活
+bool at_mq_keepalive_start()
 {
-  if (!validateMqConfig(&config))
+  if (!at_task_start(&reconnectTask, mq_reconnect_task, "at_mq_reconnect", NULL, 4, 0))
   {
-    ESP_LOGE(TAG, "Invalid config");
+    ESP_LOGE(TAG, "Failed to start reconnect task");
     return false;
   }
-  else
+  bool ok = false;
+  for (int i = 0; i < AT_MODEM_MAX; i++)
+  {
+    if (sessions[i].used)
+    {
+      ok = mq_keepalive_start(&sessions[i]) || ok;
+    }
+  }
+  if (!ok)
   {
-    mqconfig = config;
+    ESP_LOGE(TAG, "No MQ session to keep alive");
   }
-  char response[UART_BUF_SIZE];
+  return ok;
+}
+
+void at_mq_keepalive_get_stats(mqKeepaliveStats_t *out)
+{
+  at_mq_keepalive_get_stats_on(NULL, out);
+}
+
+void at_mq_keepalive_get_stats_on(at_modem_t *modem, mqKeepaliveStats_t *out)
+{
+  *out = mq_session_of(modem)->keepalive;
+}
+
+// 检查承载后依次 MCONFIG、MIPSTART、MCONNECT；服务端拒绝 MCONNECT 时 *refused 为 true
+static bool mq_open(mq_session_t *s, bool *refused)
+{
+  at_modem_t *m = s->modem;
+  *refused = false;
   // 基本检查
-  if (!at_check_base())
+  if (!at_check_base_on(m))
+  {
     return false;
+  }
   // PDP 检查
-  if (!at_check_pdp())
+  if (!at_check_pdp_on(m))
+  {
     return false;
+  }
 
   // 设置MQTT参数客户端ID，用户名，密码，遗嘱一般不设置
-  char command[UART_BUF_SIZE];
-  sprintf(command, "AT+MCONFIG=%s,%s,%s", config.clientId, config.username, config.password);
-  if (!at_send_command(command, "OK", 1000, response, false))
+  const at_dialect_t *d = at_modem_dialect(m);
+  at_scratch_t *scratch = at_modem_scratch_take(m);
+  char *command = scratch->command;
+  snprintf(command, UART_BUF_SIZE, d->mq_config, s->config.clientId, s->config.username, s->config.password);
+  if (!at_modem_send_command(m, AT_CHAN_MQ, command, "OK", 1000, NULL))
   {
+    at_modem_scratch_give(m, scratch);
     ESP_LOGE(TAG, "AT+MCONFIG failed");
     return false;
   }
 
   // 连接MQTT服务器,设置服务器地址和端口
-  sprintf(command, "AT+MIPSTART=%s,%s", config.server, config.port);
-  // 查看是否已经连接
-  if (!at_send_command(command, "CONNECT OK", 3000, NULL, false))
+  snprintf(command, UART_BUF_SIZE, d->mq_start, s->config.server, s->config.port);
+  // 新连接与已经连接都算成功
+  if (!at_modem_send_command(m, AT_CHAN_MQ, command, d->mq_start_ok, 3000, NULL))
   {
-    // 新连接
-    if (!at_send_command(command, "ALREADY CONNECT", 3000, NULL, false))
-    {
-      ESP_LOGE(TAG, "AT+MIPSTART failed");
-      return false;
-    }
+    at_modem_scratch_give(m, scratch);
+    ESP_LOGE(TAG, "AT+MIPSTART failed");
+    return false;
   }
   // 发起会话
   // AT+MCONNECT=1,120
-  if (!at_send_command("AT+MCONNECT=1,120", "CONNACK OK", 3000, NULL, false))
+  snprintf(command, UART_BUF_SIZE, d->mq_connect, AT_MQ_KEEPALIVE_S);
+  bool connected = at_modem_send_command(m, AT_CHAN_MQ, command, d->mq_connect_ok, 3000, NULL);
+  at_modem_scratch_give(m, scratch);
+  if (!connected)
   {
     ESP_LOGE(TAG, "AT+MCONNECT failed");
+    *refused = true;
+    return false;
+  }
+  return true;
+}
+
+bool at_mq_connect_on(at_modem_t *modem, const mqConfig_t config)
+{
+  if (!validateMqConfig(&config))
+  {
+    ESP_LOGE(TAG, "Invalid config");
+    return false;
+  }
+  mq_session_t *s = mq_session_of(modem);
+  at_modem_t *m = s->modem;
+  s->config = config;
+  s->used = true;
+  mq_session_init(s);
+  mq_route_init(s);
+  bool refused;
+  if (!mq_open(s, &refused))
+  {
+    mq_set_link(s, false);
+    if (!refused || at_modem_index(m) != 0)
+    {
+      // 其余实例的会话失败时由正常的会话承接流量，不重启整机
+      return false;
+    }
+    // 重启前把暂存区中的消息写入 flash
+    at_outbox_sync(2000);
     at_check_reset();
     esp_restart();
     return false;
   }
 
+  mq_set_link(s, true);
   return true;
 }
 
+bool at_mq_connect(const mqConfig_t config)
+{
+  return at_mq_connect_on(NULL, config);
+}
+
 bool getHeartbeatResponse(const char *res)
 {
   //  {
@@ -223,55 +1874,92 @@ bool getHeartbeatResponse(const char *res)
   return true;
 }
 
-bool at_mq_heartbeat()
+// 重连任务中调用：模组侧可能还留着半开的连接，先关闭再重新连接，之后恢复订阅
+static bool mq_reconnect(mq_session_t *s)
 {
-  char topic[UART_BUF_SIZE];
-  sprintf(topic, "/device/%s/ping", mqconfig.clientId);
-  ESP_LOGW(TAG, "Heartbeat topic: %s", topic);
-  cJSON *payload = cJSON_CreateObject();
-  cJSON_AddStringToObject(payload, "deviceId", mqconfig.clientId);
-  cJSON_AddStringToObject(payload, "projectInfoCode", "PJ202406050002");
-  char uuid[37];
-  generate_random_uuid(uuid, sizeof(uuid));
-  mqMessage_t heartbeat = {
-      .topic = topic,
-      .event = Ping,
-      .data = payload,
-      .time = get_current_timestamp_ms(),
-      .ttl = 5000,
-      .id = uuid,
-  };
-  char res[UART_BUF_SIZE];
-  if (at_mq_publish(heartbeat, "/ping/reply", res))
+  mq_close(s);
+  bool refused;
+  if (!mq_open(s, &refused))
   {
-    ESP_LOGW(TAG, "Heartbeat response %s", res);
-
-    return getHeartbeatResponse(res);
+    return false;
   }
-  return false;
+  for (int i = 0; i < s->subCount; i++)
+  {
+    if (!mq_subscribe(s, s->subs[i]))
+    {
+      return false;
+    }
+  }
+  return true;
 }
 
-void at_mq_heartbeat_task()
+// 依次重连标记的会话，各自按退避等待
+static void mq_reconnect_task()
 {
-  char topic[UART_BUF_SIZE];
-  sprintf(topic, "/device/%s/ping/#", mqconfig.clientId);
-  at_mq_subscribe(topic);
   while (1)
   {
-    if (!at_mq_heartbeat())
+    TickType_t wait = portMAX_DELAY;
+    for (int i = 0; i < AT_MODEM_MAX; i++)
     {
-      ESP_LOGE(TAG, "Heartbeat failed");
-      vTaskDelete(NULL);
+      mq_session_t *s = &sessions[i];
+      if (!s->reconnecting)
+      {
+        continue;
+      }
+      if (mq_reconnect(s))
+      {
+        ESP_LOGI(TAG, "Reconnected on modem %d", at_modem_index(s->modem));
+        s->reconnectDelayMs = 0;
+        s->keepaliveFails = 0;
+        s->reconnecting = false;
+        mq_touch(s);
+        mq_set_link(s, true);
+        mq_keepalive_arm(s, s->keepalive.interval_ms);
+        continue;
+      }
+      s->reconnectDelayMs = s->reconnectDelayMs == 0 ? MQ_RECONNECT_MIN_MS : s->reconnectDelayMs * 2;
+      if (s->reconnectDelayMs > MQ_RECONNECT_MAX_MS)
+      {
+        s->reconnectDelayMs = MQ_RECONNECT_MAX_MS;
+      }
+      ESP_LOGW(TAG, "Reconnect failed on modem %d, retry in %u ms", at_modem_index(s->modem),
+               (unsigned)s->reconnectDelayMs);
+      TickType_t ticks = pdMS_TO_TICKS(s->reconnectDelayMs);
+      if (ticks < wait)
+      {
+        wait = ticks;
+      }
     }
-    vTaskDelay(pdMS_TO_TICKS(30000));
+    ulTaskNotifyTake(pdTRUE, wait);
+  }
+}
+
+// 心跳回复 /device/<clientId>/ping/reply
+static void mq_ping_reply(const char *topic, const char *payload, size_t len, void *ctx)
+{
+  if (!getHeartbeatResponse(payload))
+  {
+    ESP_LOGW(TAG, "Unexpected heartbeat reply on %s", topic);
   }
 }
 
+// 每个会话订阅自己的心跳回复并启动所在实例的下行消息处理
 bool at_mq_listening()
 {
-  xTaskCreatePinnedToCore(at_mq_heartbeat_task, "at_mq_heartbeat_task", 4096, NULL, 5, NULL, 0);
-  xTaskCreatePinnedToCore(at_uart_listening, "at_uart_listening", 4096, NULL, 5, NULL, 1);
-  xTaskCreatePinnedToCore(message_handler_task, "message_handler_task", 4096, NULL, 5, NULL, 1);
+  char topic[UART_BUF_SIZE];
+  for (int i = 0; i < AT_MODEM_MAX; i++)
+  {
+    mq_session_t *s = &sessions[i];
+    if (!s->used)
+    {
+      continue;
+    }
+    sprintf(topic, "/device/%s/ping/#", s->config.clientId);
+    at_mq_add_route(topic, mq_ping_reply, NULL);
+    at_mq_subscribe_on(s->modem, topic);
+    at_modem_start_message_task(s->modem);
+  }
+  at_mq_keepalive_start();
   // 监听消息
   return true;
 }
\ No newline at end of file
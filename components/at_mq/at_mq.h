@@ -2,9 +2,107 @@
 #ifndef AT_MQ_H
 #define AT_MQ_H
 #include "at_config.h"
+#include "at_uart.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 发布攒批配置：同一 topic 的消息在窗口内合并成一个 JSON 数组，一次 AT+MPUBEX 发出
+typedef struct
+{
+  uint32_t window_ms; // 第一条消息入批后最长等待时间
+  size_t max_bytes;   // 单次 MPUBEX 的字节上限，0 或超过批次缓冲区时取缓冲区大小
+  int max_messages;   // 单批消息条数上限，0 不限制
+} mqBatchConfig_t;
+
+typedef struct
+{
+  uint32_t transactions; // 批量发出的 MPUBEX 次数
+  uint32_t messages;     // 经批量发出的消息数，messages / transactions 即每次事务的消息数
+  uint32_t failures;     // 发送失败的批次
+  uint32_t replayed;     // 失败批次中经其他会话或发件箱补发的消息
+  uint64_t bytes_sent;   // 命令加数据的串口字节数
+  uint64_t bytes_saved;  // 相比逐条发送省下的串口字节数
+} mqBatchStats_t;
+#define AT_MQ_KEEPALIVE_S 120 // AT+MCONNECT 的 keepalive
+
+typedef struct
+{
+  uint32_t interval_ms;    // 当前心跳间隔
+  uint32_t nat_timeout_ms; // 观测到的 NAT 超时，0 表示未观测到
+  uint32_t pings;          // 发出的心跳
+  uint32_t skipped;        // 因窗口内有流量而顺延的次数
+  uint32_t failures;
+} mqKeepaliveStats_t;
+
+// 多个模组实例时的上行分配策略
+typedef enum
+{
+  MQ_POLICY_FAILOVER, // 总是用序号最小的正常会话，它断开后才换下一个
+  MQ_POLICY_BALANCE,  // 在所有正常的会话之间轮转
+} mqPolicy_t;
+
+typedef struct
+{
+  bool connected;     // 调用过 at_mq_connect_on
+  bool linkUp;
+  uint32_t published; // 经本会话发出的消息数，含批量
+  uint32_t failovers; // 其他会话失败后转由本会话发出的次数
+} mqSessionStats_t;
+
 bool at_mq_connect(const mqConfig_t config);
+// 在指定模组实例上建立 MQTT 会话，每个实例一个；各会话应使用不同的 clientId，
+// 否则服务端会踢掉先连上的一个。第一个建立的会话为主会话
+bool at_mq_connect_on(at_modem_t *modem, const mqConfig_t config);
+void at_mq_set_policy(mqPolicy_t policy);
+void at_mq_session_get_stats(at_modem_t *modem, mqSessionStats_t *out);
+// 发布按策略选择会话，发送失败时转由其余正常的会话发出，都失败才进入发件箱；
+// 需要同步取回复（responseJSON 非 NULL）的发布只走主会话
 bool at_mq_publish(const mqMessage_t message,char *expected_response,char *responseJSON);
+// 订阅在主会话上
 void at_mq_subscribe(const char *topic);
+void at_mq_subscribe_on(at_modem_t *modem, const char *topic);
+
+// 下行消息回调，在 message_handler_task 中调用；topic 与 payload 指向接收缓冲区并以 0 结尾，
+// 仅在回调期间有效，len 为 payload 的字节数
+typedef void (*at_mq_handler_t)(const char *topic, const char *payload, size_t len, void *ctx);
+// 注册下行路由，filter 支持 MQTT 的 + 与 # 通配符，同一过滤器再次注册时替换回调；
+// 一条消息分发给所有匹配的过滤器。不可在回调中注册
+bool at_mq_add_route(const char *filter, at_mq_handler_t handler, void *ctx);
+
+// 按 topic 选择上行报文编码（见 mqEncoding_t），filter 支持 + 与 # 通配符，先注册的先匹配，
+// 同一过滤器再次设置时替换；都不匹配时使用默认编码，初始为 JSON。应在发布前配置。
+// 需要同步取回复（responseJSON 非 NULL）的发布总是使用 JSON；
+// 下行的 CBOR 消息按首字节识别，还原为 JSON 后再交给路由回调
+bool at_mq_set_encoding(const char *filter, mqEncoding_t encoding);
+void at_mq_set_default_encoding(mqEncoding_t encoding);
+mqEncoding_t at_mq_encoding_for(const char *topic);
 bool at_mq_free();
+// 每个会话订阅心跳回复，开启保活并启动下行消息处理
 bool at_mq_listening();
+
+// 定时器驱动的保活：空闲满一个间隔才发心跳，有发布或下行消息时顺延；
+// 间隔随 keepalive 与观测到的 NAT 超时调整，失败按退避重试，连续失败后标记链路断开，
+// 由后台任务重新 MIPSTART/MCONNECT 并恢复经 at_mq_subscribe* 成功订阅过的 topic，
+// 重连失败按退避重试，成功后恢复心跳。每个会话各自保活，统计按会话分开
+bool at_mq_keepalive_start();
+void at_mq_keepalive_get_stats(mqKeepaliveStats_t *out);
+void at_mq_keepalive_get_stats_on(at_modem_t *modem, mqKeepaliveStats_t *out);
+
+// 开启断网暂存：链路断开时 at_mq_publish 把消息写入 flash 发件箱，重新连上后按先后顺序补发
+// 需要 "outbox" 分区，linux 目标使用镜像文件，见 at_outbox.h
+bool at_mq_outbox_enable();
+
+// 开启攒批，之后可以使用 at_mq_publish_batched
+bool at_mq_batch_enable(const mqBatchConfig_t *config);
+// 入批后立即返回，不等待服务端回复；urgent 为 true 时连同本条立即发出
+// 与 at_mq_publish 相同，message.data 的所有权交给本函数
+bool at_mq_publish_batched(const mqMessage_t message, bool urgent);
+// 立即发出所有未满的批次
+void at_mq_batch_flush();
+void at_mq_batch_get_stats(mqBatchStats_t *out);
+
+// 开启遥测：每 interval_ms 把这段时间内的 AT 命令统计（见 at_metrics.h）
+// 发布到 /device/<clientId>/telemetry
+bool at_mq_telemetry_enable(uint32_t interval_ms);
 #endif
\ No newline at end of file
@@ -0,0 +1,597 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/message_buffer.h"
+#include "esp_log.h"
+#include "at_utils.h"
+#include "at_outbox.h"
+#include "at_outbox_flash.h"
+#include "at_task.h"
+
+#define OUTBOX_SEGMENT_MAGIC 0x3158424FU // "OBX1"
+#define OUTBOX_RECORD_MAGIC 0xA55A
+#define OUTBOX_SEQ_FREE 0xFFFFFFFFU
+#define OUTBOX_STATE_PENDING 0xFFFFFFFFU
+#define OUTBOX_STATE_DONE 0U
+#define OUTBOX_MAX_RECORD 1024    // 单条记录上限（含记录头）
+#define OUTBOX_STAGING_SIZE 8192  // put -> 后台任务 的内存暂存区
+#define OUTBOX_DRAIN_STEP 16      // 每轮补发的记录数，轮间先把暂存区写入 flash
+#define OUTBOX_TASK_STACK 2560    // 后台任务栈预算，含补发回调
+#define OUTBOX_ALIGN(n) (((n) + 3) & ~(size_t)3)
+
+static const char *TAG = "OUTBOX";
+
+// 段头，擦除后立即写入 magic 和擦除次数，启用时再写入 seq
+typedef struct
+{
+  uint32_t magic;
+  uint32_t erases; // 累计擦除次数，轮转时优先使用擦除次数少的空闲段
+  uint32_t seq;    // 启用顺序，OUTBOX_SEQ_FREE 为空闲段
+  uint32_t reserved;
+} outbox_seg_hdr_t;
+
+// 记录头，magic 在整条记录写完后单独写入，作为提交标记
+typedef struct
+{
+  uint16_t magic;
+  uint16_t len;   // 记录头之后的负载长度
+  uint32_t crc;   // 负载 CRC32
+  uint32_t state; // 处理完（补发、过期或损坏）后写为 0
+} outbox_rec_hdr_t;
+
+// 负载开头的定长部分，之后依次为 topic、id、data，均不含结尾 0
+typedef struct
+{
+  uint64_t time;
+  uint64_t ttl;
+  uint16_t topicLen;
+  uint16_t idLen;
+  uint16_t dataLen;
+  uint8_t event;
+  uint8_t reserved;
+} outbox_rec_meta_t;
+
+// 段的内存索引，只由后台任务访问
+typedef struct
+{
+  uint32_t seq;
+  uint32_t erases;
+  uint16_t used;     // 写入位置
+  uint16_t read;     // 第一条可能待发记录的位置
+  uint16_t pending;  // 待发记录数
+} outbox_seg_t;
+
+static outbox_seg_t *segs = NULL;
+static int segCount = 0;
+static int head = -1; // 正在写入的段
+static uint32_t nextSeq = 0;
+
+static at_outbox_send_fn_t sendFn = NULL;
+static void *sendCtx = NULL;
+AT_TASK_DEFINE(outboxTask, OUTBOX_TASK_STACK);
+// 暂存区常驻，静态分配，不在初始化时向堆申请
+static MessageBufferHandle_t staging = NULL;
+static StaticMessageBuffer_t stagingStruct;
+static uint8_t stagingStorage[OUTBOX_STAGING_SIZE + 1];
+static SemaphoreHandle_t putLock = NULL;
+static SemaphoreHandle_t statsLock = NULL;
+static at_outbox_stats_t stats;
+static uint32_t staged = 0; // 已进入暂存区但尚未写入 flash 的记录，由 statsLock 保护
+static volatile bool draining = false;
+
+static uint8_t stageScratch[OUTBOX_MAX_RECORD]; // 由 putLock 保护
+static uint8_t recordBuf[OUTBOX_MAX_RECORD + 1]; // 只由后台任务使用，多一个字节给 data 的结尾 0
+
+static uint32_t outbox_crc32(const uint8_t *data, size_t len)
+{
+  // 半字节查表，表只有 16 项
+  static const uint32_t table[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+      0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+  };
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++)
+  {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+static void stats_add(uint32_t *counter, uint32_t n)
+{
+  xSemaphoreTake(statsLock, portMAX_DELAY);
+  *counter += n;
+  xSemaphoreGive(statsLock);
+}
+
+static void stats_pending(int delta)
+{
+  xSemaphoreTake(statsLock, portMAX_DELAY);
+  stats.pending += delta;
+  xSemaphoreGive(statsLock);
+}
+
+// 擦除一段并写入段头，段变为空闲
+static bool outbox_format(int index, uint32_t erases)
+{
+  size_t base = (size_t)index * AT_OUTBOX_SEGMENT_SIZE;
+  if (!at_outbox_flash_erase(base, AT_OUTBOX_SEGMENT_SIZE))
+  {
+    ESP_LOGE(TAG, "Failed to erase segment %d", index);
+    return false;
+  }
+  stats_add(&stats.erases, 1);
+  outbox_seg_hdr_t hdr = {
+      .magic = OUTBOX_SEGMENT_MAGIC,
+      .erases = erases,
+      .seq = OUTBOX_SEQ_FREE,
+      .reserved = 0xFFFFFFFF,
+  };
+  if (!at_outbox_flash_write(base, &hdr, sizeof(hdr)))
+  {
+    ESP_LOGE(TAG, "Failed to write segment %d header", index);
+    return false;
+  }
+  segs[index] = (outbox_seg_t){
+      .seq = OUTBOX_SEQ_FREE,
+      .erases = erases,
+      .used = sizeof(outbox_seg_hdr_t),
+      .read = sizeof(outbox_seg_hdr_t),
+      .pending = 0,
+  };
+  return true;
+}
+
+static bool outbox_rec_len_valid(uint16_t len, size_t offset)
+{
+  return len >= sizeof(outbox_rec_meta_t) && len <= OUTBOX_MAX_RECORD - sizeof(outbox_rec_hdr_t) &&
+         offset + sizeof(outbox_rec_hdr_t) + len <= AT_OUTBOX_SEGMENT_SIZE;
+}
+
+// 启动时扫描一个已启用的段，重建写入位置和待发记录数
+static void outbox_scan(int index)
+{
+  size_t base = (size_t)index * AT_OUTBOX_SEGMENT_SIZE;
+  outbox_seg_t *seg = &segs[index];
+  size_t offset = sizeof(outbox_seg_hdr_t);
+  seg->read = offset;
+  seg->pending = 0;
+  while (offset + sizeof(outbox_rec_hdr_t) <= AT_OUTBOX_SEGMENT_SIZE)
+  {
+    outbox_rec_hdr_t hdr;
+    if (!at_outbox_flash_read(base + offset, &hdr, sizeof(hdr)))
+    {
+      break;
+    }
+    if (hdr.magic == 0xFFFF && hdr.len == 0xFFFF && hdr.crc == 0xFFFFFFFF)
+    {
+      // 擦除状态，段内写入到此为止
+      seg->used = offset;
+      return;
+    }
+    if (!outbox_rec_len_valid(hdr.len, offset))
+    {
+      break;
+    }
+    if (hdr.magic == OUTBOX_RECORD_MAGIC && hdr.state != OUTBOX_STATE_DONE)
+    {
+      seg->pending++;
+    }
+    // magic 未写入的是掉电时写了一半的记录，按长度跳过
+    offset += OUTBOX_ALIGN(sizeof(hdr) + hdr.len);
+  }
+  // 段尾或无法解析的内容，之后不再向该段写入
+  seg->used = AT_OUTBOX_SEGMENT_SIZE;
+}
+
+static void outbox_mark_done(int index, size_t offset)
+{
+  uint32_t done = OUTBOX_STATE_DONE;
+  at_outbox_flash_write((size_t)index * AT_OUTBOX_SEGMENT_SIZE + offset + offsetof(outbox_rec_hdr_t, state), &done, sizeof(done));
+  segs[index].pending--;
+  stats_pending(-1);
+}
+
+static int outbox_oldest()
+{
+  int oldest = -1;
+  for (int i = 0; i < segCount; i++)
+  {
+    if (segs[i].seq != OUTBOX_SEQ_FREE && (oldest < 0 || segs[i].seq < segs[oldest].seq))
+    {
+      oldest = i;
+    }
+  }
+  return oldest;
+}
+
+// 轮转到新段：取擦除次数最少的空闲段，没有空闲段时丢弃最旧的段
+static bool outbox_rotate()
+{
+  int next = -1;
+  for (int i = 0; i < segCount; i++)
+  {
+    if (segs[i].seq == OUTBOX_SEQ_FREE && (next < 0 || segs[i].erases < segs[next].erases))
+    {
+      next = i;
+    }
+  }
+  if (next < 0)
+  {
+    next = outbox_oldest();
+    if (segs[next].pending > 0)
+    {
+      ESP_LOGW(TAG, "Outbox full, dropping %u records", segs[next].pending);
+      stats_add(&stats.dropped, segs[next].pending);
+      stats_pending(-(int)segs[next].pending);
+    }
+    if (!outbox_format(next, segs[next].erases + 1))
+    {
+      return false;
+    }
+  }
+  uint32_t seq = nextSeq++;
+  if (!at_outbox_flash_write((size_t)next * AT_OUTBOX_SEGMENT_SIZE + offsetof(outbox_seg_hdr_t, seq), &seq, sizeof(seq)))
+  {
+    ESP_LOGE(TAG, "Failed to activate segment %d", next);
+    return false;
+  }
+  segs[next].seq = seq;
+  head = next;
+  return true;
+}
+
+// 把一条已编码的记录追加到日志
+static bool outbox_append(uint8_t *record, size_t len)
+{
+  size_t space = OUTBOX_ALIGN(len);
+  if (head < 0 || segs[head].used + space > AT_OUTBOX_SEGMENT_SIZE)
+  {
+    if (!outbox_rotate())
+    {
+      return false;
+    }
+  }
+  outbox_seg_t *seg = &segs[head];
+  size_t offset = (size_t)head * AT_OUTBOX_SEGMENT_SIZE + seg->used;
+  // 先写除 magic 外的全部内容，再写 magic 提交
+  uint16_t magic = OUTBOX_RECORD_MAGIC;
+  memset(record, 0xFF, sizeof(magic));
+  bool ok = at_outbox_flash_write(offset, record, len) && at_outbox_flash_write(offset, &magic, sizeof(magic));
+  seg->used += space;
+  if (!ok)
+  {
+    ESP_LOGE(TAG, "Failed to write record at 0x%x", (unsigned)offset);
+    return false;
+  }
+  seg->pending++;
+  return true;
+}
+
+// 把暂存区中的记录全部写入 flash
+static void outbox_flush_staged()
+{
+  size_t len;
+  while ((len = xMessageBufferReceive(staging, recordBuf, OUTBOX_MAX_RECORD, 0)) > 0)
+  {
+    bool ok = outbox_append(recordBuf, len);
+    xSemaphoreTake(statsLock, portMAX_DELAY);
+    staged--;
+    if (ok)
+    {
+      stats.stored++;
+      stats.pending++;
+    }
+    else
+    {
+      stats.rejected++;
+    }
+    xSemaphoreGive(statsLock);
+  }
+}
+
+// 处理一条记录，返回 false 表示发送失败需要停止补发
+static bool outbox_deliver(int index, size_t offset, const outbox_rec_hdr_t *hdr, uint64_t now)
+{
+  size_t base = (size_t)index * AT_OUTBOX_SEGMENT_SIZE + offset + sizeof(*hdr);
+  if (!at_outbox_flash_read(base, recordBuf, hdr->len) || outbox_crc32(recordBuf, hdr->len) != hdr->crc)
+  {
+    ESP_LOGW(TAG, "Corrupt record in segment %d at 0x%x", index, (unsigned)offset);
+    stats_add(&stats.corrupt, 1);
+    outbox_mark_done(index, offset);
+    return true;
+  }
+  outbox_rec_meta_t meta;
+  memcpy(&meta, recordBuf, sizeof(meta));
+  if (sizeof(meta) + meta.topicLen + meta.idLen + meta.dataLen != hdr->len)
+  {
+    stats_add(&stats.corrupt, 1);
+    outbox_mark_done(index, offset);
+    return true;
+  }
+  if (meta.ttl != 0 && meta.time != 0 && now > meta.time + meta.ttl)
+  {
+    stats_add(&stats.expired, 1);
+    outbox_mark_done(index, offset);
+    return true;
+  }
+  // topic 与 id 后面紧跟下一个字段，先取出再补结尾 0
+  char topic[128];
+  char id[64];
+  char *strings = (char *)recordBuf + sizeof(meta);
+  if (meta.topicLen >= sizeof(topic) || meta.idLen >= sizeof(id))
+  {
+    stats_add(&stats.corrupt, 1);
+    outbox_mark_done(index, offset);
+    return true;
+  }
+  memcpy(topic, strings, meta.topicLen);
+  topic[meta.topicLen] = '\0';
+  memcpy(id, strings + meta.topicLen, meta.idLen);
+  id[meta.idLen] = '\0';
+  char *data = strings + meta.topicLen + meta.idLen;
+  data[meta.dataLen] = '\0';
+  at_outbox_msg_t msg = {
+      .topic = topic,
+      .id = id,
+      .data = data,
+      .dataLen = meta.dataLen,
+      .event = meta.event,
+      .time = meta.time,
+      .ttl = meta.ttl,
+  };
+  if (!sendFn(&msg, sendCtx))
+  {
+    return false;
+  }
+  stats_add(&stats.sent, 1);
+  outbox_mark_done(index, offset);
+  return true;
+}
+
+// 按段的启用顺序补发最多 OUTBOX_DRAIN_STEP 条，全部发完或发送失败时结束补发
+static void outbox_drain_step()
+{
+  int budget = OUTBOX_DRAIN_STEP;
+  uint64_t now = get_current_timestamp_ms();
+  while (budget > 0)
+  {
+    int index = outbox_oldest();
+    // 跳过没有待发记录的段：除正在写入的段外直接回收
+    while (index >= 0 && segs[index].pending == 0)
+    {
+      if (index == head)
+      {
+        index = -1;
+        break;
+      }
+      if (!outbox_format(index, segs[index].erases + 1))
+      {
+        draining = false;
+        return;
+      }
+      index = outbox_oldest();
+    }
+    if (index < 0)
+    {
+      draining = false;
+      return;
+    }
+    outbox_seg_t *seg = &segs[index];
+    while (budget > 0 && seg->pending > 0 && seg->read + sizeof(outbox_rec_hdr_t) <= seg->used)
+    {
+      outbox_rec_hdr_t hdr;
+      if (!at_outbox_flash_read((size_t)index * AT_OUTBOX_SEGMENT_SIZE + seg->read, &hdr, sizeof(hdr)) ||
+          !outbox_rec_len_valid(hdr.len, seg->read))
+      {
+        // 扫描时已确认过长度，这里读不出来只能放弃该段剩余的记录
+        stats_add(&stats.corrupt, seg->pending);
+        stats_pending(-(int)seg->pending);
+        seg->pending = 0;
+        break;
+      }
+      if (hdr.magic == OUTBOX_RECORD_MAGIC && hdr.state != OUTBOX_STATE_DONE)
+      {
+        budget--;
+        if (!outbox_deliver(index, seg->read, &hdr, now))
+        {
+          draining = false;
+          return;
+        }
+      }
+      seg->read += OUTBOX_ALIGN(sizeof(hdr) + hdr.len);
+    }
+    if (seg->pending > 0 && seg->read + sizeof(outbox_rec_hdr_t) > seg->used)
+    {
+      // 计数与内容不一致，以内容为准
+      stats_pending(-(int)seg->pending);
+      seg->pending = 0;
+    }
+  }
+}
+
+static void outbox_task()
+{
+  while (1)
+  {
+    ulTaskNotifyTake(pdTRUE, draining ? 0 : portMAX_DELAY);
+    outbox_flush_staged();
+    if (draining)
+    {
+      outbox_drain_step();
+    }
+  }
+}
+
+bool at_outbox_init(at_outbox_send_fn_t send, void *ctx)
+{
+  if (outboxTask.handle != NULL)
+  {
+    return true;
+  }
+  if (send == NULL || !at_outbox_flash_open())
+  {
+    return false;
+  }
+  segCount = at_outbox_flash_size() / AT_OUTBOX_SEGMENT_SIZE;
+  if (segCount < 2)
+  {
+    ESP_LOGE(TAG, "Outbox needs at least 2 segments, got %d", segCount);
+    return false;
+  }
+  segs = calloc(segCount, sizeof(outbox_seg_t));
+  statsLock = xSemaphoreCreateMutex();
+  putLock = xSemaphoreCreateMutex();
+  if (staging == NULL)
+  {
+    staging = xMessageBufferCreateStatic(OUTBOX_STAGING_SIZE, stagingStorage, &stagingStruct);
+  }
+  if (segs == NULL || statsLock == NULL || putLock == NULL || staging == NULL)
+  {
+    ESP_LOGE(TAG, "Failed to allocate outbox");
+    return false;
+  }
+  sendFn = send;
+  sendCtx = ctx;
+
+  for (int i = 0; i < segCount; i++)
+  {
+    outbox_seg_hdr_t hdr;
+    if (!at_outbox_flash_read((size_t)i * AT_OUTBOX_SEGMENT_SIZE, &hdr, sizeof(hdr)) || hdr.magic != OUTBOX_SEGMENT_MAGIC)
+    {
+      // 从未使用过或段头损坏
+      outbox_format(i, 0);
+      continue;
+    }
+    segs[i].seq = hdr.seq;
+    segs[i].erases = hdr.erases;
+    if (hdr.seq == OUTBOX_SEQ_FREE)
+    {
+      segs[i].used = segs[i].read = sizeof(outbox_seg_hdr_t);
+      continue;
+    }
+    outbox_scan(i);
+    stats.pending += segs[i].pending;
+    if (hdr.seq >= nextSeq)
+    {
+      nextSeq = hdr.seq + 1;
+      head = i;
+    }
+  }
+  stats.segments = segCount;
+  ESP_LOGI(TAG, "Outbox ready: %d segments, %u pending", segCount, (unsigned)stats.pending);
+
+  at_task_start(&outboxTask, outbox_task, "at_outbox", NULL, 4, 0);
+  return true;
+}
+
+bool at_outbox_put(const at_outbox_msg_t *msg)
+{
+  if (outboxTask.handle == NULL || msg == NULL || msg->topic == NULL || msg->id == NULL || msg->data == NULL)
+  {
+    return false;
+  }
+  outbox_rec_meta_t meta = {
+      .time = msg->time,
+      .ttl = msg->ttl,
+      .topicLen = strlen(msg->topic),
+      .idLen = strlen(msg->id),
+      .dataLen = msg->dataLen,
+      .event = msg->event,
+      .reserved = 0xFF,
+  };
+  size_t len = sizeof(outbox_rec_hdr_t) + sizeof(meta) + meta.topicLen + meta.idLen + meta.dataLen;
+  if (len > OUTBOX_MAX_RECORD)
+  {
+    ESP_LOGE(TAG, "Message too large for outbox: %u bytes", (unsigned)len);
+    stats_add(&stats.rejected, 1);
+    return false;
+  }
+
+  xSemaphoreTake(putLock, portMAX_DELAY);
+  if (xMessageBufferSpacesAvailable(staging) < len + sizeof(size_t))
+  {
+    xSemaphoreGive(putLock);
+    stats_add(&stats.rejected, 1);
+    return false;
+  }
+  uint8_t *p = stageScratch + sizeof(outbox_rec_hdr_t);
+  memcpy(p, &meta, sizeof(meta));
+  p += sizeof(meta);
+  memcpy(p, msg->topic, meta.topicLen);
+  p += meta.topicLen;
+  memcpy(p, msg->id, meta.idLen);
+  p += meta.idLen;
+  memcpy(p, msg->data, meta.dataLen);
+  size_t payloadLen = len - sizeof(outbox_rec_hdr_t);
+  outbox_rec_hdr_t hdr = {
+      .magic = 0xFFFF,
+      .len = payloadLen,
+      .crc = outbox_crc32(stageScratch + sizeof(outbox_rec_hdr_t), payloadLen),
+      .state = OUTBOX_STATE_PENDING,
+  };
+  memcpy(stageScratch, &hdr, sizeof(hdr));
+  stats_add(&staged, 1);
+  bool ok = xMessageBufferSend(staging, stageScratch, len, 0) == len;
+  xSemaphoreGive(putLock);
+  if (!ok)
+  {
+    xSemaphoreTake(statsLock, portMAX_DELAY);
+    staged--;
+    stats.rejected++;
+    xSemaphoreGive(statsLock);
+    return false;
+  }
+  xTaskNotifyGive(outboxTask.handle);
+  return true;
+}
+
+void at_outbox_drain()
+{
+  if (outboxTask.handle == NULL)
+  {
+    return;
+  }
+  draining = true;
+  xTaskNotifyGive(outboxTask.handle);
+}
+
+bool at_outbox_sync(int timeout_ms)
+{
+  if (outboxTask.handle == NULL)
+  {
+    return true;
+  }
+  for (int waited = 0;; waited += 10)
+  {
+    xSemaphoreTake(statsLock, portMAX_DELAY);
+    uint32_t left = staged;
+    xSemaphoreGive(statsLock);
+    if (left == 0)
+    {
+      return true;
+    }
+    if (waited >= timeout_ms)
+    {
+      return false;
+    }
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+void at_outbox_get_stats(at_outbox_stats_t *out)
+{
+  if (outboxTask.handle == NULL)
+  {
+    memset(out, 0, sizeof(*out));
+    return;
+  }
+  xSemaphoreTake(statsLock, portMAX_DELAY);
+  *out = stats;
+  xSemaphoreGive(statsLock);
+}
@@ -0,0 +1,53 @@
+#ifndef AT_OUTBOX_H
+#define AT_OUTBOX_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+// 断网期间的 MQ 发件箱：记录追加写入 flash 上的环形日志，联网后按先后顺序补发
+// 分区按段组织，每段一个扇区，写满后轮转到下一段，环满时丢弃最旧的一段
+
+#define AT_OUTBOX_SEGMENT_SIZE 4096
+
+typedef struct
+{
+  const char *topic;
+  const char *id;
+  const char *data; // 已编码的 data JSON，补发时以 0 结尾
+  size_t dataLen;
+  uint8_t event;
+  uint64_t time;
+  uint64_t ttl;     // 与 time 相加即过期时间，过期的记录不再补发
+} at_outbox_msg_t;
+
+// 补发一条记录，在发件箱任务中调用，返回 false 时停止本轮补发，记录保留
+typedef bool (*at_outbox_send_fn_t)(const at_outbox_msg_t *msg, void *ctx);
+
+typedef struct
+{
+  uint32_t stored;   // 写入 flash 的记录
+  uint32_t sent;     // 补发成功
+  uint32_t expired;  // 过期未发
+  uint32_t dropped;  // 环满时随最旧的段一起丢弃
+  uint32_t rejected; // 暂存区满，put 直接返回 false
+  uint32_t corrupt;  // CRC 校验失败
+  uint32_t pending;  // 当前待补发
+  uint32_t erases;   // 本次启动以来的擦除次数
+  uint32_t segments;
+} at_outbox_stats_t;
+
+bool at_outbox_init(at_outbox_send_fn_t send, void *ctx);
+// 复制到内存暂存区后立即返回，由后台任务写入 flash，不会因擦写阻塞
+bool at_outbox_put(const at_outbox_msg_t *msg);
+// 通知后台任务开始补发
+void at_outbox_drain();
+// 等待暂存区写入 flash，用于重启前
+bool at_outbox_sync(int timeout_ms);
+void at_outbox_get_stats(at_outbox_stats_t *out);
+
+#if CONFIG_IDF_TARGET_LINUX
+// linux 目标：指定分区镜像文件
+void at_outbox_set_image(const char *path);
+#endif
+#endif
@@ -0,0 +1,14 @@
+#ifndef AT_OUTBOX_FLASH_H
+#define AT_OUTBOX_FLASH_H
+#include <stdbool.h>
+#include <stddef.h>
+
+// 发件箱存储后端：ESP32 上为 "outbox" 分区，linux 目标上为镜像文件
+// 语义与 NOR flash 相同，擦除后为 0xFF，写入只能把 1 变成 0
+bool at_outbox_flash_open(void);
+size_t at_outbox_flash_size(void);
+bool at_outbox_flash_read(size_t offset, void *buf, size_t len);
+bool at_outbox_flash_write(size_t offset, const void *buf, size_t len);
+// offset 与 len 需按 AT_OUTBOX_SEGMENT_SIZE 对齐
+bool at_outbox_flash_erase(size_t offset, size_t len);
+#endif
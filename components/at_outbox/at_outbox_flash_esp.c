@@ -0,0 +1,40 @@
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "at_outbox_flash.h"
+
+#define OUTBOX_PARTITION "outbox"
+
+static const char *TAG = "OUTBOX_FLASH";
+static const esp_partition_t *partition = NULL;
+
+bool at_outbox_flash_open(void)
+{
+  partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, OUTBOX_PARTITION);
+  if (partition == NULL)
+  {
+    ESP_LOGE(TAG, "Partition \"%s\" not found", OUTBOX_PARTITION);
+    return false;
+  }
+  ESP_LOGI(TAG, "Outbox partition at 0x%lx, %lu bytes", (unsigned long)partition->address, (unsigned long)partition->size);
+  return true;
+}
+
+size_t at_outbox_flash_size(void)
+{
+  return partition ? partition->size : 0;
+}
+
+bool at_outbox_flash_read(size_t offset, void *buf, size_t len)
+{
+  return esp_partition_read(partition, offset, buf, len) == ESP_OK;
+}
+
+bool at_outbox_flash_write(size_t offset, const void *buf, size_t len)
+{
+  return esp_partition_write(partition, offset, buf, len) == ESP_OK;
+}
+
+bool at_outbox_flash_erase(size_t offset, size_t len)
+{
+  return esp_partition_erase_range(partition, offset, len) == ESP_OK;
+}
@@ -0,0 +1,113 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "at_outbox.h"
+#include "at_outbox_flash.h"
+
+#define DEFAULT_IMAGE "outbox.img"
+#define DEFAULT_IMAGE_SIZE (512 * 1024)
+
+static const char *TAG = "OUTBOX_FLASH";
+static char imagePath[128] = {0};
+static int fd = -1;
+static size_t imageSize = 0;
+
+// 指定分区镜像文件，未指定时读取环境变量 AT_OUTBOX_IMAGE
+void at_outbox_set_image(const char *path)
+{
+  strncpy(imagePath, path, sizeof(imagePath) - 1);
+  imagePath[sizeof(imagePath) - 1] = '\0';
+}
+
+bool at_outbox_flash_open(void)
+{
+  const char *path = imagePath[0] ? imagePath : getenv("AT_OUTBOX_IMAGE");
+  if (path == NULL)
+  {
+    path = DEFAULT_IMAGE;
+  }
+  fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+  {
+    ESP_LOGE(TAG, "Failed to open %s: %s", path, strerror(errno));
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size >= AT_OUTBOX_SEGMENT_SIZE)
+  {
+    imageSize = st.st_size - st.st_size % AT_OUTBOX_SEGMENT_SIZE;
+  }
+  else
+  {
+    // 新镜像，整个填成擦除状态
+    imageSize = DEFAULT_IMAGE_SIZE;
+    if (!at_outbox_flash_erase(0, imageSize))
+    {
+      close(fd);
+      fd = -1;
+      return false;
+    }
+  }
+  ESP_LOGI(TAG, "Outbox image %s, %u bytes", path, (unsigned)imageSize);
+  return true;
+}
+
+size_t at_outbox_flash_size(void)
+{
+  return imageSize;
+}
+
+bool at_outbox_flash_read(size_t offset, void *buf, size_t len)
+{
+  return offset + len <= imageSize && pread(fd, buf, len, offset) == (ssize_t)len;
+}
+
+bool at_outbox_flash_write(size_t offset, const void *buf, size_t len)
+{
+  if (offset + len > imageSize)
+  {
+    return false;
+  }
+  // 模拟 NOR flash：只能把 1 写成 0
+  uint8_t old[256];
+  const uint8_t *src = buf;
+  while (len > 0)
+  {
+    size_t n = len < sizeof(old) ? len : sizeof(old);
+    if (pread(fd, old, n, offset) != (ssize_t)n)
+    {
+      return false;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+      old[i] &= src[i];
+    }
+    if (pwrite(fd, old, n, offset) != (ssize_t)n)
+    {
+      return false;
+    }
+    offset += n;
+    src += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool at_outbox_flash_erase(size_t offset, size_t len)
+{
+  uint8_t erased[AT_OUTBOX_SEGMENT_SIZE];
+  memset(erased, 0xFF, sizeof(erased));
+  for (size_t done = 0; done < len; done += sizeof(erased))
+  {
+    if (pwrite(fd, erased, sizeof(erased), offset + done) != (ssize_t)sizeof(erased))
+    {
+      return false;
+    }
+  }
+  return true;
+}
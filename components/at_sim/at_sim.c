@@ -0,0 +1,1427 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "at_codec.h"
+#include "at_sim.h"
+
+#define SIM_CMD_MAX 512
+#define SIM_DATA_MAX (64 * 1024)
+#define SIM_SUB_MAX 8
+#define SIM_FAIL_MAX 8
+#define SIM_TOPIC_MAX 128
+#define SIM_DATA_IDLE_MS 200 // 数据模式下超过该时间没有新字节即视为输入结束
+#define SIM_DLC_MAX 4        // DLCI 0 为未复用的串口，1~3 为复用后的虚拟通道
+#define SIM_MUX_FRAME_MAX 1024
+#define SIM_MUX_FLAG 0xF9
+#define SIM_MUX_SABM 0x2F
+#define SIM_MUX_UA 0x63
+#define SIM_MUX_DM 0x0F
+#define SIM_MUX_DISC 0x43
+#define SIM_MUX_UIH 0xEF
+#define SIM_MUX_PF 0x10
+
+static const char *TAG = "AT_SIM";
+
+typedef enum
+{
+  SIM_DATA_NONE,
+  SIM_DATA_MPUBEX,
+  SIM_DATA_HTTP,
+  SIM_DATA_SMS,
+} sim_data_mode_t;
+
+typedef struct
+{
+  char verb[32];
+  int count;
+} sim_fail_t;
+
+struct sim_modem;
+
+// 一个 AT 会话：未复用时只有 DLCI 0；进入 CMUX 后每条 DLC 一个，由各自的线程处理，
+// 一条 DLC 上的慢命令不影响其他 DLC
+typedef struct
+{
+  struct sim_modem *modem;
+  int dlci;
+  bool open;
+  bool echo;
+  sim_data_mode_t dataMode;
+  size_t dataExpected;
+  size_t dataLen;
+  char dataTopic[SIM_TOPIC_MAX];
+  uint8_t *dataBuf;
+  char cmd[SIM_CMD_MAX];
+  size_t cmdLen;
+  int64_t lastData;
+  int pipe[2]; // 解帧线程 -> 会话线程
+  pthread_t thread;
+} sim_session_t;
+
+// 一个模拟模组：各自的 pty、线程与状态，多模组测试时互不影响
+typedef struct sim_modem
+{
+  at_sim_config_t cfg;
+  at_sim_stats_t stats;
+  pthread_mutex_t lock;      // 保护配置与状态
+  pthread_mutex_t writeLock; // 串行化输出
+  pthread_t modemThread;
+  pthread_t urcThread;
+  volatile bool running;
+  int masterFd;
+  char slavePath[128];
+  char urcTopic[SIM_TOPIC_MAX];
+  char urcPayload[SIM_CMD_MAX];
+  sim_session_t sessions[SIM_DLC_MAX];
+
+  // 多路复用：解帧只在 modem 线程中进行
+  volatile bool muxMode;
+  int muxN1;  // AT+CMUX 协商的最大帧长
+  int mqDlci; // MQTT 会话所在的 DLC，下行 +MSUB 从这里发出
+  struct
+  {
+    int state;
+    uint8_t header[4];
+    int headerLen;
+    size_t len;
+    size_t got;
+    uint8_t buf[SIM_MUX_FRAME_MAX];
+  } mux;
+
+  // 模组状态，各 DLC 共享；不同通道操作的状态基本不重叠，不另加锁
+  unsigned baud; // 模组波特率，主机侧 pty 的波特率与它不一致时输入视为乱码
+  bool bearerOpen;
+  bool mqConnected;
+  bool httpInited;
+  size_t httpBodyLen;
+  char subs[SIM_SUB_MAX][SIM_TOPIC_MAX];
+  int subCount;
+  sim_fail_t fails[SIM_FAIL_MAX];
+} sim_modem_t;
+
+static sim_modem_t sims[AT_SIM_INSTANCE_MAX] = {
+    [0 ... AT_SIM_INSTANCE_MAX - 1] = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .writeLock = PTHREAD_MUTEX_INITIALIZER,
+        .masterFd = -1,
+        .muxN1 = 31,
+        .baud = 115200,
+    },
+};
+static __thread sim_modem_t *sim;   // 当前线程所属的模组
+static __thread sim_session_t *cur; // 当前线程处理的会话
+
+
+static int64_t now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleep_ms(int ms)
+{
+  if (ms <= 0)
+  {
+    return;
+  }
+  struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000};
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+  {
+  }
+}
+
+// 基础延迟加随机抖动，模拟模组处理命令的耗时
+static void sim_delay(void)
+{
+  pthread_mutex_lock(&sim->lock);
+  int ms = sim->cfg.latency_ms;
+  if (sim->cfg.jitter_ms > 0)
+  {
+    ms += rand() % (sim->cfg.jitter_ms + 1);
+  }
+  pthread_mutex_unlock(&sim->lock);
+  sleep_ms(ms);
+}
+
+// 调用者持有 writeLock
+static void raw_write(const void *data, size_t len)
+{
+  const uint8_t *p = data;
+  while (len > 0)
+  {
+    ssize_t n = write(sim->masterFd, p, len);
+    if (n < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+      {
+        continue;
+      }
+      break;
+    }
+    p += n;
+    len -= n;
+    sim->stats.bytes_out += n;
+  }
+}
+
+// 27.010 FCS，逐位计算，与主机侧的查表实现相互独立
+static uint8_t mux_fcs(const uint8_t *data, size_t len)
+{
+  uint8_t fcs = 0xFF;
+  while (len--)
+  {
+    fcs ^= *data++;
+    for (int i = 0; i < 8; i++)
+    {
+      fcs = (fcs & 1) ? (fcs >> 1) ^ 0xE0 : fcs >> 1;
+    }
+  }
+  return 0xFF - fcs;
+}
+
+// 调用者持有 writeLock；模组是应答方，C/R 位为 0
+static void mux_frame_write(int dlci, uint8_t control, const void *data, size_t len)
+{
+  uint8_t frame[SIM_MUX_FRAME_MAX + 8];
+  size_t n = 0;
+  frame[n++] = SIM_MUX_FLAG;
+  frame[n++] = (uint8_t)(dlci << 2) | 0x01;
+  frame[n++] = control;
+  if (len <= 0x7F)
+  {
+    frame[n++] = (uint8_t)(len << 1) | 0x01;
+  }
+  else
+  {
+    frame[n++] = (uint8_t)(len << 1);
+    frame[n++] = (uint8_t)(len >> 7);
+  }
+  uint8_t fcs = mux_fcs(frame + 1, n - 1);
+  memcpy(frame + n, data, len);
+  n += len;
+  frame[n++] = fcs;
+  frame[n++] = SIM_MUX_FLAG;
+  raw_write(frame, n);
+}
+
+// 复用时按 N1 切成 UIH 帧，DLC 未建立时从 DLCI 1 发出
+static void sim_write_on(int dlci, const void *data, size_t len)
+{
+  pthread_mutex_lock(&sim->writeLock);
+  if (!sim->muxMode)
+  {
+    raw_write(data, len);
+    pthread_mutex_unlock(&sim->writeLock);
+    return;
+  }
+  if (dlci <= 0 || dlci >= SIM_DLC_MAX || !sim->sessions[dlci].open)
+  {
+    dlci = 1;
+  }
+  const uint8_t *p = data;
+  while (len > 0)
+  {
+    size_t n = len < (size_t)sim->muxN1 ? len : (size_t)sim->muxN1;
+    mux_frame_write(dlci, SIM_MUX_UIH, p, n);
+    p += n;
+    len -= n;
+  }
+  pthread_mutex_unlock(&sim->writeLock);
+}
+
+// 写到当前线程所在的会话
+static void sim_write(const void *data, size_t len)
+{
+  sim_write_on(cur ? cur->dlci : 0, data, len);
+}
+
+// 输出一行响应，格式为 "\r\n<line>\r\n"
+static void sim_reply(const char *fmt, ...)
+{
+  char line[SIM_CMD_MAX + 32];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(line + 2, sizeof(line) - 4, fmt, ap);
+  va_end(ap);
+  if (n < 0)
+  {
+    return;
+  }
+  if (n > (int)sizeof(line) - 5)
+  {
+    n = sizeof(line) - 5;
+  }
+  line[0] = '\r';
+  line[1] = '\n';
+  line[n + 2] = '\r';
+  line[n + 3] = '\n';
+  sim_write(line, n + 4);
+}
+
+static void sim_msub(const char *topic, const void *payload, size_t len)
+{
+  char head[SIM_TOPIC_MAX + 48];
+  int n = snprintf(head, sizeof(head), "\r\n+MSUB: \"%s\",%u byte,", topic, (unsigned)len);
+  // 头部、负载与结尾拼成一帧一次写出，不能被其他响应插入；
+  // 小帧放在栈上，基准测试统计堆分配时不计入模拟器
+  uint8_t stackFrame[SIM_CMD_MAX];
+  uint8_t *frame = n + len + 2 <= sizeof(stackFrame) ? stackFrame : malloc(n + len + 2);
+  if (frame == NULL)
+  {
+    return;
+  }
+  memcpy(frame, head, n);
+  memcpy(frame + n, payload, len);
+  memcpy(frame + n + len, "\r\n", 2);
+  sim_write_on(sim->mqDlci, frame, n + len + 2);
+  if (frame != stackFrame)
+  {
+    free(frame);
+  }
+  pthread_mutex_lock(&sim->lock);
+  sim->stats.urcs++;
+  pthread_mutex_unlock(&sim->lock);
+}
+
+// MQTT topic 过滤器匹配，支持 + 和 #
+static bool topic_match(const char *filter, const char *topic)
+{
+  while (*filter)
+  {
+    if (*filter == '#')
+    {
+      return true;
+    }
+    if (*filter == '+')
+    {
+      while (*topic && *topic != '/')
+      {
+        topic++;
+      }
+      filter++;
+      continue;
+    }
+    if (*filter != *topic)
+    {
+      // "a/#" 同样匹配 "a"
+      return *topic == '\0' && filter[0] == '/' && filter[1] == '#' && filter[2] == '\0';
+    }
+    filter++;
+    topic++;
+  }
+  return *topic == '\0';
+}
+
+static bool is_subscribed(const char *topic)
+{
+  for (int i = 0; i < sim->subCount; i++)
+  {
+    if (topic_match(sim->subs[i], topic))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// 从 JSON 文本中粗略取出字段，模拟服务端回显 id/event；
+// 字符串去掉引号，其余取到 ',' 或 '}' 为止，返回是否为字符串
+static bool json_field(const char *json, const char *key, char *out, size_t size)
+{
+  char pattern[32];
+  snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+  out[0] = '\0';
+  const char *p = strstr(json, pattern);
+  if (p == NULL)
+  {
+    return true;
+  }
+  p += strlen(pattern);
+  bool quoted = *p == '"';
+  p += quoted;
+  size_t i = 0;
+  while (p[i] && (quoted ? p[i] != '"' : p[i] != ',' && p[i] != '}') && i < size - 1)
+  {
+    out[i] = p[i];
+    i++;
+  }
+  out[i] = '\0';
+  return quoted;
+}
+
+// 服务端行为：对已订阅的 "<topic>/reply" 回一条成功应答，CBOR 请求同样以 CBOR 应答
+static void sim_server_reply(const char *topic, const void *payload, size_t len)
+{
+  char replyTopic[SIM_TOPIC_MAX + 8];
+  snprintf(replyTopic, sizeof(replyTopic), "%s/reply", topic);
+  if (!is_subscribed(replyTopic))
+  {
+    return;
+  }
+  bool cbor = at_codec_is_cbor(payload, len);
+  char decoded[SIM_CMD_MAX];
+  const char *json = payload;
+  if (cbor)
+  {
+    // 事件保留编号，原样回显
+    at_codec_out_t out = {.buf = decoded, .cap = sizeof(decoded) - 1};
+    if (!at_codec_cbor_to_json(payload, len, &out, NULL, 0) || out.total >= sizeof(decoded))
+    {
+      ESP_LOGE(TAG, "Bad CBOR publish on %s", topic);
+      return;
+    }
+    decoded[out.total] = '\0';
+    json = decoded;
+  }
+  char id[64];
+  char event[32];
+  json_field(json, "id", id, sizeof(id));
+  bool eventQuoted = json_field(json, "event", event, sizeof(event));
+  long long ts = (long long)time(NULL) * 1000;
+  char body[SIM_CMD_MAX];
+  int n = snprintf(body, sizeof(body),
+                   "{\"id\":\"%s\",\"data\":{\"time\":%lld,\"Status\":1,\"Msg\":\"Success\",\"message\":\"\"},"
+                   "\"time\":%lld,\"ttl\":5000,\"event\":%s%s%s}",
+                   id, ts, ts, eventQuoted ? "\"" : "", event, eventQuoted ? "\"" : "");
+  sim_delay();
+  if (cbor)
+  {
+    uint8_t reply[SIM_CMD_MAX];
+    at_codec_out_t out = {.buf = (char *)reply, .cap = sizeof(reply)};
+    at_codec_cbor_from_json(body, n, &out);
+    sim_msub(replyTopic, reply, out.pos);
+    return;
+  }
+  sim_msub(replyTopic, body, n);
+}
+
+// 提取命令动词，例如 "AT+SAPBR=3,1" -> "AT+SAPBR"
+static void command_verb(const char *cmd, char *verb, size_t size)
+{
+  size_t i = 0;
+  while (cmd[i] && cmd[i] != '=' && cmd[i] != '?' && i < size - 1)
+  {
+    verb[i] = cmd[i];
+    i++;
+  }
+  verb[i] = '\0';
+}
+
+static bool take_fail(const char *verb)
+{
+  bool fail = false;
+  pthread_mutex_lock(&sim->lock);
+  for (int i = 0; i < SIM_FAIL_MAX; i++)
+  {
+    if (sim->fails[i].count > 0 && strcasecmp(sim->fails[i].verb, verb) == 0)
+    {
+      sim->fails[i].count--;
+      fail = true;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&sim->lock);
+  return fail;
+}
+
+static void http_body_byte(size_t offset, uint8_t *out)
+{
+  static const char pattern[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  *out = pattern[offset % (sizeof(pattern) - 1)];
+}
+
+static void handle_http_read(const char *args)
+{
+  size_t offset = 0;
+  size_t len = sim->httpBodyLen;
+  unsigned a, b;
+  if (args && sscanf(args, "%u,%u", &a, &b) == 2)
+  {
+    offset = a;
+    len = b;
+  }
+  if (offset >= sim->httpBodyLen)
+  {
+    len = 0;
+  }
+  else if (offset + len > sim->httpBodyLen)
+  {
+    len = sim->httpBodyLen - offset;
+  }
+
+  char head[48];
+  int n = snprintf(head, sizeof(head), "\r\n+HTTPREAD: %u\r\n", (unsigned)len);
+  uint8_t *frame = malloc(n + len + 8);
+  if (frame == NULL)
+  {
+    sim_reply("ERROR");
+    return;
+  }
+  memcpy(frame, head, n);
+  for (size_t i = 0; i < len; i++)
+  {
+    http_body_byte(offset + i, frame + n + i);
+  }
+  memcpy(frame + n + len, "\r\nOK\r\n", 6);
+  sim_write(frame, n + len + 6);
+  free(frame);
+}
+
+static void enter_data_mode(sim_data_mode_t mode, size_t expected)
+{
+  cur->dataMode = mode;
+  cur->dataExpected = expected > SIM_DATA_MAX ? SIM_DATA_MAX : expected;
+  cur->dataLen = 0;
+}
+
+// 数据模式结束：根据进入时的命令完成后续动作
+static void finish_data(void)
+{
+  sim_data_mode_t mode = cur->dataMode;
+  cur->dataMode = SIM_DATA_NONE;
+  sim_delay();
+  switch (mode)
+  {
+  case SIM_DATA_MPUBEX:
+  {
+    sim_reply("OK");
+    pthread_mutex_lock(&sim->lock);
+    sim->stats.publishes++;
+    pthread_mutex_unlock(&sim->lock);
+    cur->dataBuf[cur->dataLen] = '\0';
+    sim_server_reply(cur->dataTopic, cur->dataBuf, cur->dataLen);
+    break;
+  }
+  case SIM_DATA_HTTP:
+    sim_reply("OK");
+    break;
+  case SIM_DATA_SMS:
+    sim_reply("+CMGS: 1");
+    sim_reply("OK");
+    break;
+  default:
+    break;
+  }
+}
+
+static speed_t baud_speed(unsigned rate)
+{
+  switch (rate)
+  {
+  case 9600:
+    return B9600;
+  case 19200:
+    return B19200;
+  case 38400:
+    return B38400;
+  case 57600:
+    return B57600;
+  case 115200:
+    return B115200;
+  case 230400:
+    return B230400;
+  case 460800:
+    return B460800;
+  case 921600:
+    return B921600;
+  default:
+    return 0;
+  }
+}
+
+// 主机侧的 termios 设置经 pty 主设备可见；两端波特率不一致时输入作废，
+// 超过 max_baud 时模拟不稳定的线路，约一半的输入块损坏
+static bool line_garbled(void)
+{
+  struct termios tio;
+  if (tcgetattr(sim->masterFd, &tio) != 0)
+  {
+    return false;
+  }
+  pthread_mutex_lock(&sim->lock);
+  bool garbled = cfgetospeed(&tio) != baud_speed(sim->baud) || (sim->cfg.max_baud > 0 && sim->baud > (unsigned)sim->cfg.max_baud && rand() % 2);
+  pthread_mutex_unlock(&sim->lock);
+  return garbled;
+}
+
+static void handle_command(const char *cmd)
+{
+  char verb[32];
+  command_verb(cmd, verb, sizeof(verb));
+  const char *args = strchr(cmd, '=');
+  args = args ? args + 1 : NULL;
+
+  pthread_mutex_lock(&sim->lock);
+  sim->stats.commands++;
+  int errorRate = sim->cfg.error_permille;
+  int dropRate = sim->cfg.drop_permille;
+  pthread_mutex_unlock(&sim->lock);
+
+  if (dropRate > 0 && rand() % 1000 < dropRate)
+  {
+    pthread_mutex_lock(&sim->lock);
+    sim->stats.dropped++;
+    pthread_mutex_unlock(&sim->lock);
+    return;
+  }
+
+  sim_delay();
+
+  if (take_fail(verb) || (errorRate > 0 && rand() % 1000 < errorRate))
+  {
+    pthread_mutex_lock(&sim->lock);
+    sim->stats.errors++;
+    pthread_mutex_unlock(&sim->lock);
+    sim_reply("ERROR");
+    return;
+  }
+
+  if (strcasecmp(cmd, "AT") == 0)
+  {
+    sim_reply("OK");
+  }
+  else if (strcasecmp(cmd, "ATE0") == 0 || strcasecmp(cmd, "ATE1") == 0)
+  {
+    cur->echo = cmd[3] == '1';
+    sim_reply("OK");
+  }
+  else if (strcasecmp(cmd, "ATI") == 0)
+  {
+    sim_reply("%s", sim->cfg.model);
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+GMR") == 0)
+  {
+    sim_reply("Revision:%s", sim->cfg.revision);
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+ICCID") == 0 || strcasecmp(verb, "AT+CCID") == 0)
+  {
+    sim_reply("+ICCID: %s", sim->cfg.iccid);
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+CPIN") == 0)
+  {
+    sim_reply("+CPIN: READY");
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+CSQ") == 0)
+  {
+    sim_reply("+CSQ: 24,0");
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+CGATT") == 0)
+  {
+    sim_reply("+CGATT: 1");
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+CCLK") == 0)
+  {
+    time_t t = time(NULL);
+    struct tm tm;
+    localtime_r(&t, &tm);
+    sim_reply("+CCLK: \"%02d/%02d/%02d,%02d:%02d:%02d+32\"", tm.tm_year % 100, tm.tm_mon + 1, tm.tm_mday,
+              tm.tm_hour, tm.tm_min, tm.tm_sec);
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+IPR") == 0)
+  {
+    if (args && strcmp(args, "?") == 0)
+    {
+      sim_reply("+IPR: (),(0,9600,19200,38400,57600,115200,230400,460800,921600)");
+    }
+    else if (args && args[0] != '\0')
+    {
+      unsigned rate = (unsigned)strtoul(args, NULL, 10);
+      if (baud_speed(rate) == 0)
+      {
+        sim_reply("ERROR");
+        return;
+      }
+      // 以旧波特率回复 OK 后再切换
+      sim_reply("OK");
+      pthread_mutex_lock(&sim->lock);
+      sim->baud = rate;
+      pthread_mutex_unlock(&sim->lock);
+      return;
+    }
+    else
+    {
+      sim_reply("+IPR: %u", sim->baud);
+    }
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+IFC") == 0 || strcasecmp(verb, "AT+CSMS") == 0 || strcasecmp(verb, "AT+CMGF") == 0 ||
+           strcasecmp(verb, "AT+MCONFIG") == 0 || strcasecmp(verb, "AT+HTTPPARA") == 0)
+  {
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+SAPBR") == 0)
+  {
+    int op = args ? atoi(args) : -1;
+    if (op == 2)
+    {
+      sim_reply(sim->bearerOpen ? "+SAPBR: 1,1,\"10.0.0.2\"" : "+SAPBR: 1,3,\"0.0.0.0\"");
+    }
+    else if (op == 1)
+    {
+      sim->bearerOpen = true;
+    }
+    else if (op == 0)
+    {
+      sim->bearerOpen = false;
+    }
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+CGDCONT") == 0)
+  {
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+CGACT") == 0)
+  {
+    int state = 0, cid = 1;
+    if (args && strcmp(args, "?") == 0)
+    {
+      sim_reply("+CGACT: 1,%d", sim->bearerOpen);
+    }
+    else if (args && sscanf(args, "%d,%d", &state, &cid) >= 1)
+    {
+      sim->bearerOpen = state == 1;
+    }
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+CGPADDR") == 0)
+  {
+    sim_reply(sim->bearerOpen ? "+CGPADDR: 1,10.0.0.2" : "+CGPADDR: 1,0.0.0.0");
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+MIPSTART") == 0)
+  {
+    if (sim->mqConnected)
+    {
+      sim_reply("ALREADY CONNECT");
+      return;
+    }
+    sim_reply("OK");
+    sim_delay();
+    sim->mqConnected = true;
+    sim->mqDlci = cur->dlci;
+    sim_reply("CONNECT OK");
+  }
+  else if (strcasecmp(verb, "AT+MCONNECT") == 0)
+  {
+    sim_reply("OK");
+    sim_delay();
+    sim_reply("CONNACK OK");
+  }
+  else if (strcasecmp(verb, "AT+MSUB") == 0)
+  {
+    char topic[SIM_TOPIC_MAX] = {0};
+    if (args && sscanf(args, "\"%127[^\"]\"", topic) == 1 && sim->subCount < SIM_SUB_MAX)
+    {
+      strcpy(sim->subs[sim->subCount++], topic);
+    }
+    sim_reply("OK");
+    sim_delay();
+    sim_reply("SUBACK");
+  }
+  else if (strcasecmp(verb, "AT+MPUBEX") == 0)
+  {
+    unsigned qos, retain, len;
+    if (!sim->mqConnected || args == NULL ||
+        sscanf(args, "\"%127[^\"]\",%u,%u,%u", cur->dataTopic, &qos, &retain, &len) != 4)
+    {
+      sim_reply("ERROR");
+      return;
+    }
+    enter_data_mode(SIM_DATA_MPUBEX, len);
+    sim_write("\r\n>", 3);
+  }
+  else if (strcasecmp(verb, "AT+MDISCONNECT") == 0 || strcasecmp(verb, "AT+MIPCLOSE") == 0)
+  {
+    sim->mqConnected = false;
+    sim->subCount = 0;
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+HTTPINIT") == 0)
+  {
+    if (sim->httpInited)
+    {
+      sim_reply("ERROR");
+      return;
+    }
+    sim->httpInited = true;
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+HTTPTERM") == 0)
+  {
+    sim->httpInited = false;
+    sim_reply("OK");
+  }
+  else if (strcasecmp(verb, "AT+HTTPDATA") == 0)
+  {
+    unsigned len = args ? (unsigned)atoi(args) : 0;
+    enter_data_mode(SIM_DATA_HTTP, len);
+    sim_reply("DOWNLOAD");
+  }
+  else if (strcasecmp(verb, "AT+HTTPACTION") == 0)
+  {
+    int method = args ? atoi(args) : 0;
+    if (!sim->httpInited || !sim->bearerOpen)
+    {
+      sim_reply("ERROR");
+      return;
+    }
+    sim_reply("OK");
+    sim_delay();
+    pthread_mutex_lock(&sim->lock);
+    sim->httpBodyLen = method == 2 ? 0 : (size_t)sim->cfg.http_body_size;
+    pthread_mutex_unlock(&sim->lock);
+    sim_reply("+HTTPACTION: %d,200,%u", method, (unsigned)sim->httpBodyLen);
+  }
+  else if (strcasecmp(verb, "AT+HTTPREAD") == 0)
+  {
+    handle_http_read(args);
+  }
+  else if (strcasecmp(verb, "AT+CMGS") == 0)
+  {
+    enter_data_mode(SIM_DATA_SMS, 0);
+    sim_write("\r\n> ", 4);
+  }
+  else if (strcasecmp(verb, "AT+CMUX") == 0)
+  {
+    // 只支持基本模式、UIH 帧：AT+CMUX=0[,0[,<port_speed>[,<N1>]]]
+    int mode = -1, subset = 0, speed = 0, n1 = 31;
+    if (args == NULL || sscanf(args, "%d,%d,%d,%d", &mode, &subset, &speed, &n1) < 1 || mode != 0 || subset != 0 ||
+        sim->muxMode)
+    {
+      sim_reply("ERROR");
+      return;
+    }
+    sim_reply("OK");
+    sim->muxN1 = n1 > 0 && n1 <= SIM_MUX_FRAME_MAX ? n1 : 31;
+    memset(&sim->mux, 0, sizeof(sim->mux));
+    sim->muxMode = true;
+  }
+  else
+  {
+    sim_reply("ERROR");
+  }
+}
+
+static void feed_byte(uint8_t c)
+{
+  if (cur->dataMode != SIM_DATA_NONE)
+  {
+    // 短信只以 Ctrl-Z 结束；回车是正文换行，与真实模组一样再给一个提示符，其余按声明的长度收满
+    if (cur->dataMode == SIM_DATA_SMS && c == 0x1A)
+    {
+      finish_data();
+      return;
+    }
+    if (cur->dataMode == SIM_DATA_SMS && c == '\r')
+    {
+      sim_write("\r\n> ", 4);
+    }
+    if (cur->dataLen < SIM_DATA_MAX)
+    {
+      cur->dataBuf[cur->dataLen++] = c;
+    }
+    if (cur->dataMode != SIM_DATA_SMS && cur->dataLen >= cur->dataExpected)
+    {
+      finish_data();
+    }
+    return;
+  }
+
+  if (c == '\n')
+  {
+    return;
+  }
+  if (c != '\r')
+  {
+    if (cur->cmdLen < SIM_CMD_MAX - 1)
+    {
+      cur->cmd[cur->cmdLen++] = (char)c;
+    }
+    return;
+  }
+
+  cur->cmd[cur->cmdLen] = '\0';
+  if (cur->cmdLen > 0)
+  {
+    if (cur->echo)
+    {
+      sim_write(cur->cmd, cur->cmdLen);
+      sim_write("\r", 1);
+    }
+    handle_command(cur->cmd);
+  }
+  cur->cmdLen = 0;
+}
+
+// 数据模式下输入停顿视为结束，兼容声明长度与实际不符的写入；短信没有声明长度，只等 Ctrl-Z
+static void session_idle(void)
+{
+  if (cur->dataMode != SIM_DATA_NONE && cur->dataMode != SIM_DATA_SMS && cur->dataLen > 0 &&
+      now_ms() - cur->lastData > SIM_DATA_IDLE_MS)
+  {
+    finish_data();
+  }
+}
+
+static void session_feed(const uint8_t *buf, size_t n)
+{
+  cur->lastData = now_ms();
+  for (size_t i = 0; i < n; i++)
+  {
+    feed_byte(buf[i]);
+  }
+}
+
+static void session_reset(sim_session_t *session, int dlci)
+{
+  session->modem = sim;
+  session->dlci = dlci;
+  session->echo = sim->cfg.echo;
+  session->dataMode = SIM_DATA_NONE;
+  session->dataLen = 0;
+  session->cmdLen = 0;
+}
+
+// DLC 会话线程：从管道读取解帧后的数据，管道关闭时退出
+static void *session_main(void *arg)
+{
+  cur = arg;
+  sim = cur->modem;
+  uint8_t buf[512];
+  while (1)
+  {
+    struct pollfd pfd = {.fd = cur->pipe[0], .events = POLLIN};
+    int rc = poll(&pfd, 1, cur->dataMode != SIM_DATA_NONE ? 50 : 200);
+    if (rc <= 0)
+    {
+      session_idle();
+      continue;
+    }
+    ssize_t n = read(cur->pipe[0], buf, sizeof(buf));
+    if (n <= 0)
+    {
+      break;
+    }
+    session_feed(buf, n);
+  }
+  return NULL;
+}
+
+static bool session_open(int dlci)
+{
+  sim_session_t *session = &sim->sessions[dlci];
+  if (session->open)
+  {
+    return true;
+  }
+  session_reset(session, dlci);
+  session->dataBuf = malloc(SIM_DATA_MAX + 1);
+  if (session->dataBuf == NULL || pipe(session->pipe) != 0)
+  {
+    free(session->dataBuf);
+    session->dataBuf = NULL;
+    return false;
+  }
+  session->open = true;
+  pthread_create(&session->thread, NULL, session_main, session);
+  return true;
+}
+
+static void session_close(int dlci)
+{
+  sim_session_t *session = &sim->sessions[dlci];
+  if (!session->open)
+  {
+    return;
+  }
+  session->open = false;
+  close(session->pipe[1]);
+  pthread_join(session->thread, NULL);
+  close(session->pipe[0]);
+  free(session->dataBuf);
+  session->dataBuf = NULL;
+}
+
+static void mux_reply(int dlci, uint8_t control, const void *data, size_t len)
+{
+  pthread_mutex_lock(&sim->writeLock);
+  mux_frame_write(dlci, control, data, len);
+  pthread_mutex_unlock(&sim->writeLock);
+}
+
+// 退出多路复用，回到 DLCI 0 的 AT 会话
+static void mux_leave(void)
+{
+  for (int i = 1; i < SIM_DLC_MAX; i++)
+  {
+    session_close(i);
+  }
+  sim->muxMode = false;
+  sim->mqDlci = 0;
+}
+
+static void mux_frame(int dlci, uint8_t control, const uint8_t *data, size_t len)
+{
+  sim->stats.mux_frames++;
+  switch (control & ~SIM_MUX_PF)
+  {
+  case SIM_MUX_SABM:
+    mux_reply(dlci, (dlci == 0 || (dlci < SIM_DLC_MAX && session_open(dlci)) ? SIM_MUX_UA : SIM_MUX_DM) | SIM_MUX_PF,
+              NULL, 0);
+    break;
+  case SIM_MUX_DISC:
+    if (dlci > 0 && dlci < SIM_DLC_MAX && !sim->sessions[dlci].open)
+    {
+      mux_reply(dlci, SIM_MUX_DM | SIM_MUX_PF, NULL, 0);
+      break;
+    }
+    mux_reply(dlci, SIM_MUX_UA | SIM_MUX_PF, NULL, 0);
+    if (dlci == 0)
+    {
+      mux_leave();
+    }
+    else if (dlci < SIM_DLC_MAX)
+    {
+      session_close(dlci);
+    }
+    break;
+  case SIM_MUX_UIH:
+    if (dlci == 0)
+    {
+      // CLD：回应后退出复用
+      if (len >= 2 && (data[0] & ~0x03) == 0xC0)
+      {
+        static const uint8_t cld[] = {0xC1, 0x01};
+        mux_reply(0, SIM_MUX_UIH, cld, sizeof(cld));
+        mux_leave();
+      }
+    }
+    else if (dlci < SIM_DLC_MAX && sim->sessions[dlci].open && write(sim->sessions[dlci].pipe[1], data, len) < 0)
+    {
+      ESP_LOGE(TAG, "DLC %d pipe write failed", dlci);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+static void mux_feed(uint8_t c)
+{
+  switch (sim->mux.state)
+  {
+  case 0: // 等待开始标志
+    if (c == SIM_MUX_FLAG)
+    {
+      sim->mux.state = 1;
+    }
+    break;
+  case 1: // 地址
+    if (c == SIM_MUX_FLAG)
+    {
+      break;
+    }
+    sim->mux.header[0] = c;
+    sim->mux.headerLen = 1;
+    sim->mux.state = 2;
+    break;
+  case 2: // 控制
+    sim->mux.header[sim->mux.headerLen++] = c;
+    sim->mux.state = 3;
+    break;
+  case 3: // 长度
+  case 4:
+    sim->mux.header[sim->mux.headerLen++] = c;
+    sim->mux.len = sim->mux.state == 3 ? (size_t)(c >> 1) : sim->mux.len | (size_t)c << 7;
+    if (sim->mux.state == 3 && !(c & 0x01))
+    {
+      sim->mux.state = 4;
+      break;
+    }
+    sim->mux.got = 0;
+    sim->mux.state = sim->mux.len > SIM_MUX_FRAME_MAX ? 0 : sim->mux.len > 0 ? 5 : 6;
+    if (sim->mux.state == 0)
+    {
+      sim->stats.mux_bad++;
+    }
+    break;
+  case 5: // 信息
+    sim->mux.buf[sim->mux.got++] = c;
+    if (sim->mux.got == sim->mux.len)
+    {
+      sim->mux.state = 6;
+    }
+    break;
+  case 6: // FCS
+    sim->mux.state = mux_fcs(sim->mux.header, sim->mux.headerLen) == c ? 7 : 0;
+    if (sim->mux.state == 0)
+    {
+      sim->stats.mux_bad++;
+    }
+    break;
+  case 7: // 结束标志
+    sim->mux.state = 1;
+    if (c != SIM_MUX_FLAG)
+    {
+      sim->stats.mux_bad++;
+      sim->mux.state = 0;
+      break;
+    }
+    mux_frame(sim->mux.header[0] >> 2, sim->mux.header[1], sim->mux.buf, sim->mux.len);
+    break;
+  }
+}
+
+static void *modem_main(void *arg)
+{
+  sim = arg;
+  cur = &sim->sessions[0];
+  uint8_t buf[512];
+
+  while (sim->running)
+  {
+    struct pollfd pfd = {.fd = sim->masterFd, .events = POLLIN};
+    int rc = poll(&pfd, 1, cur->dataMode != SIM_DATA_NONE ? 50 : 200);
+    if (rc <= 0)
+    {
+      session_idle();
+      continue;
+    }
+    ssize_t n = read(sim->masterFd, buf, sizeof(buf));
+    if (n <= 0)
+    {
+      // 从设备尚未被打开或已关闭
+      sleep_ms(20);
+      continue;
+    }
+    sim->stats.bytes_in += n;
+    if (line_garbled())
+    {
+      sim->stats.garbled++;
+      cur->cmdLen = 0;
+      continue;
+    }
+    // AT+CMUX 的 OK 之后同一块中的字节已经是帧
+    for (ssize_t i = 0; i < n; i++)
+    {
+      if (sim->muxMode)
+      {
+        mux_feed(buf[i]);
+      }
+      else
+      {
+        session_feed(buf + i, 1);
+      }
+    }
+  }
+  return NULL;
+}
+
+static void *urc_main(void *arg)
+{
+  sim = arg;
+  while (sim->running)
+  {
+    pthread_mutex_lock(&sim->lock);
+    int interval = sim->cfg.urc_interval_ms;
+    pthread_mutex_unlock(&sim->lock);
+    if (interval <= 0)
+    {
+      sleep_ms(100);
+      continue;
+    }
+    sleep_ms(interval);
+    if (sim->running)
+    {
+      sim_msub(sim->urcTopic, sim->urcPayload, strlen(sim->urcPayload));
+    }
+  }
+  return NULL;
+}
+
+static bool sim_apply(const char *directive)
+{
+  char key[32];
+  char a[SIM_TOPIC_MAX];
+  int value;
+  int consumed = 0;
+
+  while (*directive == ' ' || *directive == '\t')
+  {
+    directive++;
+  }
+  if (*directive == '\0' || *directive == '#' || *directive == '\n')
+  {
+    return true;
+  }
+  if (sscanf(directive, "%31s%n", key, &consumed) != 1)
+  {
+    return false;
+  }
+  const char *rest = directive + consumed;
+
+  pthread_mutex_lock(&sim->lock);
+  bool ok = true;
+  if (strcmp(key, "latency") == 0 && sscanf(rest, "%d", &value) == 1)
+  {
+    sim->cfg.latency_ms = value;
+  }
+  else if (strcmp(key, "jitter") == 0 && sscanf(rest, "%d", &value) == 1)
+  {
+    sim->cfg.jitter_ms = value;
+  }
+  else if (strcmp(key, "error_rate") == 0 && sscanf(rest, "%d", &value) == 1)
+  {
+    sim->cfg.error_permille = value;
+  }
+  else if (strcmp(key, "drop_rate") == 0 && sscanf(rest, "%d", &value) == 1)
+  {
+    sim->cfg.drop_permille = value;
+  }
+  else if (strcmp(key, "http_body") == 0 && sscanf(rest, "%d", &value) == 1)
+  {
+    sim->cfg.http_body_size = value;
+  }
+  else if (strcmp(key, "max_baud") == 0 && sscanf(rest, "%d", &value) == 1)
+  {
+    sim->cfg.max_baud = value;
+  }
+  else if (strcmp(key, "echo") == 0 && sscanf(rest, "%127s", a) == 1)
+  {
+    sim->sessions[0].echo = strcmp(a, "on") == 0;
+  }
+  else if (strcmp(key, "fail") == 0 && sscanf(rest, "%127s %d", a, &value) == 2)
+  {
+    ok = false;
+    for (int i = 0; i < SIM_FAIL_MAX; i++)
+    {
+      if (sim->fails[i].count == 0 || strcasecmp(sim->fails[i].verb, a) == 0)
+      {
+        snprintf(sim->fails[i].verb, sizeof(sim->fails[i].verb), "%s", a);
+        sim->fails[i].count = value;
+        ok = true;
+        break;
+      }
+    }
+  }
+  else if (strcmp(key, "urc_every") == 0 && sscanf(rest, "%d %127s %n", &value, a, &consumed) == 2)
+  {
+    sim->cfg.urc_interval_ms = value;
+    snprintf(sim->urcTopic, sizeof(sim->urcTopic), "%s", a);
+    snprintf(sim->urcPayload, sizeof(sim->urcPayload), "%s", rest + consumed);
+    sim->urcPayload[strcspn(sim->urcPayload, "\r\n")] = '\0';
+  }
+  else
+  {
+    ok = false;
+  }
+  pthread_mutex_unlock(&sim->lock);
+
+  if (!ok)
+  {
+    ESP_LOGW(TAG, "Unknown directive: %s", directive);
+  }
+  return ok;
+}
+
+static bool sim_load_script(const char *path)
+{
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL)
+  {
+    ESP_LOGE(TAG, "Failed to open script %s", path);
+    return false;
+  }
+  char line[SIM_CMD_MAX];
+  bool ok = true;
+  while (fgets(line, sizeof(line), fp))
+  {
+    ok &= sim_apply(line);
+  }
+  fclose(fp);
+  return ok;
+}
+
+const char *at_sim_start_on(int index, const at_sim_config_t *config)
+{
+  if (index < 0 || index >= AT_SIM_INSTANCE_MAX)
+  {
+    return NULL;
+  }
+  sim = &sims[index];
+  if (sim->running)
+  {
+    return sim->slavePath;
+  }
+
+  sim->cfg = *config;
+  sim->cfg.model = sim->cfg.model ? sim->cfg.model : "SIM800 R14.18";
+  sim->cfg.revision = sim->cfg.revision ? sim->cfg.revision : "1418B04SIM800C24";
+  snprintf(sim->urcTopic, sizeof(sim->urcTopic), "%s", sim->cfg.urc_topic ? sim->cfg.urc_topic : "");
+  snprintf(sim->urcPayload, sizeof(sim->urcPayload), "%s", sim->cfg.urc_payload ? sim->cfg.urc_payload : "");
+  sim->cfg.urc_topic = sim->urcTopic;
+  sim->cfg.urc_payload = sim->urcPayload;
+  session_reset(&sim->sessions[0], 0);
+  sim->muxMode = false;
+  sim->mqDlci = 0;
+  sim->baud = 115200;
+  sim->bearerOpen = sim->cfg.auto_pdp;
+  memset(&sim->stats, 0, sizeof(sim->stats));
+
+  const char *script = getenv("AT_SIM_SCRIPT");
+  if (script)
+  {
+    sim_load_script(script);
+  }
+
+  sim->sessions[0].dataBuf = malloc(SIM_DATA_MAX + 1);
+  if (sim->sessions[0].dataBuf == NULL)
+  {
+    return NULL;
+  }
+
+  sim->masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (sim->masterFd < 0 || grantpt(sim->masterFd) != 0 || unlockpt(sim->masterFd) != 0 ||
+      ptsname_r(sim->masterFd, sim->slavePath, sizeof(sim->slavePath)) != 0)
+  {
+    ESP_LOGE(TAG, "Failed to create pty: %s", strerror(errno));
+    if (sim->masterFd >= 0)
+    {
+      close(sim->masterFd);
+      sim->masterFd = -1;
+    }
+    free(sim->sessions[0].dataBuf);
+    sim->sessions[0].dataBuf = NULL;
+    return NULL;
+  }
+
+  struct termios tio;
+  if (tcgetattr(sim->masterFd, &tio) == 0)
+  {
+    cfmakeraw(&tio);
+    tcsetattr(sim->masterFd, TCSANOW, &tio);
+  }
+
+  sim->running = true;
+  pthread_create(&sim->modemThread, NULL, modem_main, sim);
+  pthread_create(&sim->urcThread, NULL, urc_main, sim);
+  ESP_LOGI(TAG, "Modem simulator on %s (latency %d ms, jitter %d ms)", sim->slavePath, sim->cfg.latency_ms, sim->cfg.jitter_ms);
+  return sim->slavePath;
+}
+
+void at_sim_stop_on(int index)
+{
+  if (index < 0 || index >= AT_SIM_INSTANCE_MAX)
+  {
+    return;
+  }
+  sim = &sims[index];
+  if (!sim->running)
+  {
+    return;
+  }
+  sim->running = false;
+  pthread_join(sim->modemThread, NULL);
+  pthread_join(sim->urcThread, NULL);
+  mux_leave();
+  close(sim->masterFd);
+  sim->masterFd = -1;
+  free(sim->sessions[0].dataBuf);
+  sim->sessions[0].dataBuf = NULL;
+}
+
+const char *at_sim_start(const at_sim_config_t *config)
+{
+  return at_sim_start_on(0, config);
+}
+
+void at_sim_stop(void)
+{
+  at_sim_stop_on(0);
+}
+
+bool at_sim_apply(const char *directive)
+{
+  sim = &sims[0];
+  return sim_apply(directive);
+}
+
+bool at_sim_load_script(const char *path)
+{
+  sim = &sims[0];
+  return sim_load_script(path);
+}
+
+void at_sim_set_latency(int latency_ms, int jitter_ms)
+{
+  sim = &sims[0];
+  pthread_mutex_lock(&sim->lock);
+  sim->cfg.latency_ms = latency_ms;
+  sim->cfg.jitter_ms = jitter_ms;
+  pthread_mutex_unlock(&sim->lock);
+}
+
+void at_sim_fail_next(const char *verb, int count)
+{
+  char directive[64];
+  snprintf(directive, sizeof(directive), "fail %s %d", verb, count);
+  at_sim_apply(directive);
+}
+
+void at_sim_publish_on(int index, const char *topic, const void *payload, size_t len)
+{
+  if (index < 0 || index >= AT_SIM_INSTANCE_MAX)
+  {
+    return;
+  }
+  sim = &sims[index];
+  sim_msub(topic, payload, len);
+}
+
+void at_sim_publish(const char *topic, const void *payload, size_t len)
+{
+  at_sim_publish_on(0, topic, payload, len);
+}
+
+void at_sim_inject(const char *text)
+{
+  sim = &sims[0];
+  sim_write_on(0, text, strlen(text));
+}
+
+void at_sim_get_stats_on(int index, at_sim_stats_t *out)
+{
+  if (index < 0 || index >= AT_SIM_INSTANCE_MAX)
+  {
+    memset(out, 0, sizeof(*out));
+    return;
+  }
+  sim = &sims[index];
+  pthread_mutex_lock(&sim->lock);
+  *out = sim->stats;
+  out->baud = sim->baud;
+  pthread_mutex_unlock(&sim->lock);
+}
+
+void at_sim_get_stats(at_sim_stats_t *out)
+{
+  at_sim_get_stats_on(0, out);
+}
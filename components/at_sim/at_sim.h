@@ -0,0 +1,88 @@
+#ifndef AT_SIM_H
+#define AT_SIM_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 主机侧 SIM800/A76xx 模组模拟器，仅在 linux 目标上可用
+// 通过 pty 暴露串口，at_uart 的 POSIX 后端直接打开返回的设备路径
+// 支持 AT+CMUX=0 基本模式，DLCI 1~3 各自是独立的 AT 会话
+// 可同时运行多个实例模拟多模组，不带 _on 的接口都作用于实例 0
+
+#define AT_SIM_INSTANCE_MAX 4
+
+typedef struct
+{
+  int latency_ms;         // 每条命令的基础响应延迟
+  int jitter_ms;          // 在基础延迟上叠加的随机抖动上限
+  int error_permille;     // 每千条命令随机回复 ERROR 的条数
+  int drop_permille;      // 每千条命令不作任何回复的条数
+  int urc_interval_ms;    // 周期性推送 +MSUB 的间隔，0 关闭
+  const char *urc_topic;  // 周期推送使用的 topic
+  const char *urc_payload;
+  const char *iccid;
+  int http_body_size;     // HTTPACTION 返回的 body 长度
+  bool echo;              // 上电时是否开启回显
+  int max_baud;           // 高于该波特率时线路不稳定，约一半输入丢失；0 不限制
+  const char *model;      // ATI 返回的型号
+  const char *revision;   // AT+GMR 返回的固件版本
+  bool auto_pdp;          // 上电即有默认承载，如 LTE 模组；另支持 AT+CGACT / AT+CGPADDR
+} at_sim_config_t;
+
+#define AT_SIM_DEFAULT_CONFIG() {            \
+    .latency_ms = 20,                        \
+    .jitter_ms = 5,                          \
+    .error_permille = 0,                     \
+    .drop_permille = 0,                      \
+    .urc_interval_ms = 0,                    \
+    .urc_topic = "/device/sim/cmd",          \
+    .urc_payload = "{\"event\":\"ping\"}",   \
+    .iccid = "89860000000000000001",         \
+    .http_body_size = 1024,                  \
+    .echo = true,                            \
+    .max_baud = 0,                           \
+    .model = "SIM800 R14.18",                \
+    .revision = "1418B04SIM800C24",          \
+    .auto_pdp = false,                       \
+}
+
+typedef struct
+{
+  uint32_t commands;   // 收到的命令条数
+  uint32_t errors;     // 注入的 ERROR
+  uint32_t dropped;    // 注入的无响应
+  uint32_t publishes;  // 完成的 MPUBEX
+  uint32_t urcs;       // 发出的 +MSUB
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+  uint32_t garbled;    // 因波特率不一致或线路不稳定丢弃的输入块
+  uint32_t baud;       // 模组当前波特率
+  uint32_t mux_frames; // CMUX 模式下收到的有效帧
+  uint32_t mux_bad;    // FCS 或长度错误丢弃的帧
+} at_sim_stats_t;
+
+// 启动模拟器，返回 pty 从设备路径，失败返回 NULL
+// 环境变量 AT_SIM_SCRIPT 指向的脚本会在启动时加载
+const char *at_sim_start(const at_sim_config_t *config);
+void at_sim_stop(void);
+const char *at_sim_start_on(int index, const at_sim_config_t *config);
+void at_sim_stop_on(int index);
+
+// 脚本：每行一条指令，# 开头为注释
+//   latency <ms> / jitter <ms> / error_rate <‰> / drop_rate <‰>
+//   fail <verb> <count>          接下来 count 条该命令回复 ERROR
+//   urc_every <ms> <topic> <payload>
+//   http_body <bytes> / echo on|off / max_baud <baud>
+bool at_sim_load_script(const char *path);
+bool at_sim_apply(const char *directive);
+
+void at_sim_set_latency(int latency_ms, int jitter_ms);
+void at_sim_fail_next(const char *verb, int count);
+// 主动推送一条 +MSUB 下行消息
+void at_sim_publish(const char *topic, const void *payload, size_t len);
+void at_sim_publish_on(int index, const char *topic, const void *payload, size_t len);
+// 原样写出任意 URC 文本（调用者负责 \r\n）
+void at_sim_inject(const char *text);
+void at_sim_get_stats(at_sim_stats_t *out);
+void at_sim_get_stats_on(int index, at_sim_stats_t *out);
+#endif
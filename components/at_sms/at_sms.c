@@ -30,9 +30,7 @@ bool at_sms_send()
     return false;
   if (!at_send_command("AT+CMGF=1", "OK", 1000, NULL,false))
     return false;
-  if (!at_send_command("AT+CMGS=\"1390000000\"", ">", 3000, NULL,false))
-    return false;
-  if (!at_send_command("HELLOW", "OK", 15000, NULL,false))
+  if (!at_send_with_payload("AT+CMGS=\"1390000000\"", ">", "HELLOW\x1A", 7, "OK", 18000, NULL))
   {
     ESP_LOGE(TAG, "Failed to send SMS content");
     return false;
@@ -0,0 +1,52 @@
+#ifndef AT_CMUX_H
+#define AT_CMUX_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// GSM 07.10 / 3GPP 27.010 基本模式帧的编解码：
+// F9 | 地址 | 控制 | 长度(1~2 字节) | 信息 | FCS | F9
+// FCS 只覆盖地址、控制与长度字段（UIH 帧），信息字段不参与校验
+
+#define AT_CMUX_FLAG 0xF9
+#define AT_CMUX_SABM 0x2F // 建立链路
+#define AT_CMUX_UA 0x63   // 确认
+#define AT_CMUX_DM 0x0F   // 链路未建立
+#define AT_CMUX_DISC 0x43 // 断开链路
+#define AT_CMUX_UIH 0xEF  // 数据
+#define AT_CMUX_PF 0x10   // 轮询/终结位
+
+// DLCI 0 上的控制报文类型（已去掉 EA 与 C/R 位）
+#define AT_CMUX_MSG_CLD 0xC0 // 关闭多路复用
+#define AT_CMUX_MSG_MSC 0xE0 // 调制解调器状态
+
+#define AT_CMUX_HEADER_MAX 5 // 开始标志、地址、控制与两字节长度
+#define AT_CMUX_FRAME_OVERHEAD (AT_CMUX_HEADER_MAX + 2)
+
+// 收到一帧，control 已去掉 P/F 位，data 只在回调期间有效
+typedef void (*at_cmux_frame_cb_t)(uint8_t dlci, uint8_t control, const uint8_t *data, size_t len, void *ctx);
+
+typedef struct
+{
+    uint8_t state;
+    uint8_t header[4]; // 地址、控制与长度，用于计算 FCS
+    uint8_t headerLen;
+    size_t len;
+    size_t got;
+    uint8_t *buf;
+    size_t cap;
+    at_cmux_frame_cb_t on_frame;
+    void *ctx;
+    uint32_t badFrames; // FCS 错误、超长或缺少结束标志而丢弃的帧
+} at_cmux_decoder_t;
+
+uint8_t at_cmux_fcs(const uint8_t *data, size_t len);
+// 编码一帧到 out，command 为 true 时置 C/R 位（作为发起方发出命令或数据）；
+// out 至少 len + AT_CMUX_FRAME_OVERHEAD 字节，返回帧长度，放不下返回 0
+size_t at_cmux_encode(uint8_t dlci, uint8_t control, bool command, const void *data, size_t len, uint8_t *out, size_t cap);
+
+// buf 为信息字段缓冲区，容量即接受的最大帧长（N1）
+void at_cmux_decoder_init(at_cmux_decoder_t *decoder, uint8_t *buf, size_t cap, at_cmux_frame_cb_t on_frame, void *ctx);
+void at_cmux_feed(at_cmux_decoder_t *decoder, const uint8_t *data, size_t len);
+void at_cmux_decoder_reset(at_cmux_decoder_t *decoder);
+#endif
@@ -0,0 +1,114 @@
+#include <string.h>
+#include "sdkconfig.h"
+#include "at_dialect.h"
+
+static const char *const sim800PdpSetup[] = {
+    "AT+SAPBR=3,1,\"CONTYPE\",\"GPRS\"",
+    "AT+SAPBR=3,1,\"APN\",\"\"",
+    NULL,
+};
+
+static const at_dialect_t sim800 = {
+    .id = AT_DIALECT_SIM800,
+    .name = "SIM800",
+    .ident = "SIM800",
+    .caps = AT_DIALECT_CAP_CMUX,
+    .pdp_setup = sim800PdpSetup,
+    .pdp_activate = "AT+SAPBR=1,1",
+    .pdp_activate_timeout_ms = 3000,
+    .pdp_query = "AT+SAPBR=2,1", // +SAPBR: 1,1,"10.0.0.2"
+    .pdp_query_prefix = "+SAPBR:",
+    .pdp_lost_urc = "+SAPBR ", // +SAPBR 1: DEACT
+    .pdp_lost_match = "DEACT",
+    .iccid_query = "AT+ICCID",
+    .iccid_prefix = "+ICCID:",
+    .http_bearer = "AT+HTTPPARA=\"CID\",1",
+    .http_read = "AT+HTTPREAD=%u,%u",
+    .http_read_prefix = "+HTTPREAD:",
+    .http_chunk = 1024,
+    .http_chunk_max = 4096,
+    .http_action = "AT+HTTPACTION=%d",
+    .http_action_prefix = "+HTTPACTION:",
+    .http_action_format = "+HTTPACTION: %d,%d,%d",
+    .mq_config = "AT+MCONFIG=%s,%s,%s",
+    .mq_start = "AT+MIPSTART=%s,%s",
+    .mq_start_ok = "CONNECT", // CONNECT OK 或 ALREADY CONNECT
+    .mq_connect = "AT+MCONNECT=1,%d",
+    .mq_connect_ok = "CONNACK OK",
+    .mq_subscribe = "AT+MSUB=\"%s\",0",
+    .mq_subscribe_ok = "SUBACK",
+    .mq_publish = "AT+MPUBEX=\"%s\",0,0,%u",
+    .mq_disconnect = "AT+MDISCONNECT",
+    .mq_close = "AT+MIPCLOSE",
+};
+
+static const char *const a76xxPdpSetup[] = {
+    "AT+CGDCONT=1,\"IP\",\"\"",
+    NULL,
+};
+
+// 注册网络时默认承载已经建立，HTTP 不需要绑定 CID；HTTPREAD 单次可读更大的块
+static const at_dialect_t a76xx = {
+    .id = AT_DIALECT_A76XX,
+    .name = "A76xx",
+    .ident = "A76",
+    .caps = AT_DIALECT_CAP_CMUX | AT_DIALECT_CAP_NATIVE_PDP,
+    .pdp_setup = a76xxPdpSetup,
+    .pdp_activate = "AT+CGACT=1,1",
+    .pdp_activate_timeout_ms = 9000,
+    .pdp_query = "AT+CGPADDR=1", // +CGPADDR: 1,10.0.0.2
+    .pdp_query_prefix = "+CGPADDR:",
+    .pdp_lost_urc = "+CGEV:", // +CGEV: NW PDN DEACT 1
+    .pdp_lost_match = "DEACT",
+    .iccid_query = "AT+ICCID",
+    .iccid_prefix = "+ICCID:",
+    .http_bearer = NULL,
+    .http_read = "AT+HTTPREAD=%u,%u",
+    .http_read_prefix = "+HTTPREAD:",
+    .http_chunk = 4096,
+    .http_chunk_max = 8192,
+    .http_action = "AT+HTTPACTION=%d",
+    .http_action_prefix = "+HTTPACTION:",
+    .http_action_format = "+HTTPACTION: %d,%d,%d",
+    .mq_config = "AT+MCONFIG=%s,%s,%s",
+    .mq_start = "AT+MIPSTART=%s,%s",
+    .mq_start_ok = "CONNECT", // CONNECT OK 或 ALREADY CONNECT
+    .mq_connect = "AT+MCONNECT=1,%d",
+    .mq_connect_ok = "CONNACK OK",
+    .mq_subscribe = "AT+MSUB=\"%s\",0",
+    .mq_subscribe_ok = "SUBACK",
+    .mq_publish = "AT+MPUBEX=\"%s\",0,0,%u",
+    .mq_disconnect = "AT+MDISCONNECT",
+    .mq_close = "AT+MIPCLOSE",
+};
+
+static const at_dialect_t *const dialects[AT_DIALECT_COUNT] = {
+    [AT_DIALECT_SIM800] = &sim800,
+    [AT_DIALECT_A76XX] = &a76xx,
+};
+
+const at_dialect_t *at_dialect_get(at_dialect_id_t id)
+{
+    return (unsigned)id < AT_DIALECT_COUNT ? dialects[id] : NULL;
+}
+
+const at_dialect_t *at_dialect_match(const char *ident)
+{
+    for (int i = 0; i < AT_DIALECT_COUNT; i++)
+    {
+        if (strstr(ident, dialects[i]->ident) != NULL)
+        {
+            return dialects[i];
+        }
+    }
+    return NULL;
+}
+
+const at_dialect_t *at_dialect_default(void)
+{
+#if CONFIG_AT_DIALECT_A76XX
+    return &a76xx;
+#else
+    return &sim800;
+#endif
+}
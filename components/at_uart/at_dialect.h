@@ -0,0 +1,70 @@
+#ifndef AT_DIALECT_H
+#define AT_DIALECT_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 模组命令集：不同固件的命令模板、期望响应、分块上限与能力标志集中在一张描述符里，
+// 启动时按 Kconfig 或 ATI/AT+GMR 探测选定，之后各组件只读描述符字段，不再按型号比较字符串
+// 模板中的参数按字段注释的顺序传给 snprintf
+
+#define AT_DIALECT_CAP_CMUX (1u << 0)       // 支持 AT+CMUX 基本模式
+#define AT_DIALECT_CAP_NATIVE_PDP (1u << 1) // PDP 由 AT+CGACT 管理，附着后通常已激活，先查询再配置
+
+typedef enum
+{
+    AT_DIALECT_SIM800, // 2G，承载经 AT+SAPBR 建立
+    AT_DIALECT_A76XX,  // LTE Cat.1，原生 PDP 上下文
+    AT_DIALECT_COUNT,
+} at_dialect_id_t;
+
+typedef struct
+{
+    at_dialect_id_t id;
+    const char *name;
+    const char *ident; // ATI 或 AT+GMR 的响应中含有该串即为此命令集
+    uint32_t caps;
+
+    // 承载
+    const char *const *pdp_setup;   // 激活前依次发送的配置命令，NULL 结尾
+    const char *pdp_activate;
+    int pdp_activate_timeout_ms;
+    const char *pdp_query;          // 应答行以 pdp_query_prefix 开头，地址为最后一个字段
+    const char *pdp_query_prefix;
+    const char *pdp_lost_urc;       // 承载被网络去激活的 URC 前缀
+    const char *pdp_lost_match;     // 该 URC 中表示去激活的内容
+
+    // SIM 卡
+    const char *iccid_query;
+    const char *iccid_prefix; // 应答行前缀，ICCID 紧随其后
+
+    // HTTP
+    const char *http_bearer;      // HTTPINIT 之后绑定承载的命令，NULL 为不需要
+    const char *http_read;        // offset, len
+    const char *http_read_prefix; // 声明随后原始数据长度的行
+    size_t http_chunk;            // 调用者未指定时每条 HTTPREAD 的字节数
+    size_t http_chunk_max;
+    const char *http_action;        // method
+    const char *http_action_prefix; // 请求完成时上报的 URC 前缀
+    const char *http_action_format; // 从该 URC 解析 method, status, 长度的 sscanf 格式
+
+    // MQTT
+    const char *mq_config;     // clientId, username, password
+    const char *mq_start;      // server, port
+    const char *mq_start_ok;   // 新建或已有连接的响应中都含有该串
+    const char *mq_connect;    // keepalive 秒数
+    const char *mq_connect_ok; // 服务端接受会话
+    const char *mq_subscribe;  // topic
+    const char *mq_subscribe_ok;
+    const char *mq_publish;    // topic, 负载字节数；随后等待 '>' 写入负载
+    const char *mq_disconnect;
+    const char *mq_close;
+} at_dialect_t;
+
+// 按编号取描述符，越界返回 NULL
+const at_dialect_t *at_dialect_get(at_dialect_id_t id);
+// 在探测响应中查找已知命令集，没有匹配时返回 NULL
+const at_dialect_t *at_dialect_match(const char *ident);
+// Kconfig 选定的命令集；自动探测时为探测前使用的 SIM800
+const at_dialect_t *at_dialect_default(void);
+#endif
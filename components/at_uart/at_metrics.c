@@ -0,0 +1,150 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "at_metrics.h"
+
+static SemaphoreHandle_t metricsLock = NULL;
+static at_metrics_t metrics;
+
+void at_metrics_init(void)
+{
+    if (metricsLock == NULL)
+    {
+        metricsLock = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(metricsLock, portMAX_DELAY);
+    memset(&metrics, 0, sizeof(metrics));
+    metrics.since_us = esp_timer_get_time();
+    xSemaphoreGive(metricsLock);
+}
+
+// 动词为 '=' 或 '?' 之前的部分，"AT+HTTPREAD=0,1024" -> "AT+HTTPREAD"
+static size_t verb_len(const char *command)
+{
+    size_t len = strcspn(command, "=?");
+    return len < AT_METRICS_VERB_MAX ? len : AT_METRICS_VERB_MAX - 1;
+}
+
+static at_metrics_verb_t *find_verb(const char *command)
+{
+    size_t len = verb_len(command);
+    for (int i = 0; i < metrics.verb_count; i++)
+    {
+        at_metrics_verb_t *verb = &metrics.verbs[i];
+        if (strncmp(verb->verb, command, len) == 0 && verb->verb[len] == '\0')
+        {
+            return verb;
+        }
+    }
+    // 最后一个槽位留给 "other"
+    if (metrics.verb_count == AT_METRICS_VERB_SLOTS)
+    {
+        return &metrics.verbs[AT_METRICS_VERB_SLOTS - 1];
+    }
+    at_metrics_verb_t *verb = &metrics.verbs[metrics.verb_count++];
+    if (metrics.verb_count < AT_METRICS_VERB_SLOTS)
+    {
+        memcpy(verb->verb, command, len);
+        verb->verb[len] = '\0';
+    }
+    else
+    {
+        strcpy(verb->verb, "other");
+    }
+    return verb;
+}
+
+static int bucket_of(int64_t latency_us)
+{
+    uint32_t ms = latency_us > 0 ? (uint32_t)(latency_us / 1000) : 0;
+    if (ms == 0)
+    {
+        return 0;
+    }
+    int bucket = 32 - __builtin_clz(ms);
+    return bucket < AT_METRICS_BUCKETS ? bucket : AT_METRICS_BUCKETS - 1;
+}
+
+void at_metrics_record(const char *command, at_status_t status, uint32_t bytes_tx, uint32_t bytes_rx, int64_t latency_us)
+{
+    if (metricsLock == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(metricsLock, portMAX_DELAY);
+    at_metrics_verb_t *verb = find_verb(command);
+    verb->count++;
+    switch (status)
+    {
+    case AT_STATUS_OK:
+        verb->ok++;
+        break;
+    case AT_STATUS_ERROR:
+        verb->error++;
+        break;
+    default:
+        verb->timeout++;
+        break;
+    }
+    verb->bytes_tx += bytes_tx;
+    verb->bytes_rx += bytes_rx;
+    verb->total_us += latency_us;
+    if (latency_us > verb->max_us)
+    {
+        verb->max_us = latency_us > UINT32_MAX ? UINT32_MAX : (uint32_t)latency_us;
+    }
+    verb->hist[bucket_of(latency_us)]++;
+    xSemaphoreGive(metricsLock);
+}
+
+void at_metrics_rx_dropped(size_t bytes)
+{
+    // 只有读任务写入，读到半更新的值也只影响一次上报
+    metrics.rx_dropped += bytes;
+}
+
+void at_metrics_snapshot(at_metrics_t *out, bool reset)
+{
+    if (metricsLock == NULL)
+    {
+        memset(out, 0, sizeof(*out));
+        at_uart_get_link(&out->link);
+        return;
+    }
+    xSemaphoreTake(metricsLock, portMAX_DELAY);
+    *out = metrics;
+    if (reset)
+    {
+        memset(&metrics, 0, sizeof(metrics));
+        metrics.since_us = esp_timer_get_time();
+    }
+    xSemaphoreGive(metricsLock);
+    at_uart_get_link(&out->link);
+}
+
+uint32_t at_metrics_percentile_ms(const at_metrics_verb_t *verb, int percent)
+{
+    if (verb->count == 0)
+    {
+        return 0;
+    }
+    // 第 rank 个样本所在的桶，rank 从 1 开始
+    uint64_t rank = ((uint64_t)verb->count * percent + 99) / 100;
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < AT_METRICS_BUCKETS - 1; i++)
+    {
+        seen += verb->hist[i];
+        if (seen >= rank)
+        {
+            uint32_t upper = 1u << i;
+            uint32_t max_ms = (verb->max_us + 999) / 1000;
+            return upper < max_ms ? upper : max_ms;
+        }
+    }
+    return (verb->max_us + 999) / 1000;
+}
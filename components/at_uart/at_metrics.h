@@ -0,0 +1,49 @@
+#ifndef AT_METRICS_H
+#define AT_METRICS_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "at_uart.h"
+
+// 按命令动词（AT+MPUBEX、AT+HTTPACTION ...）统计次数、结果、字节数和延迟分布
+// 只在引擎任务中记录，快照可在任意任务中获取
+
+#define AT_METRICS_VERB_MAX 16   // 动词长度上限，含结尾 0
+#define AT_METRICS_VERB_SLOTS 24 // 动词种类上限，超出的计入 "other"
+#define AT_METRICS_BUCKETS 16    // 延迟直方图桶数
+
+// 桶 0 为 <1 ms，桶 i 为 [2^(i-1), 2^i) ms，最后一桶收纳更长的延迟
+typedef struct
+{
+    char verb[AT_METRICS_VERB_MAX];
+    uint32_t count;
+    uint32_t ok;
+    uint32_t error;
+    uint32_t timeout;
+    uint64_t bytes_tx;  // 命令、\r 与数据
+    uint64_t bytes_rx;  // 归属该命令的响应行与原始数据
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t hist[AT_METRICS_BUCKETS];
+} at_metrics_verb_t;
+
+typedef struct
+{
+    int64_t since_us;    // 统计起点（启动或上次清零）
+    int verb_count;
+    at_metrics_verb_t verbs[AT_METRICS_VERB_SLOTS];
+    uint32_t rx_dropped; // 接收环满时丢弃的字节数
+    at_uart_link_t link;
+} at_metrics_t;
+
+// 由 at_uart 调用
+void at_metrics_init(void);
+void at_metrics_record(const char *command, at_status_t status, uint32_t bytes_tx, uint32_t bytes_rx, int64_t latency_us);
+void at_metrics_rx_dropped(size_t bytes);
+
+// 拷贝当前统计，reset 为 true 时随后清零，用于按周期上报增量；
+// at_metrics_t 约 3 KB，不宜放在小栈上
+void at_metrics_snapshot(at_metrics_t *out, bool reset);
+// 按直方图估算百分位延迟，返回所在桶的上界（ms），最后一桶返回最大值
+uint32_t at_metrics_percentile_ms(const at_metrics_verb_t *verb, int percent);
+#endif
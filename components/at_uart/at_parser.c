@@ -0,0 +1,164 @@
+#include <string.h>
+#include <stdlib.h>
+#include "at_parser.h"
+
+#define STARTS_WITH(line, len, lit) ((len) >= sizeof(lit) - 1 && memcmp((line), (lit), sizeof(lit) - 1) == 0)
+#define EQUALS(line, len, lit) ((len) == sizeof(lit) - 1 && memcmp((line), (lit), sizeof(lit) - 1) == 0)
+
+void at_parser_init(at_parser_t *parser, char *buf, size_t cap, at_line_cb_t on_line, void *ctx)
+{
+    parser->line = buf;
+    parser->cap = cap;
+    parser->len = 0;
+    parser->skipSpace = false;
+    parser->rawLeft = 0;
+    parser->on_raw = NULL;
+    parser->on_line = on_line;
+    parser->ctx = ctx;
+    parser->headerPrefix = NULL;
+    parser->headerTerminator = NULL;
+    parser->on_header = NULL;
+    parser->inHeader = false;
+}
+
+void at_parser_reset(at_parser_t *parser)
+{
+    parser->len = 0;
+    parser->skipSpace = false;
+    parser->rawLeft = 0;
+    parser->inHeader = false;
+}
+
+void at_parser_set_inline_header(at_parser_t *parser, const char *prefix, const char *terminator, at_header_cb_t on_header)
+{
+    parser->headerPrefix = prefix;
+    parser->headerTerminator = terminator;
+    parser->on_header = on_header;
+}
+
+// 追加一个字节后检查行内长度头：前缀在行首凑齐时进入头部状态，之后只比较行尾
+static bool header_done(at_parser_t *parser)
+{
+    if (parser->headerPrefix == NULL)
+    {
+        return false;
+    }
+    if (!parser->inHeader)
+    {
+        size_t prefixLen = strlen(parser->headerPrefix);
+        parser->inHeader = parser->len == prefixLen && memcmp(parser->line, parser->headerPrefix, prefixLen) == 0;
+        return false;
+    }
+    size_t termLen = strlen(parser->headerTerminator);
+    return parser->len >= termLen && memcmp(parser->line + parser->len - termLen, parser->headerTerminator, termLen) == 0;
+}
+
+void at_parser_expect_raw(at_parser_t *parser, size_t len, at_raw_cb_t on_raw)
+{
+    parser->rawLeft = len;
+    parser->on_raw = on_raw;
+}
+
+at_line_type_t at_parser_classify(const char *line, size_t len)
+{
+    if (EQUALS(line, len, "OK"))
+    {
+        return AT_LINE_OK;
+    }
+    if (EQUALS(line, len, "ERROR") || EQUALS(line, len, "NO CARRIER") || EQUALS(line, len, "BUSY") ||
+        EQUALS(line, len, "NO ANSWER") || EQUALS(line, len, "NO DIALTONE"))
+    {
+        return AT_LINE_ERROR;
+    }
+    if (STARTS_WITH(line, len, "+CME ERROR:"))
+    {
+        return AT_LINE_CME_ERROR;
+    }
+    if (STARTS_WITH(line, len, "+CMS ERROR:"))
+    {
+        return AT_LINE_CMS_ERROR;
+    }
+    if (EQUALS(line, len, "DOWNLOAD") || EQUALS(line, len, ">"))
+    {
+        return AT_LINE_PROMPT;
+    }
+    return AT_LINE_INTERMEDIATE;
+}
+
+bool at_line_is_final(at_line_type_t type)
+{
+    return type == AT_LINE_OK || at_line_is_error(type);
+}
+
+bool at_line_is_error(at_line_type_t type)
+{
+    return type == AT_LINE_ERROR || type == AT_LINE_CME_ERROR || type == AT_LINE_CMS_ERROR;
+}
+
+static void emit(at_parser_t *parser)
+{
+    // 去掉行尾的 \r，空行直接丢弃
+    while (parser->len > 0 && parser->line[parser->len - 1] == '\r')
+    {
+        parser->len--;
+    }
+    if (parser->len > 0)
+    {
+        parser->line[parser->len] = '\0';
+        parser->on_line(at_parser_classify(parser->line, parser->len), parser->line, parser->len, parser->ctx);
+    }
+    parser->len = 0;
+    parser->inHeader = false;
+}
+
+void at_parser_feed(at_parser_t *parser, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (parser->rawLeft > 0)
+        {
+            // 原始数据整段交出，可能包含 \r\n 或任意二进制
+            size_t n = len - i < parser->rawLeft ? len - i : parser->rawLeft;
+            parser->rawLeft -= n;
+            parser->on_raw(data + i, n, parser->ctx);
+            i += n - 1;
+            continue;
+        }
+        char c = (char)data[i];
+        if (parser->skipSpace)
+        {
+            parser->skipSpace = false;
+            if (c == ' ')
+            {
+                continue;
+            }
+        }
+        if (c == '\n')
+        {
+            emit(parser);
+            continue;
+        }
+        if (c == '>' && parser->len == 0)
+        {
+            // 提示符后面模组等待数据，不会再发换行
+            parser->line[0] = '>';
+            parser->line[1] = '\0';
+            parser->on_line(AT_LINE_PROMPT, parser->line, 1, parser->ctx);
+            parser->skipSpace = true;
+            continue;
+        }
+        if (parser->len == parser->cap - 1)
+        {
+            // 超长行按缓冲区大小切段上报
+            emit(parser);
+        }
+        parser->line[parser->len++] = c;
+        if (header_done(parser))
+        {
+            parser->line[parser->len] = '\0';
+            parser->on_header(parser->line, parser->len, parser->ctx);
+            parser->len = 0;
+            parser->inHeader = false;
+        }
+    }
+}
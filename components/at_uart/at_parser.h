@@ -0,0 +1,57 @@
+#ifndef AT_PARSER_H
+#define AT_PARSER_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// AT 响应的行类型
+typedef enum
+{
+    AT_LINE_INTERMEDIATE, // 普通信息行或 URC
+    AT_LINE_OK,           // 最终结果码 OK
+    AT_LINE_ERROR,        // 最终结果码 ERROR / NO CARRIER 等
+    AT_LINE_CME_ERROR,    // +CME ERROR: <n>
+    AT_LINE_CMS_ERROR,    // +CMS ERROR: <n>
+    AT_LINE_PROMPT,       // 数据输入提示符 ">" 或 "DOWNLOAD"
+} at_line_type_t;
+
+// 每解析出一行调用一次，line 以 '\0' 结尾且不含行尾 \r\n
+typedef void (*at_line_cb_t)(at_line_type_t type, const char *line, size_t len, void *ctx);
+
+// 原始数据回调，data 直接指向喂入的缓冲区，不经过行缓冲
+typedef void (*at_raw_cb_t)(const uint8_t *data, size_t len, void *ctx);
+
+// 行内长度头回调：头部与数据在同一行（如 +MSUB: "<topic>",<n> byte,<data>），
+// 头部一结束就上报，由回调调用 at_parser_expect_raw 接收随后的数据
+typedef void (*at_header_cb_t)(const char *line, size_t len, void *ctx);
+
+// 流式解析器：按字节喂入，跨多次读取拼接行，
+// 提示符 ">" 不以换行结束，收到即上报
+typedef struct
+{
+    char *line;
+    size_t cap;
+    size_t len;
+    bool skipSpace; // 提示符 "> " 之后的空格不属于下一行
+    size_t rawLeft; // 尚未收到的原始数据字节数，期间不按行解析
+    at_raw_cb_t on_raw;
+    at_line_cb_t on_line;
+    void *ctx;
+    const char *headerPrefix;     // 行内长度头的前缀与结束标记
+    const char *headerTerminator;
+    at_header_cb_t on_header;
+    bool inHeader;                // 当前行以 headerPrefix 开头
+} at_parser_t;
+
+void at_parser_init(at_parser_t *parser, char *buf, size_t cap, at_line_cb_t on_line, void *ctx);
+void at_parser_feed(at_parser_t *parser, const uint8_t *data, size_t len);
+void at_parser_reset(at_parser_t *parser);
+// 接下来的 len 字节是原始数据（如 +HTTPREAD 之后的响应体），原样交给 on_raw
+// 可以在 on_line 回调中调用，对当前行之后的字节生效
+void at_parser_expect_raw(at_parser_t *parser, size_t len, at_raw_cb_t on_raw);
+// 以 prefix 开头的行在出现 terminator 时作为头部交给 on_header，不再按行上报
+void at_parser_set_inline_header(at_parser_t *parser, const char *prefix, const char *terminator, at_header_cb_t on_header);
+at_line_type_t at_parser_classify(const char *line, size_t len);
+bool at_line_is_final(at_line_type_t type);
+bool at_line_is_error(at_line_type_t type);
+#endif
@@ -0,0 +1,77 @@
+#include <string.h>
+#include "at_ring.h"
+
+void at_ring_init(at_ring_t *ring, uint8_t *storage, size_t size)
+{
+    ring->buf = storage;
+    ring->size = size;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+}
+
+size_t at_ring_used(at_ring_t *ring)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
+
+size_t at_ring_free(at_ring_t *ring)
+{
+    return ring->size - at_ring_used(ring);
+}
+
+// 生产者调用：写入尽可能多的数据，返回实际写入字节数
+size_t at_ring_write(at_ring_t *ring, const uint8_t *data, size_t len)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t space = ring->size - (head - tail);
+    if (len > space)
+    {
+        len = space;
+    }
+
+    size_t offset = head & (ring->size - 1);
+    size_t first = ring->size - offset;
+    if (first > len)
+    {
+        first = len;
+    }
+    memcpy(ring->buf + offset, data, first);
+    memcpy(ring->buf, data + first, len - first);
+
+    atomic_store_explicit(&ring->head, head + len, memory_order_release);
+    return len;
+}
+
+// 消费者调用：读出最多 max 字节，返回实际读取字节数
+size_t at_ring_read(at_ring_t *ring, uint8_t *out, size_t max)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t len = head - tail;
+    if (len > max)
+    {
+        len = max;
+    }
+
+    size_t offset = tail & (ring->size - 1);
+    size_t first = ring->size - offset;
+    if (first > len)
+    {
+        first = len;
+    }
+    memcpy(out, ring->buf + offset, first);
+    memcpy(out + first, ring->buf, len - first);
+
+    atomic_store_explicit(&ring->tail, tail + len, memory_order_release);
+    return len;
+}
+
+// 仅在生产者和消费者都停止时调用
+void at_ring_reset(at_ring_t *ring)
+{
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+}
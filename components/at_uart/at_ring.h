@@ -0,0 +1,23 @@
+#ifndef AT_RING_H
+#define AT_RING_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// 单生产者/单消费者无锁环形缓冲区
+// 生产者只写 head，消费者只写 tail，容量必须是 2 的幂
+typedef struct
+{
+    uint8_t *buf;
+    size_t size;
+    atomic_size_t head;
+    atomic_size_t tail;
+} at_ring_t;
+
+void at_ring_init(at_ring_t *ring, uint8_t *storage, size_t size);
+size_t at_ring_write(at_ring_t *ring, const uint8_t *data, size_t len);
+size_t at_ring_read(at_ring_t *ring, uint8_t *out, size_t max);
+size_t at_ring_used(at_ring_t *ring);
+size_t at_ring_free(at_ring_t *ring);
+void at_ring_reset(at_ring_t *ring);
+#endif
@@ -0,0 +1,119 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_system.h"
+#endif
+#include "at_task.h"
+
+static const char *TAG = "AT_TASK";
+
+static at_task_t *tasks[AT_TASK_MAX];
+static int taskCount = 0;
+static portMUX_TYPE taskMux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool task_register(at_task_t *task)
+{
+    bool ok = true;
+    taskENTER_CRITICAL(&taskMux);
+    int i = 0;
+    while (i < taskCount && tasks[i] != task)
+    {
+        i++;
+    }
+    if (i == taskCount)
+    {
+        ok = taskCount < AT_TASK_MAX;
+        if (ok)
+        {
+            tasks[taskCount++] = task;
+        }
+    }
+    taskEXIT_CRITICAL(&taskMux);
+    return ok;
+}
+
+bool at_task_start(at_task_t *task, TaskFunction_t fn, const char *name, void *arg, UBaseType_t priority, BaseType_t core)
+{
+    if (task->handle != NULL)
+    {
+        return true;
+    }
+    if (!task_register(task))
+    {
+        ESP_LOGE(TAG, "Task table full, %s not started", name);
+        return false;
+    }
+    task->name = name;
+    task->handle = xTaskCreateStaticPinnedToCore(fn, name, task->stack_size / sizeof(StackType_t), arg, priority,
+                                                 task->stack, &task->tcb, core);
+    if (task->handle == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to start task %s", name);
+        return false;
+    }
+    return true;
+}
+
+void at_task_stop(at_task_t *task)
+{
+    TaskHandle_t handle = task->handle;
+    if (handle != NULL)
+    {
+        task->handle = NULL;
+        vTaskDelete(handle);
+    }
+}
+
+int at_task_get_stats(at_task_stats_t *out, int max)
+{
+    int n = 0;
+    taskENTER_CRITICAL(&taskMux);
+    int count = taskCount;
+    taskEXIT_CRITICAL(&taskMux);
+    for (int i = 0; i < count && n < max; i++)
+    {
+        at_task_t *task = tasks[i];
+        TaskHandle_t handle = task->handle;
+        out[n++] = (at_task_stats_t){
+            .name = task->name,
+            .stack_size = task->stack_size,
+            .stack_free = handle ? uxTaskGetStackHighWaterMark(handle) * sizeof(StackType_t) : 0,
+            .running = handle != NULL,
+        };
+    }
+    return n;
+}
+
+void at_task_get_heap(at_heap_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+#if !CONFIG_IDF_TARGET_LINUX
+    out->heap_free = esp_get_free_heap_size();
+    out->heap_min_free = esp_get_minimum_free_heap_size();
+#endif
+    taskENTER_CRITICAL(&taskMux);
+    for (int i = 0; i < taskCount; i++)
+    {
+        out->static_bytes += tasks[i]->stack_size + sizeof(StaticTask_t);
+    }
+    taskEXIT_CRITICAL(&taskMux);
+}
+
+void at_task_log(void)
+{
+    at_task_stats_t stats[AT_TASK_MAX];
+    int n = at_task_get_stats(stats, AT_TASK_MAX);
+    for (int i = 0; i < n; i++)
+    {
+        ESP_LOGI(TAG, "%-16s stack %5u free %5u%s", stats[i].name, (unsigned)stats[i].stack_size,
+                 (unsigned)stats[i].stack_free, stats[i].running ? "" : " (stopped)");
+    }
+    at_heap_stats_t heap;
+    at_task_get_heap(&heap);
+    ESP_LOGI(TAG, "heap free %u min %u, static task memory %u", (unsigned)heap.heap_free, (unsigned)heap.heap_min_free,
+             (unsigned)heap.static_bytes);
+}
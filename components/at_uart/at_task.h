@@ -0,0 +1,51 @@
+#ifndef AT_TASK_H
+#define AT_TASK_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// 组件任务统一静态创建：栈与控制块是静态数组，不再从堆上分配；
+// 创建的任务登记在表中，可随时对照栈预算查看实测的剩余高水位
+
+#define AT_TASK_MAX 20 // 可登记的任务数，每个模组实例占 3 个
+
+typedef struct
+{
+    const char *name;
+    TaskHandle_t handle;
+    StaticTask_t tcb;
+    StackType_t *stack;
+    uint32_t stack_size; // 栈预算，字节
+} at_task_t;
+
+// 定义一个任务的静态栈与控制块，bytes 为栈预算
+#define AT_TASK_DEFINE(var, bytes)                                  \
+    static StackType_t var##Stack[(bytes) / sizeof(StackType_t)];   \
+    static at_task_t var = {.stack = var##Stack, .stack_size = (bytes)}
+
+typedef struct
+{
+    const char *name;
+    uint32_t stack_size; // 字节
+    uint32_t stack_free; // 运行以来的最小剩余栈，字节
+    bool running;
+} at_task_stats_t;
+
+typedef struct
+{
+    uint32_t heap_free;     // 当前空闲堆，linux 目标为 0
+    uint32_t heap_min_free; // 启动以来的最小空闲堆
+    uint32_t static_bytes;  // 已登记任务的栈与控制块合计
+} at_heap_stats_t;
+
+// 任务已在运行时直接返回 true
+bool at_task_start(at_task_t *task, TaskFunction_t fn, const char *name, void *arg, UBaseType_t priority, BaseType_t core);
+// 删除任务，之后可以再次 start；不能用于删除当前任务自身
+void at_task_stop(at_task_t *task);
+// 拷贝登记的任务统计，返回条数
+int at_task_get_stats(at_task_stats_t *out, int max);
+void at_task_get_heap(at_heap_stats_t *out);
+// 以日志输出全部任务的栈预算、剩余高水位与堆余量
+void at_task_log(void);
+#endif
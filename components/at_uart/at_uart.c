@@ -1,197 +1,1765 @@
-#include <dirent.h>
+#include <stdio.h>
 #include <string.h>
-#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/message_buffer.h"
 #include "esp_log.h"
 #include "esp_err.h"
-#include "driver/gpio.h"
+#include "esp_timer.h"
 #include "at_config.h"
 #include "at_utils.h"
+#include "at_uart.h"
+#include "at_uart_port.h"
+#include "at_ring.h"
+#include "at_parser.h"
+#include "at_metrics.h"
+#include "at_task.h"
+#include "at_cmux.h"
+#include <stdlib.h>
 #include <freertos/semphr.h>
-#define UART_NUM UART_NUM_1
-#define TXD_PIN GPIO_NUM_17 // UART1 TX 引脚
-#define RXD_PIN GPIO_NUM_18 // UART1 RX 引脚
 #define UART_BUF_LISTEN_SIZE 512
+#define AT_RING_SIZE 4096         // 读任务 -> 引擎任务 环形缓冲区（控制通道），必须是 2 的幂
+#define AT_MQ_RING_SIZE 2048      // MQTT 通道的接收环
+#define AT_DATA_RING_SIZE 4096    // 数据通道的接收环，承接 HTTPREAD 大块数据
+#define AT_RING_FULL_WAIT_MS 100  // 环满时读任务等待引擎消费的上限，超过后丢弃
+#define AT_URC_MAX 8              // 最多可注册的 URC 处理器
+#define AT_SUBMIT_QUEUE_SIZE 16   // 控制通道提交队列深度，未启用 CMUX 时承载全部命令
+#define AT_CHAN_QUEUE_SIZE 8      // 其余通道的提交队列深度，首次启用 CMUX 时创建
+#define AT_EXPECTED_MAX 32
+#define AT_PROMPT_MAX 16
+#define AT_DATA_PREFIX_MAX 16
+#define AT_BAUD_SETTLE_MS 50      // 模组回复 OK 后切换到新波特率所需的时间
+#define AT_BAUD_PROBE_TRIES 5     // 新波特率下连续成功的 AT 往返次数
+#define AT_MSUB_FRAME_MAX 4096    // 单条 +MSUB（头部加负载）的上限，超出的整条丢弃而不截断
+#define AT_MSUB_BUFFER_SIZE 8192  // 引擎任务 -> 消息处理任务 的消息缓冲区
+#define AT_CMUX_N1 127            // 每帧信息字段上限，即 AT+CMUX 的 N1，单字节长度即可表示
+#define AT_CMUX_RX_MAX 512        // 接受的最大帧，模组未按 N1 分帧时仍可收下
+#define AT_CMUX_ACK_MS 1000       // 等待 UA 的时间
+#define AT_CMUX_RETRIES 3
+// 任务栈预算（字节），按实测高水位加日志与回调的余量确定，见 at_task_log
+#define AT_ENGINE_STACK 2560
+#define AT_READER_STACK 2048
+#define AT_MESSAGE_STACK 3072     // 含 at_mq 路由回调
+
+#define AT_TASK_NAME_MAX 20
 
 static const char *TAG = "UART";
-static SemaphoreHandle_t xMutex = NULL;
-static QueueHandle_t messageQueue = NULL;
-static bool inited = false;
 
-// 封装互斥锁获取逻辑，增加超时保护
-static bool take_mutex_with_timeout(SemaphoreHandle_t mutex, int timeout_ms)
+typedef struct
+{
+    const char *prefix;
+    size_t prefix_len;
+    at_urc_handler_t handler;
+    void *ctx;
+} at_urc_entry_t;
+
+// 提交队列中的命令，字符串按值复制，提交方无需保持其生命周期
+typedef struct
+{
+    char command[UART_BUF_SIZE];
+    char expected[AT_EXPECTED_MAX];
+    char prompt[AT_PROMPT_MAX];
+    const uint8_t *payload;
+    size_t payload_len;
+    at_payload_fn_t payload_fn;
+    void *payload_ctx;
+    char dataPrefix[AT_DATA_PREFIX_MAX];
+    at_data_fn_t data_fn;
+    void *data_ctx;
+    int timeout_ms;
+    bool noR;
+    at_cmd_cb_t cb;
+    void *ctx;
+} at_job_t;
+
+// 正在执行的命令，只由引擎任务访问
+typedef struct
+{
+    at_job_t job;
+    bool active;
+    bool awaitingPrompt;
+    bool done;
+    bool matched; // 期望内容已出现，等最终 OK
+    bool finalOk; // 最终 OK 已出现，等期望内容（如 OK 之后的 URC）
+    at_status_t status;
+    int errorCode;
+    int64_t started_us;
+    int64_t deadline_us;
+    uint32_t bytesTx;
+    uint32_t bytesRx;
+    char response[UART_BUF_SIZE];
+    size_t length;
+} at_inflight_t;
+
+// 一条虚拟通道：独立的接收环、解析器、提交队列与在途命令。
+// 未启用 CMUX 时只有控制通道工作，直接对应串口；启用后通道 i 对应 DLCI i + 1
+typedef struct
+{
+    at_modem_t *modem;
+    at_channel_t id;
+    volatile bool open; // 控制通道始终可用，其余通道在 DLC 建立后可用
+    volatile bool closing; // DLC 已断开，等引擎任务收尾后再清 open
+    at_ring_t rxRing;
+    at_parser_t parser;
+    char parserLine[UART_BUF_LISTEN_SIZE];
+    at_inflight_t inflight;
+    QueueHandle_t submitQueue;
+    // 提交时组装作业的暂存区，避免每个提交者栈上都放一份 at_job_t
+    at_job_t submitJob;
+    SemaphoreHandle_t submitLock;
+    StaticSemaphore_t submitLockBuffer;
+} at_chan_t;
+
+static const size_t ringSize[AT_CHAN_COUNT] = {AT_RING_SIZE, AT_MQ_RING_SIZE, AT_DATA_RING_SIZE};
+
+// 一个模组实例的全部状态，原先的文件级静态变量逐一搬入，实例之间不共享任何可变状态
+struct at_modem
+{
+    bool used;
+    volatile bool inited;
+    at_modem_port_t portConfig;
+    at_port_t *port;
+    at_uart_link_t link;
+    bool flowWired; // RTS/CTS 引脚已连接，协商时尝试启用
+    const at_dialect_t *dialect;
+    bool dialectKnown; // 已由 Kconfig、探测或热启动缓存确定
+
+    at_urc_entry_t urcTable[AT_URC_MAX];
+    int urcCount;
+
+    at_chan_t chans[AT_CHAN_COUNT];
+    uint8_t ctrlRingStorage[AT_RING_SIZE];
+    uint8_t mqRingStorage[AT_MQ_RING_SIZE];
+    uint8_t dataRingStorage[AT_DATA_RING_SIZE];
+    // 引擎回调中提交的命令用引擎自己的一份，不与阻塞在满队列上的提交者争锁
+    at_job_t engineJob;
+    // 引擎从提交队列取出的作业，不占引擎栈
+    at_job_t nextJob;
+    // 共享的命令/响应暂存区，见 at_scratch_take
+    at_scratch_t scratch;
+    SemaphoreHandle_t scratchLock;
+    StaticSemaphore_t scratchLockBuffer;
+
+    // ---------------- CMUX ----------------
+    // 读任务解帧后按 DLCI 分发到各通道的接收环；写出由 txLock 串行化，
+    // 引擎、读任务（应答控制报文）与启停流程都可能写
+    volatile bool cmuxActive;
+    at_cmux_decoder_t cmuxDecoder;
+    uint8_t cmuxRxBuf[AT_CMUX_RX_MAX];
+    uint8_t cmuxTxFrame[AT_CMUX_N1 + AT_CMUX_FRAME_OVERHEAD];
+    SemaphoreHandle_t txLock;
+    StaticSemaphore_t txLockBuffer;
+    // 启停流程等待的应答
+    SemaphoreHandle_t cmuxAckSem;
+    StaticSemaphore_t cmuxAckBuffer;
+    volatile int cmuxWaitDlci;
+    volatile bool cmuxAck;
+
+    // 带数据的命令收到提示符后写出数据，之后继续等待期望的响应；
+    // at_write_fn_t 不带上下文，引擎在调用生产者前记下当前通道
+    at_chan_t *writeChan;
+
+    // ---------------- +MSUB 组帧 ----------------
+    // 下行消息 +MSUB: "<topic>",<n> byte,<负载>，负载可能含 \r\n 或任意二进制，
+    // 头部一结束就按声明的长度收取负载，一条 URC 组成一帧；只由引擎任务访问。
+    // 模组只在一条 DLC 上推送下行消息，组帧状态不按通道区分
+    uint8_t msubFrame[AT_MSUB_FRAME_MAX + 1];
+    size_t msubLen;
+    size_t msubLeft;
+    bool msubDropping;
+    at_chan_t *msubChan;
+
+    // 静态分配，随实例常驻，deinit 后重新 init 不再向堆申请
+    MessageBufferHandle_t messageBuffer;
+    StaticMessageBuffer_t messageBufferStruct;
+    uint8_t messageStorage[AT_MSUB_BUFFER_SIZE + 1];
+    at_message_handler_t messageHandler;
+    void *messageHandlerCtx;
+    // 单一消费者，帧可能有数 KB，不放在任务栈上
+    char receivedMessage[AT_MSUB_FRAME_MAX + 1];
+
+    at_task_t readerTask;
+    at_task_t engineTask;
+    at_task_t messageTask;
+    StackType_t readerStack[AT_READER_STACK / sizeof(StackType_t)];
+    StackType_t engineStack[AT_ENGINE_STACK / sizeof(StackType_t)];
+    StackType_t messageStack[AT_MESSAGE_STACK / sizeof(StackType_t)];
+    char readerName[AT_TASK_NAME_MAX];
+    char engineName[AT_TASK_NAME_MAX];
+    char messageName[AT_TASK_NAME_MAX];
+};
+
+static at_modem_t modems[AT_MODEM_MAX];
+
+// 任务名：默认实例保持原名，其余实例追加序号
+static void task_name(char *out, const char *base, int index)
+{
+    if (index == 0)
+    {
+        snprintf(out, AT_TASK_NAME_MAX, "%s", base);
+    }
+    else
+    {
+        snprintf(out, AT_TASK_NAME_MAX, "%s%d", base, index);
+    }
+}
+
+at_modem_t *at_modem_create(const at_modem_port_t *port)
+{
+    for (int i = 0; i < AT_MODEM_MAX; i++)
+    {
+        at_modem_t *m = &modems[i];
+        if (m->used)
+        {
+            continue;
+        }
+        m->used = true;
+        m->portConfig = *port;
+        m->link = (at_uart_link_t)AT_UART_DEFAULT_LINK();
+        m->cmuxWaitDlci = -1;
+        m->dialect = at_dialect_default();
+#if !CONFIG_AT_DIALECT_AUTO
+        m->dialectKnown = true;
+#endif
+        m->readerTask = (at_task_t){.stack = m->readerStack, .stack_size = AT_READER_STACK};
+        m->engineTask = (at_task_t){.stack = m->engineStack, .stack_size = AT_ENGINE_STACK};
+        m->messageTask = (at_task_t){.stack = m->messageStack, .stack_size = AT_MESSAGE_STACK};
+        task_name(m->readerName, "at_uart_reader", i);
+        task_name(m->engineName, "at_uart_engine", i);
+        task_name(m->messageName, "message_handler", i);
+        return m;
+    }
+    ESP_LOGE(TAG, "No free modem slot, AT_MODEM_MAX is %d", AT_MODEM_MAX);
+    return NULL;
+}
+
+at_modem_t *at_modem_default(void)
+{
+    if (!modems[0].used)
+    {
+        at_modem_port_t port = AT_MODEM_PORT_DEFAULT();
+        at_modem_create(&port);
+    }
+    return &modems[0];
+}
+
+at_modem_t *at_modem_get(int index)
+{
+    if (index < 0 || index >= AT_MODEM_MAX || !modems[index].used)
+    {
+        return NULL;
+    }
+    return &modems[index];
+}
+
+int at_modem_index(const at_modem_t *modem)
+{
+    return modem ? (int)(modem - modems) : 0;
+}
+
+// NULL 即默认实例
+static at_modem_t *modem_of(at_modem_t *modem)
+{
+    return modem ? modem : at_modem_default();
+}
+
+// 当前任务是哪个实例的引擎，不是引擎任务时返回 NULL
+static at_modem_t *engine_modem(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < AT_MODEM_MAX; i++)
+    {
+        if (modems[i].used && modems[i].engineTask.handle == self)
+        {
+            return &modems[i];
+        }
+    }
+    return NULL;
+}
+
+static void cmux_send(at_modem_t *m, uint8_t dlci, uint8_t control, const void *data, size_t len)
+{
+    xSemaphoreTake(m->txLock, portMAX_DELAY);
+    size_t n = at_cmux_encode(dlci, control, true, data, len, m->cmuxTxFrame, sizeof(m->cmuxTxFrame));
+    at_port_write(m->port, m->cmuxTxFrame, n);
+    xSemaphoreGive(m->txLock);
+}
+
+// 通道数据写出：多路复用时按 N1 切成 UIH 帧
+static void chan_port_write(at_chan_t *chan, const void *data, size_t len)
+{
+    at_modem_t *m = chan->modem;
+    if (!m->cmuxActive)
+    {
+        at_port_write(m->port, data, len);
+        return;
+    }
+    const uint8_t *p = data;
+    while (len > 0)
+    {
+        size_t n = len < AT_CMUX_N1 ? len : AT_CMUX_N1;
+        cmux_send(m, chan->id + 1, AT_CMUX_UIH, p, n);
+        p += n;
+        len -= n;
+    }
+}
+
+// 未启用 CMUX 或通道未建立时落到控制通道
+static at_chan_t *chan_for(at_modem_t *m, at_channel_t channel)
+{
+    if (channel < AT_CHAN_COUNT && m->chans[channel].open)
+    {
+        return &m->chans[channel];
+    }
+    return &m->chans[AT_CHAN_CTRL];
+}
+
+// 将一行追加到当前命令的响应，保持 "\r\n" 分隔以兼容原有的解析
+static void response_append(at_inflight_t *inflight, const char *line, size_t len)
+{
+    size_t room = sizeof(inflight->response) - 1 - inflight->length;
+    if (len + 2 > room)
+    {
+        len = room > 2 ? room - 2 : 0;
+    }
+    memcpy(inflight->response + inflight->length, line, len);
+    inflight->length += len;
+    if (room >= 2)
+    {
+        memcpy(inflight->response + inflight->length, "\r\n", 2);
+        inflight->length += 2;
+    }
+    inflight->response[inflight->length] = '\0';
+}
+
+static bool urc_matches(const at_urc_entry_t *urc, const char *line, size_t len)
+{
+    return len >= urc->prefix_len && memcmp(line, urc->prefix, urc->prefix_len) == 0;
+}
+
+// 同一前缀可以注册多个处理器，按注册顺序全部调用；返回是否有处理器匹配
+static bool dispatch_urc(at_modem_t *m, const char *line, size_t len)
+{
+    bool handled = false;
+    for (int i = 0; i < m->urcCount; i++)
+    {
+        if (urc_matches(&m->urcTable[i], line, len))
+        {
+            m->urcTable[i].handler(line, len, m->urcTable[i].ctx);
+            handled = true;
+        }
+    }
+    return handled;
+}
+
+static void chan_write(at_chan_t *chan, const void *data, size_t len)
+{
+    chan_port_write(chan, data, len);
+    chan->inflight.bytesTx += len;
+}
+
+// 生产者在引擎任务中调用，按当前引擎找到实例
+static void port_write(const void *data, size_t len)
+{
+    chan_write(engine_modem()->writeChan, data, len);
+}
+
+static void send_payload(at_chan_t *chan)
+{
+    at_inflight_t *inflight = &chan->inflight;
+    inflight->awaitingPrompt = false;
+    if (inflight->job.payload_fn)
+    {
+        // 数据由生产者分块直接写入串口，不经过中间缓冲
+        chan->modem->writeChan = chan;
+        inflight->job.payload_fn(port_write, inflight->job.payload_ctx);
+    }
+    else if (inflight->job.payload_len > 0)
+    {
+        chan_write(chan, inflight->job.payload, inflight->job.payload_len);
+    }
+}
+
+static void complete(at_inflight_t *inflight, at_status_t status)
+{
+    inflight->done = true;
+    inflight->status = status;
+}
+
+// 期望内容出现在最终 OK 之前时命令要等到 OK 再结束，
+// 否则这个 OK 会留在通道上把下一条流水线命令提前结束
+static void expected_seen(at_inflight_t *inflight)
+{
+    if (inflight->finalOk)
+    {
+        complete(inflight, AT_STATUS_OK);
+    }
+    else
+    {
+        inflight->matched = true;
+    }
+}
+
+// 原始数据交给当前命令；命令已超时结束时丢弃剩余数据
+static void on_raw(const uint8_t *data, size_t len, void *ctx)
+{
+    at_inflight_t *inflight = &((at_chan_t *)ctx)->inflight;
+    if (inflight->active && !inflight->done && inflight->job.data_fn)
+    {
+        inflight->bytesRx += len;
+        inflight->job.data_fn(data, len, inflight->job.data_ctx);
+    }
+}
+
+// 数据头 "+HTTPREAD: <n>" 或 "+HTTPREAD: DATA,<n>"，长度取最后一个字段
+static bool data_header(at_chan_t *chan, const char *line, size_t len)
+{
+    size_t prefixLen = strlen(chan->inflight.job.dataPrefix);
+    if (prefixLen == 0 || len < prefixLen || memcmp(line, chan->inflight.job.dataPrefix, prefixLen) != 0)
+    {
+        return false;
+    }
+    const char *field = strrchr(line, ',');
+    long n = atol(field ? field + 1 : line + prefixLen);
+    if (n > 0)
+    {
+        at_parser_expect_raw(&chan->parser, (size_t)n, on_raw);
+    }
+    return true;
+}
+
+// 解析器回调：URC 交给注册的处理器，其余交给所在通道的当前命令
+// 最终结果码 ERROR/+CME/+CMS 立即结束命令，不再等到超时
+// 期望内容先于 OK 出现时等到 OK 才结束，OK 先到时等期望内容（如 OK 之后的 URC）
+static void on_line(at_line_type_t type, const char *line, size_t len, void *ctx)
+{
+    at_chan_t *chan = ctx;
+    at_inflight_t *inflight = &chan->inflight;
+    bool urc = type == AT_LINE_INTERMEDIATE && dispatch_urc(chan->modem, line, len);
+
+    if (!inflight->active || inflight->done)
+    {
+        return;
+    }
+    if (!urc)
+    {
+        inflight->bytesRx += len + 2;
+    }
+    // 回显的命令本身不参与匹配
+    if (type == AT_LINE_INTERMEDIATE && strcmp(line, inflight->job.command) == 0)
+    {
+        return;
+    }
+    if (at_line_is_error(type))
+    {
+        response_append(inflight, line, len);
+        if (type != AT_LINE_ERROR)
+        {
+            inflight->errorCode = atoi(line + strlen("+CME ERROR:"));
+        }
+        complete(inflight, AT_STATUS_ERROR);
+        return;
+    }
+    if (type == AT_LINE_INTERMEDIATE && inflight->job.data_fn && data_header(chan, line, len))
+    {
+        return;
+    }
+    if (inflight->awaitingPrompt)
+    {
+        if (type == AT_LINE_PROMPT || strstr(line, inflight->job.prompt))
+        {
+            send_payload(chan);
+        }
+        return;
+    }
+
+    // URC 只有在恰好是命令期望的内容时才并入命令响应
+    bool match = strstr(line, inflight->job.expected) != NULL;
+    if (!urc || match)
+    {
+        response_append(inflight, line, len);
+    }
+    if (type == AT_LINE_OK)
+    {
+        if (match || inflight->matched)
+        {
+            complete(inflight, AT_STATUS_OK);
+        }
+        else
+        {
+            inflight->finalOk = true;
+        }
+        return;
+    }
+    if (match)
+    {
+        expected_seen(inflight);
+    }
+}
+
+// ---------------- +MSUB 组帧 ----------------
+static void msub_deliver(at_modem_t *m)
+{
+    if (m->msubDropping)
+    {
+        ESP_LOGE(TAG, "+MSUB message of %d bytes exceeds %d, dropped", (int)m->msubLen, AT_MSUB_FRAME_MAX);
+        return;
+    }
+    m->msubFrame[m->msubLen] = '\0';
+    // 命令等待的下行回复（如 /ping/reply）仍并入命令响应
+    at_inflight_t *inflight = &m->msubChan->inflight;
+    if (inflight->active && !inflight->done && !inflight->awaitingPrompt &&
+        strstr((char *)m->msubFrame, inflight->job.expected))
+    {
+        response_append(inflight, (char *)m->msubFrame, m->msubLen);
+        expected_seen(inflight);
+    }
+    if (xMessageBufferSend(m->messageBuffer, m->msubFrame, m->msubLen, 0) == 0)
+    {
+        ESP_LOGE(TAG, "Message buffer full, dropped %d bytes", (int)m->msubLen);
+    }
+}
+
+static void on_msub_raw(const uint8_t *data, size_t len, void *ctx)
+{
+    at_modem_t *m = ((at_chan_t *)ctx)->modem;
+    if (!m->msubDropping)
+    {
+        memcpy(m->msubFrame + m->msubLen, data, len);
+    }
+    m->msubLen += len;
+    m->msubLeft -= len;
+    if (m->msubLeft == 0)
+    {
+        msub_deliver(m);
+    }
+}
+
+// 头部以 " byte," 结尾，长度是其前面的数字；主题中的逗号和引号不影响解析
+static void on_msub_header(const char *line, size_t len, void *ctx)
+{
+    const char *end = line + len - strlen(" byte,");
+    const char *digits = end;
+    while (digits > line && digits[-1] >= '0' && digits[-1] <= '9')
+    {
+        digits--;
+    }
+    size_t n = digits < end ? strtoul(digits, NULL, 10) : 0;
+
+    at_chan_t *chan = ctx;
+    at_modem_t *m = chan->modem;
+    m->msubChan = chan;
+    m->msubLen = len;
+    m->msubLeft = n;
+    m->msubDropping = len + n > AT_MSUB_FRAME_MAX;
+    if (!m->msubDropping)
+    {
+        memcpy(m->msubFrame, line, len);
+    }
+    if (n == 0)
+    {
+        msub_deliver(m);
+        return;
+    }
+    at_parser_expect_raw(&chan->parser, n, on_msub_raw);
+}
+
+// 读任务把一段数据搬进通道的接收环；
+// 环满时先让引擎消费，大块原始数据（如 HTTPREAD）连续到达时不丢字节
+static void chan_rx(at_chan_t *chan, const uint8_t *data, size_t length)
+{
+    size_t written = at_ring_write(&chan->rxRing, data, length);
+    for (int waited = 0; written < length && waited < AT_RING_FULL_WAIT_MS; waited++)
+    {
+        xTaskNotifyGive(chan->modem->engineTask.handle);
+        vTaskDelay(1);
+        written += at_ring_write(&chan->rxRing, data + written, length - written);
+    }
+    if (written < length)
+    {
+        at_metrics_rx_dropped(length - written);
+        ESP_LOGE(TAG, "RX ring full on channel %d, dropped %d bytes", chan->id, (int)(length - written));
+    }
+}
+
+// DLCI 0 上的控制报文：模组发来的命令原样回应（C/R 清零），
+// 对 CLD 的回应视为关闭确认；流控（MSC 的 FC 位）不处理，由各通道的接收环等待吸收
+static void cmux_control(at_modem_t *m, const uint8_t *data, size_t len)
+{
+    if (len < 2)
+    {
+        return;
+    }
+    uint8_t type = data[0] & ~0x03;
+    if (data[0] & 0x02)
+    {
+        uint8_t reply[8];
+        size_t n = len < sizeof(reply) ? len : sizeof(reply);
+        memcpy(reply, data, n);
+        reply[0] &= ~0x02;
+        cmux_send(m, 0, AT_CMUX_UIH, reply, n);
+        return;
+    }
+    if (type == AT_CMUX_MSG_CLD && m->cmuxWaitDlci == 0)
+    {
+        m->cmuxAck = true;
+        xSemaphoreGive(m->cmuxAckSem);
+    }
+}
+
+// 通道的在途命令与队列只归引擎任务管，关闭只做标记，由引擎收尾后清 open
+static void chan_request_close(at_chan_t *chan)
+{
+    if (chan->open)
+    {
+        chan->closing = true;
+        xTaskNotifyGive(chan->modem->engineTask.handle);
+    }
+}
+
+static void on_cmux_frame(uint8_t dlci, uint8_t control, const uint8_t *data, size_t len, void *ctx)
+{
+    at_modem_t *m = ctx;
+    if (control == AT_CMUX_UIH)
+    {
+        if (dlci == 0)
+        {
+            cmux_control(m, data, len);
+        }
+        else if (dlci <= AT_CHAN_COUNT)
+        {
+            chan_rx(&m->chans[dlci - 1], data, len);
+        }
+        return;
+    }
+    if ((control == AT_CMUX_UA || control == AT_CMUX_DM) && dlci == m->cmuxWaitDlci)
+    {
+        m->cmuxAck = control == AT_CMUX_UA;
+        xSemaphoreGive(m->cmuxAckSem);
+        return;
+    }
+    if (control == AT_CMUX_DISC && dlci > 0 && dlci <= AT_CHAN_COUNT)
+    {
+        // 模组主动断开的通道回落到控制通道
+        ESP_LOGW(TAG, "Modem closed channel %d", dlci - 1);
+        if (dlci - 1 != AT_CHAN_CTRL)
+        {
+            chan_request_close(&m->chans[dlci - 1]);
+        }
+        cmux_send(m, dlci, AT_CMUX_UA | AT_CMUX_PF, NULL, 0);
+    }
+}
+
+// UART 读任务：阻塞在串口后端上，把数据搬进环形缓冲区，多路复用时先解帧
+static void at_uart_reader_task(void *arg)
+{
+    at_modem_t *m = arg;
+    uint8_t chunk[256];
+
+    while (1)
+    {
+        int length = at_port_read(m->port, chunk, sizeof(chunk));
+        if (length <= 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        if (m->cmuxActive)
+        {
+            at_cmux_feed(&m->cmuxDecoder, chunk, length);
+        }
+        else
+        {
+            chan_rx(&m->chans[AT_CHAN_CTRL], chunk, length);
+        }
+        xTaskNotifyGive(m->engineTask.handle);
+    }
+}
+
+// 从环形缓冲区取数据喂给解析器
+static void drain_rx(at_chan_t *chan)
+{
+    uint8_t chunk[128];
+    size_t length;
+    while ((length = at_ring_read(&chan->rxRing, chunk, sizeof(chunk))) > 0)
+    {
+        at_parser_feed(&chan->parser, chunk, length);
+    }
+}
+
+static void start_job(at_chan_t *chan, const at_job_t *job)
+{
+    at_inflight_t *inflight = &chan->inflight;
+    inflight->job = *job;
+    inflight->active = true;
+    inflight->done = false;
+    inflight->matched = false;
+    inflight->finalOk = false;
+    inflight->awaitingPrompt = job->prompt[0] != '\0';
+    inflight->status = AT_STATUS_TIMEOUT;
+    inflight->errorCode = 0;
+    inflight->length = 0;
+    inflight->response[0] = '\0';
+    inflight->started_us = esp_timer_get_time();
+    inflight->deadline_us = inflight->started_us + (int64_t)job->timeout_ms * 1000;
+    inflight->bytesTx = 0;
+    inflight->bytesRx = 0;
+
+    chan_write(chan, job->command, strlen(job->command));
+    if (!job->noR)
+    {
+        chan_write(chan, "\r", 1);
+    }
+}
+
+static void finish_job(at_chan_t *chan)
+{
+    at_inflight_t *inflight = &chan->inflight;
+    at_result_t result = {
+        .status = inflight->status,
+        .response = inflight->response,
+        .length = inflight->length,
+        .error_code = inflight->errorCode,
+        .latency_us = esp_timer_get_time() - inflight->started_us,
+    };
+    at_metrics_record(inflight->job.command, result.status, inflight->bytesTx, inflight->bytesRx, result.latency_us);
+    if (result.status == AT_STATUS_TIMEOUT)
+    {
+        ESP_LOGE(TAG, "Timeout waiting for response to %s. Last response: %s", inflight->job.command, inflight->response);
+        // 原始数据没有收全，不能让剩余长度吞掉后续命令的响应
+        at_parser_expect_raw(&chan->parser, 0, NULL);
+        at_modem_t *m = chan->modem;
+        if (m->msubLeft > 0 && m->msubChan == chan)
+        {
+            ESP_LOGE(TAG, "+MSUB payload incomplete, %d bytes missing", (int)m->msubLeft);
+            m->msubLeft = 0;
+        }
+    }
+    else if (result.status == AT_STATUS_ERROR)
+    {
+        ESP_LOGE(TAG, "%s failed: %s", inflight->job.command, inflight->response);
+    }
+    inflight->active = false;
+    if (inflight->job.cb)
+    {
+        inflight->job.cb(&result, inflight->job.ctx);
+    }
+}
+
+// 不经通道直接以 ERROR 结束一条排队的命令
+static void fail_job(const at_job_t *job)
+{
+    at_result_t result = {
+        .status = AT_STATUS_ERROR,
+        .response = "",
+    };
+    ESP_LOGE(TAG, "%s dropped, channel closed", job->command);
+    at_metrics_record(job->command, result.status, 0, 0, 0);
+    if (job->cb)
+    {
+        job->cb(&result, job->ctx);
+    }
+}
+
+// 已关闭通道上排队的命令转到控制通道，控制通道队列已满时以 ERROR 结束
+static void chan_forward_queued(at_modem_t *m, at_chan_t *chan)
+{
+    at_chan_t *ctrl = &m->chans[AT_CHAN_CTRL];
+    if (chan == ctrl || chan->submitQueue == NULL)
+    {
+        return;
+    }
+    while (xQueueReceive(chan->submitQueue, &m->nextJob, 0) == pdTRUE)
+    {
+        if (xQueueSend(ctrl->submitQueue, &m->nextJob, 0) != pdTRUE)
+        {
+            fail_job(&m->nextJob);
+        }
+    }
+}
+
+// 引擎任务中收尾一条已断开的通道：在途命令以 ERROR 结束，否则 at_send 会永远等下去；
+// 排队的命令转到控制通道；接收环与解析器清空，重新打开时从干净状态开始
+static void chan_close(at_modem_t *m, at_chan_t *chan)
+{
+    at_inflight_t *inflight = &chan->inflight;
+    if (inflight->active)
+    {
+        if (!inflight->done)
+        {
+            complete(inflight, AT_STATUS_ERROR);
+        }
+        finish_job(chan);
+    }
+    if (m->msubLeft > 0 && m->msubChan == chan)
+    {
+        m->msubLeft = 0;
+    }
+    at_ring_reset(&chan->rxRing);
+    at_parser_reset(&chan->parser);
+    chan->open = false;
+    chan->closing = false;
+    chan_forward_queued(m, chan);
+}
+
+// 距最近一个截止时间的等待；有通道空闲且队列里有命令时不等待
+static TickType_t engine_wait(at_modem_t *m)
+{
+    TickType_t wait = portMAX_DELAY;
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < AT_CHAN_COUNT; i++)
+    {
+        at_chan_t *chan = &m->chans[i];
+        if (chan->closing)
+        {
+            return 0;
+        }
+        if (!chan->open)
+        {
+            // 关闭后仍可能有提交者按旧状态入队，要尽快转走
+            if (chan->submitQueue && uxQueueMessagesWaiting(chan->submitQueue) > 0)
+            {
+                return 0;
+            }
+            continue;
+        }
+        if (!chan->inflight.active)
+        {
+            if (uxQueueMessagesWaiting(chan->submitQueue) > 0)
+            {
+                return 0;
+            }
+            continue;
+        }
+        int64_t remaining = chan->inflight.deadline_us - now;
+        TickType_t ticks = remaining > 0 ? pdMS_TO_TICKS((remaining + 999) / 1000) : 0;
+        if (ticks == 0 && remaining > 0)
+        {
+            ticks = 1;
+        }
+        if (ticks < wait)
+        {
+            wait = ticks;
+        }
+    }
+    return wait;
+}
+
+// 引擎任务：唯一消费各通道的接收环并驱动各自的提交队列，
+// 每条通道上一条命令一结束就立即发出下一条，通道之间互不等待
+static void at_uart_engine_task(void *arg)
+{
+    at_modem_t *m = arg;
+
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, engine_wait(m));
+
+        for (int i = 0; i < AT_CHAN_COUNT; i++)
+        {
+            at_chan_t *chan = &m->chans[i];
+            at_inflight_t *inflight = &chan->inflight;
+            if (chan->closing)
+            {
+                chan_close(m, chan);
+            }
+            if (!chan->open)
+            {
+                chan_forward_queued(m, chan);
+                continue;
+            }
+            drain_rx(chan);
+
+            if (inflight->active && !inflight->done && esp_timer_get_time() >= inflight->deadline_us)
+            {
+                complete(inflight, AT_STATUS_TIMEOUT);
+            }
+            if (inflight->active && inflight->done)
+            {
+                finish_job(chan);
+            }
+            if (!inflight->active && xQueueReceive(chan->submitQueue, &m->nextJob, 0) == pdTRUE)
+            {
+                start_job(chan, &m->nextJob);
+            }
+        }
+    }
+}
+
+static void at_scratch_init(at_modem_t *m)
+{
+    if (m->scratchLock == NULL)
+    {
+        m->scratchLock = xSemaphoreCreateMutexStatic(&m->scratchLockBuffer);
+    }
+}
+
+at_scratch_t *at_modem_scratch_take(at_modem_t *modem)
+{
+    at_modem_t *m = modem_of(modem);
+    at_scratch_init(m);
+    xSemaphoreTake(m->scratchLock, portMAX_DELAY);
+    m->scratch.command[0] = '\0';
+    m->scratch.response[0] = '\0';
+    return &m->scratch;
+}
+
+void at_modem_scratch_give(at_modem_t *modem, at_scratch_t *taken)
+{
+    xSemaphoreGive(modem_of(modem)->scratchLock);
+}
+
+at_scratch_t *at_scratch_take(void)
+{
+    return at_modem_scratch_take(NULL);
+}
+
+void at_scratch_give(at_scratch_t *taken)
+{
+    at_modem_scratch_give(NULL, taken);
+}
+
+bool at_modem_register_urc(at_modem_t *modem, const char *prefix, at_urc_handler_t handler, void *ctx)
+{
+    at_modem_t *m = modem_of(modem);
+    if (prefix == NULL || handler == NULL || m->urcCount >= AT_URC_MAX)
+    {
+        ESP_LOGE(TAG, "Failed to register URC handler");
+        return false;
+    }
+    m->urcTable[m->urcCount] = (at_urc_entry_t){
+        .prefix = prefix,
+        .prefix_len = strlen(prefix),
+        .handler = handler,
+        .ctx = ctx,
+    };
+    m->urcCount++;
+    return true;
+}
+
+bool at_uart_register_urc(const char *prefix, at_urc_handler_t handler, void *ctx)
+{
+    return at_modem_register_urc(NULL, prefix, handler, ctx);
+}
+
+void at_modem_set_link(at_modem_t *modem, const at_uart_link_t *link)
+{
+    at_modem_t *m = modem_of(modem);
+    if (m->inited)
+    {
+        ESP_LOGW(TAG, "UART already initialized, link settings ignored");
+        return;
+    }
+    m->link = *link;
+    m->flowWired = link->flow_ctrl;
+    m->link.flow_ctrl = false;
+}
+
+void at_modem_get_link(at_modem_t *modem, at_uart_link_t *out)
+{
+    *out = modem_of(modem)->link;
+}
+
+void at_uart_set_link(const at_uart_link_t *link)
+{
+    at_modem_set_link(NULL, link);
+}
+
+void at_uart_get_link(at_uart_link_t *out)
+{
+    at_modem_get_link(NULL, out);
+}
+
+// 初始化实例的串口、通道与任务
+bool at_modem_init(at_modem_t *modem)
+{
+    at_modem_t *m = modem_of(modem);
+    int index = at_modem_index(m);
+    if (m->inited)
+    {
+        ESP_LOGW(TAG, "UART already initialized");
+        return true;
+    }
+
+    // 引脚按是否连接分配，流控本身等协商成功后才启用
+    at_uart_link_t portLink = m->link;
+    portLink.flow_ctrl = m->flowWired;
+    m->port = at_port_open(&m->portConfig, &portLink);
+    if (m->port == NULL)
+    {
+        ESP_LOGE(TAG, "UART initialization failed");
+        return false;
+    }
+
+    at_chan_t *ctrl = &m->chans[AT_CHAN_CTRL];
+    ctrl->submitQueue = xQueueCreate(AT_SUBMIT_QUEUE_SIZE, sizeof(at_job_t));
+    if (ctrl->submitQueue == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create submit queue");
+        at_port_close(m->port);
+        return false;
+    }
+
+    m->messageBuffer = xMessageBufferCreateStatic(AT_MSUB_BUFFER_SIZE, m->messageStorage, &m->messageBufferStruct);
+    if (m->messageBuffer == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create message buffer");
+        vQueueDelete(ctrl->submitQueue);
+        ctrl->submitQueue = NULL;
+        at_port_close(m->port);
+        return false;
+    }
+
+    if (m->txLock == NULL)
+    {
+        m->txLock = xSemaphoreCreateMutexStatic(&m->txLockBuffer);
+        m->cmuxAckSem = xSemaphoreCreateBinaryStatic(&m->cmuxAckBuffer);
+    }
+    uint8_t *const ringStorage[AT_CHAN_COUNT] = {m->ctrlRingStorage, m->mqRingStorage, m->dataRingStorage};
+    for (int i = 0; i < AT_CHAN_COUNT; i++)
+    {
+        at_chan_t *chan = &m->chans[i];
+        chan->modem = m;
+        chan->id = i;
+        chan->open = i == AT_CHAN_CTRL;
+        chan->inflight.active = false;
+        if (chan->submitLock == NULL)
+        {
+            chan->submitLock = xSemaphoreCreateMutexStatic(&chan->submitLockBuffer);
+        }
+        at_ring_init(&chan->rxRing, ringStorage[i], ringSize[i]);
+        at_parser_init(&chan->parser, chan->parserLine, sizeof(chan->parserLine), on_line, chan);
+        at_parser_set_inline_header(&chan->parser, "+MSUB:", " byte,", on_msub_header);
+    }
+    at_cmux_decoder_init(&m->cmuxDecoder, m->cmuxRxBuf, sizeof(m->cmuxRxBuf), on_cmux_frame, m);
+    at_scratch_init(m);
+    // 统计是全部实例合计的，只在第一个实例启动时清零
+    bool first = true;
+    for (int i = 0; i < AT_MODEM_MAX; i++)
+    {
+        first = first && !modems[i].inited;
+    }
+    if (first)
+    {
+        at_metrics_init();
+    }
+
+    at_task_start(&m->engineTask, at_uart_engine_task, m->engineName, m, 9, 1);
+    at_task_start(&m->readerTask, at_uart_reader_task, m->readerName, m, 10, 1);
+
+    m->inited = true;
+    ESP_LOGI(TAG, "UART initialized successfully (modem %d)", index);
+    return true;
+}
+
+// 初始化默认实例
+void at_uart_init()
+{
+    at_modem_init(NULL);
+}
+
+// ---------------- 波特率协商 ----------------
+// 两端都能切换的波特率，从高到低
+static const uint32_t baudRates[] = {921600, 460800, 230400, 115200, 57600, 38400, 19200, 9600};
+
+static bool uart_set_host(at_modem_t *m, uint32_t baud, bool flow_ctrl)
+{
+    if (!at_port_set_baud(m->port, baud, flow_ctrl))
+    {
+        return false;
+    }
+    m->link.baud_rate = baud;
+    m->link.flow_ctrl = flow_ctrl;
+    return true;
+}
+
+static bool modem_command(at_modem_t *m, const char *command, int timeout_ms, char *out_response)
 {
-    return xSemaphoreTake(mutex, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+    return at_modem_send_command(m, AT_CHAN_CTRL, command, "OK", timeout_ms, out_response);
 }
 
-// 初始化 UART
-void at_uart_init()
+// AT 往返校验：连续 tries 次都收到 OK 才认为当前波特率可用
+static bool uart_probe(at_modem_t *m, int tries)
 {
-    if (inited)
+    for (int i = 0; i < tries; i++)
     {
-        ESP_LOGW(TAG, "UART already initialized");
-        return;
+        if (!modem_command(m, "AT", 300, NULL))
+        {
+            return false;
+        }
     }
+    return true;
+}
 
-    uart_config_t uart_config = {
-        .baud_rate = 115200,
-        .data_bits = UART_DATA_8_BITS,
-        .parity = UART_PARITY_DISABLE,
-        .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
-        .source_clk = UART_SCLK_APB,
-    };
-
-    if (uart_driver_install(UART_NUM, UART_BUF_SIZE, 0, 0, NULL, 0) != ESP_OK ||
-        uart_param_config(UART_NUM, &uart_config) != ESP_OK ||
-        uart_set_pin(UART_NUM, TXD_PIN, RXD_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK)
+// 模组停留在未知波特率（例如上次协商后热重启）时逐个波特率尝试
+static bool uart_find_baud(at_modem_t *m)
+{
+    for (size_t i = 0; i < sizeof(baudRates) / sizeof(baudRates[0]); i++)
     {
-        ESP_LOGE(TAG, "UART initialization failed");
-        return;
+        if (uart_set_host(m, baudRates[i], m->link.flow_ctrl) && uart_probe(m, 1))
+        {
+            ESP_LOGI(TAG, "Modem found at %u baud", (unsigned)baudRates[i]);
+            return true;
+        }
     }
+    uart_set_host(m, AT_UART_BASE_BAUD, false);
+    return false;
+}
 
-    xMutex = xSemaphoreCreateMutex();
-    if (xMutex == NULL)
+// AT+IPR=? 的应答中是否列出了 baud，例如 "+IPR: (),(0,1200,...,115200,230400)"
+static bool ipr_supports(const char *response, uint32_t baud)
+{
+    const char *p = strstr(response, "+IPR:");
+    if (p == NULL)
     {
-        ESP_LOGE(TAG, "Failed to create mutex");
-        uart_driver_delete(UART_NUM);
-        return;
+        return false;
+    }
+    while (*p)
+    {
+        if (*p >= '0' && *p <= '9')
+        {
+            char *end;
+            if (strtoul(p, &end, 10) == baud)
+            {
+                return true;
+            }
+            p = end;
+        }
+        else
+        {
+            p++;
+        }
     }
+    return false;
+}
 
-    messageQueue = xQueueCreate(10, UART_BUF_LISTEN_SIZE);
-    if (messageQueue == NULL)
+// 切换到 baud 并校验；失败时尽量让两端回到原波特率，返回 false 后由调用者确认链路
+static bool uart_try_baud(at_modem_t *m, uint32_t baud)
+{
+    uint32_t prev = m->link.baud_rate;
+    char command[24];
+    snprintf(command, sizeof(command), "AT+IPR=%u", (unsigned)baud);
+    // 模组在旧波特率下回复 OK 后才切换
+    if (!modem_command(m, command, 1000, NULL))
     {
-        ESP_LOGE(TAG, "Failed to create message queue");
-        vSemaphoreDelete(xMutex);
-        uart_driver_delete(UART_NUM);
-        return;
+        ESP_LOGW(TAG, "Modem rejected %u baud", (unsigned)baud);
+        return false;
+    }
+    vTaskDelay(pdMS_TO_TICKS(AT_BAUD_SETTLE_MS));
+    if (uart_set_host(m, baud, m->link.flow_ctrl) && uart_probe(m, AT_BAUD_PROBE_TRIES))
+    {
+        return true;
     }
 
-    inited = true;
-    ESP_LOGI(TAG, "UART initialized successfully");
+    ESP_LOGW(TAG, "Link unstable at %u baud, falling back", (unsigned)baud);
+    // 链路不稳定时命令仍可能偶尔送达，多试几次让模组切回
+    snprintf(command, sizeof(command), "AT+IPR=%u", (unsigned)prev);
+    for (int i = 0; i < AT_BAUD_PROBE_TRIES * 2; i++)
+    {
+        if (modem_command(m, command, 300, NULL))
+        {
+            break;
+        }
+    }
+    vTaskDelay(pdMS_TO_TICKS(AT_BAUD_SETTLE_MS));
+    uart_set_host(m, prev, m->link.flow_ctrl);
+    return false;
 }
 
-// 发送 AT 指令并等待响应
-bool at_send_command(const char *command, const char *expected_response, int timeout_ms, char *out_response, bool noR)
+bool at_modem_negotiate(at_modem_t *modem, uint32_t max_baud)
 {
-    if (!inited)
+    at_modem_t *m = modem_of(modem);
+    if (!m->inited)
     {
         ESP_LOGE(TAG, "UART not initialized");
         return false;
     }
+    if (!uart_probe(m, 1) && !uart_find_baud(m))
+    {
+        ESP_LOGE(TAG, "Modem not responding at any baud rate");
+        return false;
+    }
+
+    if (m->flowWired && !m->link.flow_ctrl)
+    {
+        if (modem_command(m, "AT+IFC=2,2", 1000, NULL) && uart_set_host(m, m->link.baud_rate, true) && uart_probe(m, 1))
+        {
+            ESP_LOGI(TAG, "RTS/CTS flow control enabled");
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Flow control not available, continuing without it");
+            uart_set_host(m, m->link.baud_rate, false);
+            modem_command(m, "AT+IFC=0,0", 1000, NULL);
+        }
+    }
+
+    // 支持的波特率列表放在暂存区，协商期间不与其他调用者交错
+    at_scratch_t *scratch = at_modem_scratch_take(m);
+    if (!modem_command(m, "AT+IPR=?", 1000, scratch->response))
+    {
+        at_modem_scratch_give(m, scratch);
+        ESP_LOGW(TAG, "Modem does not report baud rates, staying at %u", (unsigned)m->link.baud_rate);
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(baudRates) / sizeof(baudRates[0]); i++)
+    {
+        uint32_t baud = baudRates[i];
+        if (baud > max_baud || !ipr_supports(scratch->response, baud))
+        {
+            continue;
+        }
+        // 从高到低，当前波特率已是剩余候选中最快的
+        if (baud <= m->link.baud_rate && m->link.baud_rate <= max_baud)
+        {
+            break;
+        }
+        if (uart_try_baud(m, baud))
+        {
+            break;
+        }
+        if (!uart_probe(m, 1) && !uart_find_baud(m))
+        {
+            at_modem_scratch_give(m, scratch);
+            ESP_LOGE(TAG, "Lost modem while negotiating baud rate");
+            return false;
+        }
+    }
+    at_modem_scratch_give(m, scratch);
+    ESP_LOGI(TAG, "UART link at %u baud, flow control %s", (unsigned)m->link.baud_rate, m->link.flow_ctrl ? "on" : "off");
+    return true;
+}
+
+bool at_uart_negotiate(uint32_t max_baud)
+{
+    return at_modem_negotiate(NULL, max_baud);
+}
 
-    if (!take_mutex_with_timeout(xMutex, 500))
+bool at_modem_resume_link(at_modem_t *modem, const at_uart_link_t *link)
+{
+    at_modem_t *m = modem_of(modem);
+    if (!m->inited)
     {
-        ESP_LOGE(TAG, "Failed to take mutex");
+        ESP_LOGE(TAG, "UART not initialized");
         return false;
     }
+    return uart_set_host(m, link->baud_rate, link->flow_ctrl && m->flowWired);
+}
+
+bool at_uart_resume_link(const at_uart_link_t *link)
+{
+    return at_modem_resume_link(NULL, link);
+}
+
+// ---------------- 命令集 ----------------
+const at_dialect_t *at_modem_dialect(at_modem_t *modem)
+{
+    return modem_of(modem)->dialect;
+}
+
+const at_dialect_t *at_uart_dialect(void)
+{
+    return at_modem_dialect(NULL);
+}
+
+bool at_modem_dialect_known(at_modem_t *modem)
+{
+    return modem_of(modem)->dialectKnown;
+}
+
+void at_modem_set_dialect(at_modem_t *modem, const at_dialect_t *dialect)
+{
+    at_modem_t *m = modem_of(modem);
+    m->dialect = dialect;
+    m->dialectKnown = true;
+}
+
+// 先看 ATI 的型号，部分固件只在 AT+GMR 的版本号中带型号；都不认识时沿用默认命令集
+const at_dialect_t *at_modem_probe_dialect(at_modem_t *modem)
+{
+    at_modem_t *m = modem_of(modem);
+    if (m->dialectKnown)
+    {
+        return m->dialect;
+    }
+    static const char *const probes[] = {"ATI", "AT+GMR"};
+    at_scratch_t *scratch = at_modem_scratch_take(m);
+    bool answered = false;
+    const at_dialect_t *found = NULL;
+    for (int i = 0; i < 2 && found == NULL; i++)
+    {
+        if (modem_command(m, probes[i], 1000, scratch->response))
+        {
+            answered = true;
+            found = at_dialect_match(scratch->response);
+        }
+    }
+    at_modem_scratch_give(m, scratch);
+    if (!answered)
+    {
+        // 模组没有响应，下次再探测
+        return m->dialect;
+    }
+    if (found == NULL)
+    {
+        ESP_LOGW(TAG, "Unknown modem, using %s commands", m->dialect->name);
+        found = m->dialect;
+    }
+    ESP_LOGI(TAG, "Modem %d dialect: %s", at_modem_index(m), found->name);
+    at_modem_set_dialect(m, found);
+    return found;
+}
+
+// ---------------- CMUX 启停 ----------------
+// 27.007 的 <port_speed> 取值，9600 为 1，依次递增
+static int cmux_port_speed(uint32_t baud)
+{
+    static const uint32_t speeds[] = {9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600};
+    for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++)
+    {
+        if (speeds[i] == baud)
+        {
+            return i + 1;
+        }
+    }
+    return 5;
+}
 
-    char response[UART_BUF_SIZE] = {0};
-    uart_flush(UART_NUM);
-    uart_write_bytes(UART_NUM, command, strlen(command));
-    if (!noR)
+// 发出 SABM/DISC/CLD 并等待模组应答，超时重发
+static bool cmux_request(at_modem_t *m, uint8_t dlci, uint8_t control, const void *data, size_t len)
+{
+    for (int i = 0; i < AT_CMUX_RETRIES; i++)
     {
-        uart_write_bytes(UART_NUM, "\r", 1);
+        xSemaphoreTake(m->cmuxAckSem, 0);
+        m->cmuxAck = false;
+        m->cmuxWaitDlci = dlci;
+        cmux_send(m, dlci, control, data, len);
+        bool answered = xSemaphoreTake(m->cmuxAckSem, pdMS_TO_TICKS(AT_CMUX_ACK_MS)) == pdTRUE;
+        if (answered)
+        {
+            m->cmuxWaitDlci = -1;
+            return m->cmuxAck;
+        }
     }
+    m->cmuxWaitDlci = -1;
+    return false;
+}
 
-    int elapsed_time = 0;
-    while (elapsed_time < timeout_ms)
+bool at_modem_cmux_start(at_modem_t *modem)
+{
+    at_modem_t *m = modem_of(modem);
+    if (!m->inited)
+    {
+        ESP_LOGE(TAG, "UART not initialized");
+        return false;
+    }
+    if (m->cmuxActive)
     {
-        int length = uart_read_bytes(UART_NUM, (uint8_t *)response, sizeof(response) - 1, pdMS_TO_TICKS(100));
-        if (length > 0)
+        return true;
+    }
+    if (!(m->dialect->caps & AT_DIALECT_CAP_CMUX))
+    {
+        ESP_LOGE(TAG, "%s does not support CMUX", m->dialect->name);
+        return false;
+    }
+    for (int i = 0; i < AT_CHAN_COUNT; i++)
+    {
+        if (m->chans[i].submitQueue == NULL)
         {
-            response[length] = '\0';
-            if (strstr(response, expected_response))
+            m->chans[i].submitQueue = xQueueCreate(AT_CHAN_QUEUE_SIZE, sizeof(at_job_t));
+            if (m->chans[i].submitQueue == NULL)
             {
-                if (out_response)
-                {
-                    strncpy(out_response, response, UART_BUF_SIZE - 1);
-                    out_response[UART_BUF_SIZE - 1] = '\0';
-                }
-                xSemaphoreGive(xMutex);
-                return true;
+                ESP_LOGE(TAG, "Failed to create submit queue for channel %d", i);
+                return false;
             }
         }
-        elapsed_time += 100;
     }
 
-    ESP_LOGE(TAG, "Timeout waiting for response. Last response: %s", response);
-    if (out_response)
+    char command[40];
+    snprintf(command, sizeof(command), "AT+CMUX=0,0,%d,%d", cmux_port_speed(m->link.baud_rate), AT_CMUX_N1);
+    if (!modem_command(m, command, 3000, NULL))
     {
-        strncpy(out_response, "ERROR!", UART_BUF_SIZE - 1);
-        out_response[UART_BUF_SIZE - 1] = '\0';
+        ESP_LOGE(TAG, "Modem rejected CMUX");
+        return false;
     }
-
-    xSemaphoreGive(xMutex);
-    return false;
+    // 模组回复 OK 后只认帧，之后的数据都经过解帧
+    at_cmux_decoder_reset(&m->cmuxDecoder);
+    at_parser_reset(&m->chans[AT_CHAN_CTRL].parser);
+    m->cmuxActive = true;
+    if (!cmux_request(m, 0, AT_CMUX_SABM | AT_CMUX_PF, NULL, 0))
+    {
+        ESP_LOGE(TAG, "No answer on the CMUX control channel");
+        m->cmuxActive = false;
+        return false;
+    }
+    for (int i = 0; i < AT_CHAN_COUNT; i++)
+    {
+        if (!cmux_request(m, i + 1, AT_CMUX_SABM | AT_CMUX_PF, NULL, 0))
+        {
+            ESP_LOGE(TAG, "Failed to open CMUX channel %d", i);
+            at_modem_cmux_stop(m);
+            return false;
+        }
+        m->chans[i].open = true;
+        xTaskNotifyGive(m->engineTask.handle);
+    }
+    // 每条 DLC 是独立的 AT 解释器，回显分别关闭
+    for (int i = 0; i < AT_CHAN_COUNT; i++)
+    {
+        at_modem_send_command(m, i, "ATE0", "OK", 1000, NULL);
+    }
+    ESP_LOGI(TAG, "CMUX active with %d channels, N1 %d", AT_CHAN_COUNT, AT_CMUX_N1);
+    return true;
 }
 
-// UART 监听任务
-void at_uart_listening()
+void at_modem_cmux_stop(at_modem_t *modem)
 {
-    if (!inited || xMutex == NULL || messageQueue == NULL)
+    at_modem_t *m = modem_of(modem);
+    if (!m->cmuxActive)
     {
-        ESP_LOGE(TAG, "UART not properly initialized");
         return;
     }
+    for (int i = AT_CHAN_COUNT - 1; i >= 0; i--)
+    {
+        if (i != AT_CHAN_CTRL)
+        {
+            chan_request_close(&m->chans[i]);
+        }
+        cmux_request(m, i + 1, AT_CMUX_DISC | AT_CMUX_PF, NULL, 0);
+    }
+    // CLD 命令：类型字节带 EA 与 C/R 位，长度 0
+    static const uint8_t cld[] = {AT_CMUX_MSG_CLD | 0x03, 0x01};
+    if (!cmux_request(m, 0, AT_CMUX_UIH, cld, sizeof(cld)))
+    {
+        ESP_LOGW(TAG, "No answer to CMUX close, assuming AT mode");
+    }
+    m->cmuxActive = false;
+    at_parser_reset(&m->chans[AT_CHAN_CTRL].parser);
+    ESP_LOGI(TAG, "CMUX closed, %u bad frames", (unsigned)m->cmuxDecoder.badFrames);
+}
 
-    char response[UART_BUF_LISTEN_SIZE] = {0};
+bool at_modem_cmux_active(at_modem_t *modem)
+{
+    return modem_of(modem)->cmuxActive;
+}
 
-    while (1)
+bool at_uart_cmux_start(void)
+{
+    return at_modem_cmux_start(NULL);
+}
+
+void at_uart_cmux_stop(void)
+{
+    at_modem_cmux_stop(NULL);
+}
+
+bool at_uart_cmux_active(void)
+{
+    return at_modem_cmux_active(NULL);
+}
+
+bool at_submit(const at_cmd_t *cmd)
+{
+    at_modem_t *m = modem_of(cmd ? cmd->modem : NULL);
+    if (!m->inited)
+    {
+        ESP_LOGE(TAG, "UART not initialized");
+        return false;
+    }
+    // 作业按值复制字符串，放不下的直接拒绝，截断后的期望内容或提示符永远匹配不上
+    if (cmd == NULL || cmd->command == NULL || cmd->expected == NULL || strlen(cmd->command) >= UART_BUF_SIZE ||
+        strlen(cmd->expected) >= AT_EXPECTED_MAX || (cmd->prompt && strlen(cmd->prompt) >= AT_PROMPT_MAX) ||
+        (cmd->data_prefix && strlen(cmd->data_prefix) >= AT_DATA_PREFIX_MAX))
+    {
+        ESP_LOGE(TAG, "Invalid command");
+        return false;
+    }
+
+    // 作业在通道的暂存作业中组装，入队时复制；引擎回调中的提交用引擎自己的一份，
+    // 不与阻塞在满队列上的提交者争锁。各通道的锁相互独立，一条通道队列满不阻塞其他通道
+    at_chan_t *chan = chan_for(m, cmd->channel);
+    // 等待时间同时限制取锁：submit_wait_ms 为 0 的提交者（如定时器回调）从不阻塞，
+    // 锁被阻塞在满队列上的提交者占着时直接返回失败
+    bool fromEngine = xTaskGetCurrentTaskHandle() == m->engineTask.handle;
+    at_job_t *job = fromEngine ? &m->engineJob : &chan->submitJob;
+    TickType_t wait = cmd->submit_wait_ms < 0 ? portMAX_DELAY : pdMS_TO_TICKS(cmd->submit_wait_ms);
+    if (!fromEngine && xSemaphoreTake(chan->submitLock, wait) != pdTRUE)
+    {
+        ESP_LOGW(TAG, "Channel %d busy, %s not submitted", chan->id, cmd->command);
+        return false;
+    }
+    *job = (at_job_t){
+        .payload = cmd->payload,
+        .payload_len = cmd->payload_len,
+        .payload_fn = cmd->payload_fn,
+        .payload_ctx = cmd->payload_ctx,
+        .data_fn = cmd->data_fn,
+        .data_ctx = cmd->data_ctx,
+        .timeout_ms = cmd->timeout_ms,
+        .noR = cmd->noR,
+        .cb = cmd->cb,
+        .ctx = cmd->ctx,
+    };
+    strcpy(job->command, cmd->command);
+    strcpy(job->expected, cmd->expected);
+    if (cmd->prompt)
+    {
+        strcpy(job->prompt, cmd->prompt);
+    }
+    if (cmd->data_prefix)
+    {
+        strcpy(job->dataPrefix, cmd->data_prefix);
+    }
+
+    bool queued = xQueueSend(chan->submitQueue, job, wait) == pdTRUE;
+    if (!fromEngine)
+    {
+        xSemaphoreGive(chan->submitLock);
+    }
+    if (!queued)
+    {
+        ESP_LOGE(TAG, "Submit queue full, dropping %s", cmd->command);
+        return false;
+    }
+    xTaskNotifyGive(m->engineTask.handle);
+    return true;
+}
+
+bool at_send_command_async(const char *command, const char *expected_response, int timeout_ms, at_cmd_cb_t cb, void *ctx)
+{
+    at_cmd_t cmd = {
+        .command = command,
+        .expected = expected_response,
+        .timeout_ms = timeout_ms,
+        .cb = cb,
+        .ctx = ctx,
+    };
+    return at_submit(&cmd);
+}
+
+// 同步调用的完成上下文，位于调用者栈上
+typedef struct
+{
+    SemaphoreHandle_t done;
+    StaticSemaphore_t doneBuffer;
+    char *out_response;
+    bool ok;
+} at_sync_t;
+
+static void sync_complete(const at_result_t *result, void *ctx)
+{
+    at_sync_t *sync = ctx;
+    sync->ok = result->status == AT_STATUS_OK;
+    if (sync->out_response)
+    {
+        strncpy(sync->out_response, sync->ok ? result->response : "ERROR!", UART_BUF_SIZE - 1);
+        sync->out_response[UART_BUF_SIZE - 1] = '\0';
+    }
+    xSemaphoreGive(sync->done);
+}
+
+// 提交命令并阻塞等待其完成，引擎保证每条命令都会回调
+bool at_send(at_cmd_t *cmd, char *out_response)
+{
+    // 在引擎任务中等待自己才能完成的命令必然死锁，直接失败
+    if (xTaskGetCurrentTaskHandle() == modem_of(cmd->modem)->engineTask.handle)
     {
-        if (take_mutex_with_timeout(xMutex, 500))
+        ESP_LOGE(TAG, "at_send called from the engine task, %s not sent", cmd->command ? cmd->command : "(null)");
+        if (out_response)
         {
-            int length = uart_read_bytes(UART_NUM, (uint8_t *)response, sizeof(response) - 1, pdMS_TO_TICKS(100));
-            if (length > 0)
-            {
-                response[length] = '\0';
-                if (strstr(response, "+MSUB:"))
-                {
-                    if (xQueueSend(messageQueue, response, pdMS_TO_TICKS(100)) != pdPASS)
-                    {
-                        ESP_LOGE(TAG, "Failed to send message to queue");
-                    }
-                }
-            }
-            xSemaphoreGive(xMutex);
+            strncpy(out_response, "ERROR!", UART_BUF_SIZE - 1);
+        }
+        return false;
+    }
+    at_sync_t sync = {
+        .out_response = out_response,
+        .ok = false,
+    };
+    sync.done = xSemaphoreCreateBinaryStatic(&sync.doneBuffer);
+    cmd->cb = sync_complete;
+    cmd->ctx = &sync;
+    cmd->submit_wait_ms = -1;
+
+    if (!at_submit(cmd))
+    {
+        if (out_response)
+        {
+            strncpy(out_response, "ERROR!", UART_BUF_SIZE - 1);
         }
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        vSemaphoreDelete(sync.done);
+        return false;
     }
+    xSemaphoreTake(sync.done, portMAX_DELAY);
+    vSemaphoreDelete(sync.done);
+    return sync.ok;
+}
+
+// 发送 AT 指令并等待响应
+bool at_send_command(const char *command, const char *expected_response, int timeout_ms, char *out_response, bool noR)
+{
+    at_cmd_t cmd = {
+        .command = command,
+        .expected = expected_response,
+        .timeout_ms = timeout_ms,
+        .noR = noR,
+    };
+    return at_send(&cmd, out_response);
+}
+
+bool at_modem_send_command(at_modem_t *modem, at_channel_t channel, const char *command, const char *expected_response,
+                           int timeout_ms, char *out_response)
+{
+    at_cmd_t cmd = {
+        .command = command,
+        .expected = expected_response,
+        .timeout_ms = timeout_ms,
+        .channel = channel,
+        .modem = modem,
+    };
+    return at_send(&cmd, out_response);
+}
+
+bool at_send_command_on(at_channel_t channel, const char *command, const char *expected_response, int timeout_ms,
+                        char *out_response)
+{
+    return at_modem_send_command(NULL, channel, command, expected_response, timeout_ms, out_response);
+}
+
+// 发送带数据的 AT 指令：等到提示符后写出数据，再等待期望的响应
+// 整个过程在引擎内一次完成，其他任务的命令不会插入到提示符与数据之间
+bool at_send_with_payload(const char *command, const char *prompt, const void *payload, size_t payload_len,
+                          const char *expected_response, int timeout_ms, char *out_response)
+{
+    at_cmd_t cmd = {
+        .command = command,
+        .prompt = prompt,
+        .payload = payload,
+        .payload_len = payload_len,
+        .expected = expected_response,
+        .timeout_ms = timeout_ms,
+    };
+    return at_send(&cmd, out_response);
+}
+
+// 与 at_send_with_payload 相同，但数据由 payload_fn 在提示符到达后流式写出
+bool at_send_streamed(const char *command, const char *prompt, at_payload_fn_t payload_fn, void *payload_ctx,
+                      const char *expected_response, int timeout_ms, char *out_response)
+{
+    at_cmd_t cmd = {
+        .command = command,
+        .prompt = prompt,
+        .payload_fn = payload_fn,
+        .payload_ctx = payload_ctx,
+        .expected = expected_response,
+        .timeout_ms = timeout_ms,
+    };
+    return at_send(&cmd, out_response);
+}
+
+void at_modem_set_message_handler(at_modem_t *modem, at_message_handler_t handler, void *ctx)
+{
+    at_modem_t *m = modem_of(modem);
+    m->messageHandlerCtx = ctx;
+    m->messageHandler = handler;
 }
 
-// 消息处理任务
-void message_handler_task()
+void at_uart_set_message_handler(at_message_handler_t handler, void *ctx)
 {
-    char receivedMessage[UART_BUF_LISTEN_SIZE] = {0};
+    at_modem_set_message_handler(NULL, handler, ctx);
+}
+
+// 消息处理任务，每个实例一个
+void message_handler_task(void *arg)
+{
+    at_modem_t *m = modem_of(arg);
 
     while (1)
     {
-        if (xQueueReceive(messageQueue, receivedMessage, portMAX_DELAY) == pdTRUE)
+        size_t len = xMessageBufferReceive(m->messageBuffer, m->receivedMessage, AT_MSUB_FRAME_MAX, portMAX_DELAY);
+        if (len > 0)
         {
-            char res[UART_BUF_SIZE];
-            parse_json(receivedMessage, res);
-            ESP_LOGI(TAG, "Processing message: %s", res);
+            m->receivedMessage[len] = '\0';
+            if (m->messageHandler)
+            {
+                m->messageHandler(m->receivedMessage, len, m->messageHandlerCtx);
+                continue;
+            }
+            // 没有处理者时只记录其中的 JSON：帧可达 AT_MSUB_FRAME_MAX，直接按范围输出，不复制到栈上
+            const char *start = strchr(m->receivedMessage, '{');
+            const char *end = strrchr(m->receivedMessage, '}');
+            if (start && end && end > start)
+            {
+                ESP_LOGI(TAG, "Processing message: %.*s", (int)(end - start + 1), start);
+            }
+            else
+            {
+                ESP_LOGI(TAG, "Processing message: {}");
+            }
         }
     }
 }
 
-// 反初始化 UART
-void at_uart_deinit()
+bool at_modem_start_message_task(at_modem_t *modem)
+{
+    at_modem_t *m = modem_of(modem);
+    return at_task_start(&m->messageTask, message_handler_task, m->messageName, m, 5, 1);
+}
+
+bool at_uart_start_message_task(void)
+{
+    return at_modem_start_message_task(NULL);
+}
+
+// 反初始化实例
+void at_modem_deinit(at_modem_t *modem)
 {
-    if (!inited)
+    at_modem_t *m = modem_of(modem);
+    if (!m->inited)
     {
         ESP_LOGW(TAG, "UART not initialized, nothing to deinitialize");
         return;
     }
 
-    vSemaphoreDelete(xMutex);
-    vQueueDelete(messageQueue);
-    uart_driver_delete(UART_NUM);
-    inited = false;
+    at_task_stop(&m->readerTask);
+    at_task_stop(&m->engineTask);
+    at_task_stop(&m->messageTask);
+    for (int i = 0; i < AT_CHAN_COUNT; i++)
+    {
+        at_chan_t *chan = &m->chans[i];
+        if (chan->submitQueue)
+        {
+            vQueueDelete(chan->submitQueue);
+            chan->submitQueue = NULL;
+        }
+        at_ring_reset(&chan->rxRing);
+        at_parser_reset(&chan->parser);
+        chan->inflight.active = false;
+        chan->open = false;
+        chan->closing = false;
+    }
+    vMessageBufferDelete(m->messageBuffer);
+    m->messageBuffer = NULL;
+    at_port_close(m->port);
+    m->port = NULL;
+    m->cmuxActive = false;
+    m->msubLeft = 0;
+    m->urcCount = 0;
+    m->inited = false;
+
+    ESP_LOGI(TAG, "UART deinitialized successfully (modem %d)", at_modem_index(m));
+}
+
+void at_uart_deinit()
+{
+    at_modem_deinit(NULL);
+}
 
-    ESP_LOGI(TAG, "UART deinitialized successfully");
+bool at_modem_inited(at_modem_t *modem)
+{
+    return modem_of(modem)->inited;
 }
 
 bool is_uart_inited()
 {
-    return inited;
-}
\ No newline at end of file
+    return at_modem_inited(NULL);
+}
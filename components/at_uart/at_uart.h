@@ -2,15 +2,237 @@
 #ifndef AT_UART_H
 #define AT_UART_H
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "at_dialect.h"
+#include "at_config.h"
+
+// 模组实例数上限，见 Kconfig 中的 AT_MODEM_MAX；每个实例约占 30 KB 静态内存
+#ifdef CONFIG_AT_MODEM_MAX
+#define AT_MODEM_MAX CONFIG_AT_MODEM_MAX
+#else
+#define AT_MODEM_MAX 1
+#endif
+
+// 一个模组实例：串口、引脚、接收环、提交队列、引擎与读任务、CMUX 状态各自独立。
+// 第一个实例为默认实例，不带句柄的函数都作用于默认实例
+typedef struct at_modem at_modem_t;
+
+// 实例的串口与引脚
+typedef struct
+{
+    int uart_num;
+    int tx_pin;
+    int rx_pin;
+    int rts_pin;        // 接模组 CTS，at_uart_link_t.flow_ctrl 为 true 时才分配
+    int cts_pin;        // 接模组 RTS
+    const char *device; // linux 目标的串口设备，NULL 时使用 at_uart_set_device 或 AT_UART_DEVICE
+} at_modem_port_t;
+
+// 默认实例：UART1，TX 17 / RX 18 / RTS 16 / CTS 15
+#define AT_MODEM_PORT_DEFAULT() { \
+    .uart_num = 1,                \
+    .tx_pin = 17,                 \
+    .rx_pin = 18,                 \
+    .rts_pin = 16,                \
+    .cts_pin = 15,                \
+    .device = NULL,               \
+}
+
+// URC 处理器，line 不含行尾 \r\n，在引擎任务上下文中调用，不可阻塞
+typedef void (*at_urc_handler_t)(const char *line, size_t len, void *ctx);
+
+typedef enum
+{
+    AT_STATUS_OK,
+    AT_STATUS_ERROR,   // 模组回复 ERROR / +CME ERROR / +CMS ERROR
+    AT_STATUS_TIMEOUT,
+} at_status_t;
+
+// 命令结果，response 指向引擎内部缓冲区，仅在回调期间有效
+typedef struct
+{
+    at_status_t status;
+    const char *response;
+    size_t length;
+    int error_code;     // +CME/+CMS 错误码，其余为 0
+    int64_t latency_us; // 从写出命令到结束的耗时
+} at_result_t;
+
+// 完成回调，在引擎任务上下文中调用，不可阻塞，可以用 at_submit 继续提交命令；
+// 不能调用 at_send 与 at_send_command* 等同步接口，它们等待的正是引擎任务，会直接返回失败
+typedef void (*at_cmd_cb_t)(const at_result_t *result, void *ctx);
+
+// 数据写出函数，只能在 at_payload_fn_t 内调用
+typedef void (*at_write_fn_t)(const void *data, size_t len);
+// 数据生产者：提示符到达后在引擎任务中调用，通过 write 分块写出数据
+typedef void (*at_payload_fn_t)(at_write_fn_t write, void *ctx);
+
+// 原始数据接收函数：data_prefix 行之后的定长数据分段交给它，在引擎任务中调用，不可阻塞
+typedef void (*at_data_fn_t)(const void *data, size_t len, void *ctx);
+
+// 虚拟通道：启用 CMUX 后各自对应一条 DLC，拥有独立的接收环、解析器与提交队列，
+// 慢命令只阻塞所在通道；未启用时全部落在同一串口上按提交顺序执行
+typedef enum
+{
+    AT_CHAN_CTRL, // 控制与状态查询（DLCI 1）
+    AT_CHAN_MQ,   // MQTT 与下行 +MSUB（DLCI 2）
+    AT_CHAN_DATA, // HTTP 等大块数据（DLCI 3）
+    AT_CHAN_COUNT,
+} at_channel_t;
+
+typedef struct
+{
+    const char *command;
+    const char *expected;   // 出现该内容即视为成功
+    int timeout_ms;         // 从命令写出开始计算的截止时间
+    bool noR;               // 不追加 \r
+    const char *prompt;     // 非 NULL 时先等待提示符（如 ">"、"DOWNLOAD"）再写出 payload
+    const void *payload;    // 由调用者保持有效直到回调
+    size_t payload_len;
+    at_payload_fn_t payload_fn; // 设置后代替 payload，由调用者保持 payload_ctx 有效直到回调
+    void *payload_ctx;
+    const char *data_prefix; // 非 NULL 时以该前缀开头的行声明随后的原始数据长度，如 "+HTTPREAD:"
+    at_data_fn_t data_fn;    // 接收原始数据，由调用者保持 data_ctx 有效直到回调
+    void *data_ctx;
+    at_cmd_cb_t cb;
+    void *ctx;
+    int submit_wait_ms;     // 提交队列满或通道被其他提交者占用时的等待时间，负数表示一直等待
+    at_channel_t channel;   // 默认控制通道
+    at_modem_t *modem;      // NULL 为默认实例
+} at_cmd_t;
+
+#define AT_UART_BASE_BAUD 115200 // 模组上电默认波特率
+#define AT_UART_MAX_BAUD 921600  // 协商的上限
+
+// 串口链路参数
+typedef struct
+{
+    uint32_t baud_rate;  // 当前波特率
+    bool flow_ctrl;      // RTS/CTS 硬件流控；at_uart_set_link 中表示引脚已连接，协商成功后才启用
+    size_t rx_buf_size;  // 驱动 RX 缓冲区，按 128 字节硬件 FIFO 的整数倍取整
+    size_t tx_buf_size;  // 驱动 TX 缓冲区，0 表示写出时阻塞直到数据进入 FIFO
+} at_uart_link_t;
+
+#define AT_UART_DEFAULT_LINK() {        \
+    .baud_rate = AT_UART_BASE_BAUD,     \
+    .flow_ctrl = false,                 \
+    .rx_buf_size = 4096,                \
+    .tx_buf_size = 2048,                \
+}
+
+// at_uart_init 之前调用，未调用时使用 AT_UART_DEFAULT_LINK
+void at_uart_set_link(const at_uart_link_t *link);
+void at_uart_get_link(at_uart_link_t *out);
+
 void at_uart_init();
 
+// 波特率协商：AT+IPR=? 查询模组支持的波特率，从不超过 max_baud 的最高值开始逐级尝试，
+// 切换后以 AT 往返校验，失败自动回退；模组停留在未知波特率时先扫描找回。
+// 须在其他任务开始提交命令之前调用
+bool at_uart_negotiate(uint32_t max_baud);
+// 热启动时代替协商：直接把主机侧切到上次协商的结果，不发送任何命令，由调用者探测确认；
+// 流控只在 at_uart_set_link 声明已连线时启用
+bool at_uart_resume_link(const at_uart_link_t *link);
+
+// 进入 27.010 基本模式多路复用（AT+CMUX），依次建立控制 DLC 与各虚拟通道；
+// 与 at_uart_negotiate 一样须在其他任务开始提交命令之前调用，失败时留在 AT 模式
+bool at_uart_cmux_start(void);
+// 关闭全部 DLC 并退出多路复用，回到单一串口
+void at_uart_cmux_stop(void);
+bool at_uart_cmux_active(void);
+
 void at_uart_deinit();
 
 bool is_uart_inited();
 
-bool at_send_command(char *command, char *expected_response, int timeout_ms, char *out_response,bool noR);
+bool at_send_command(const char *command, const char *expected_response, int timeout_ms, char *out_response, bool noR);
+// 与 at_send_command 相同，在指定通道上执行
+bool at_send_command_on(at_channel_t channel, const char *command, const char *expected_response, int timeout_ms,
+                        char *out_response);
+// 提交任意命令并等待完成，cmd 的 cb/ctx 会被占用；
+// 不能在引擎任务中调用（完成回调、URC 处理器、payload_fn/data_fn），此时直接返回 false
+bool at_send(at_cmd_t *cmd, char *out_response);
+
+bool at_send_with_payload(const char *command, const char *prompt, const void *payload, size_t payload_len,
+                          const char *expected_response, int timeout_ms, char *out_response);
+
+bool at_send_streamed(const char *command, const char *prompt, at_payload_fn_t payload_fn, void *payload_ctx,
+                      const char *expected_response, int timeout_ms, char *out_response);
+
+// 异步提交，立即返回；命令与期望字符串会被复制。命令达到 UART_BUF_SIZE、期望内容达到 32 字节、
+// 提示符或数据前缀达到 16 字节时不截断，直接拒绝提交
+bool at_submit(const at_cmd_t *cmd);
+
+bool at_send_command_async(const char *command, const char *expected_response, int timeout_ms, at_cmd_cb_t cb, void *ctx);
+
+// 同一前缀可注册多个处理器，按注册顺序依次调用
+bool at_uart_register_urc(const char *prefix, at_urc_handler_t handler, void *ctx);
+
+// 下行消息处理器，在 message_handler_task 中调用；message 为一条完整的 +MSUB URC，
+// 负载按声明的字节数收取，可能含 \r\n 或 0 字节，长度以 len 为准；
+// 末尾另有一个 0，处理器可以就地修改
+typedef void (*at_message_handler_t)(char *message, size_t len, void *ctx);
+// 未设置时只记录其中的 JSON
+void at_uart_set_message_handler(at_message_handler_t handler, void *ctx);
+
+// arg 为 at_modem_t *，NULL 为默认实例
+void message_handler_task(void *arg);
+// 以静态栈启动 message_handler_task，重复调用无副作用
+bool at_uart_start_message_task(void);
+
+// 命令引擎持有的共享暂存区，供组装命令、接收响应的函数使用，持有期间其他任务等待；
+// 持有时不要调用同样会取暂存区的函数（at_check_base、at_mq_connect 等），否则死锁
+typedef struct
+{
+    char command[UART_BUF_SIZE];
+    char response[UART_BUF_SIZE];
+} at_scratch_t;
+
+at_scratch_t *at_scratch_take(void);
+void at_scratch_give(at_scratch_t *scratch);
+
+// ---------------- 多实例 ----------------
+// 以下函数与同名的 at_uart_* 相同，作用于指定实例；modem 为 NULL 时即默认实例
+// 占用一个实例槽并记下串口与引脚，之后按 at_modem_init 的顺序与默认实例一样使用；
+// 槽位用尽时返回 NULL，UART 冲突在 at_modem_init 时报告
+at_modem_t *at_modem_create(const at_modem_port_t *port);
+// 默认实例，未创建时以 AT_MODEM_PORT_DEFAULT 占用第一个槽
+at_modem_t *at_modem_default(void);
+// 已创建的第 index 个实例，不存在时返回 NULL
+at_modem_t *at_modem_get(int index);
+int at_modem_index(const at_modem_t *modem);
+
+void at_modem_set_link(at_modem_t *modem, const at_uart_link_t *link);
+void at_modem_get_link(at_modem_t *modem, at_uart_link_t *out);
+bool at_modem_init(at_modem_t *modem);
+void at_modem_deinit(at_modem_t *modem);
+bool at_modem_inited(at_modem_t *modem);
+bool at_modem_negotiate(at_modem_t *modem, uint32_t max_baud);
+bool at_modem_resume_link(at_modem_t *modem, const at_uart_link_t *link);
+bool at_modem_cmux_start(at_modem_t *modem);
+void at_modem_cmux_stop(at_modem_t *modem);
+bool at_modem_cmux_active(at_modem_t *modem);
+bool at_modem_send_command(at_modem_t *modem, at_channel_t channel, const char *command, const char *expected_response,
+                           int timeout_ms, char *out_response);
+bool at_modem_register_urc(at_modem_t *modem, const char *prefix, at_urc_handler_t handler, void *ctx);
+void at_modem_set_message_handler(at_modem_t *modem, at_message_handler_t handler, void *ctx);
+bool at_modem_start_message_task(at_modem_t *modem);
+at_scratch_t *at_modem_scratch_take(at_modem_t *modem);
+void at_modem_scratch_give(at_modem_t *modem, at_scratch_t *scratch);
 
-void at_uart_listening();
+// 命令集：各组件发命令前取一次描述符。自动探测时，探测前返回 SIM800
+const at_dialect_t *at_modem_dialect(at_modem_t *modem);
+const at_dialect_t *at_uart_dialect(void);
+// 命令集已由 Kconfig、探测或 at_modem_set_dialect 确定
+bool at_modem_dialect_known(at_modem_t *modem);
+void at_modem_set_dialect(at_modem_t *modem, const at_dialect_t *dialect);
+// 未确定时发送 ATI（必要时 AT+GMR）按响应选定，已确定时不发命令；模组无响应时返回当前命令集
+const at_dialect_t *at_modem_probe_dialect(at_modem_t *modem);
 
-void message_handler_task();
-#endif
\ No newline at end of file
+#if CONFIG_IDF_TARGET_LINUX
+// linux 目标：指定默认实例的 POSIX 串口设备（如 at_sim 返回的 pty）
+void at_uart_set_device(const char *path);
+#endif
+#endif
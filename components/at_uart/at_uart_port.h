@@ -0,0 +1,19 @@
+#ifndef AT_UART_PORT_H
+#define AT_UART_PORT_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "at_uart.h"
+
+// 串口后端接口：ESP32 上为 UART 驱动，linux 目标上为 POSIX 串口/pty
+// 每个模组实例打开一个端口，端口的状态由后端各自保存
+typedef struct at_port at_port_t;
+
+at_port_t *at_port_open(const at_modem_port_t *config, const at_uart_link_t *link);
+// 等待已写出的数据发送完毕后切换波特率与流控
+bool at_port_set_baud(at_port_t *port, uint32_t baud, bool flow_ctrl);
+void at_port_close(at_port_t *port);
+int at_port_write(at_port_t *port, const void *data, size_t len);
+// 阻塞直到收到数据，返回读到的字节数，出错返回 -1
+int at_port_read(at_port_t *port, uint8_t *buf, size_t max);
+#endif
@@ -0,0 +1,140 @@
+#include "driver/uart.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "at_uart_port.h"
+
+#define UART_FIFO_SIZE 128       // 硬件 FIFO 长度，驱动缓冲区须大于它
+#define UART_EVENT_QUEUE_SIZE 20 // 驱动事件队列深度
+#define UART_RX_FULL_THRESH 96   // FIFO 中达到该字节数即搬入驱动缓冲区
+#define UART_RTS_THRESH 100      // 启用流控时 FIFO 达到该字节数拉高 RTS
+#define UART_RX_TOUT_SYMBOLS 4   // 线路空闲该符号数后即搬运 FIFO 剩余数据
+
+static const char *TAG = "UART_PORT";
+
+// 引脚由模组实例的 at_modem_port_t 给出，每个 UART 外设最多一个实例
+struct at_port
+{
+    uart_port_t num;
+    QueueHandle_t events;
+    bool used;
+};
+
+static at_port_t ports[UART_NUM_MAX];
+
+// 驱动缓冲区取 FIFO 长度的整数倍，RX 至少两个 FIFO
+static size_t fifo_align(size_t size, size_t min)
+{
+    if (size < min)
+    {
+        size = min;
+    }
+    return (size + UART_FIFO_SIZE - 1) / UART_FIFO_SIZE * UART_FIFO_SIZE;
+}
+
+at_port_t *at_port_open(const at_modem_port_t *config, const at_uart_link_t *link)
+{
+    if (config->uart_num < 0 || config->uart_num >= UART_NUM_MAX || ports[config->uart_num].used)
+    {
+        ESP_LOGE(TAG, "UART %d invalid or already in use", config->uart_num);
+        return NULL;
+    }
+    at_port_t *port = &ports[config->uart_num];
+    port->num = config->uart_num;
+    size_t rxSize = fifo_align(link->rx_buf_size, UART_FIFO_SIZE * 2);
+    size_t txSize = link->tx_buf_size > 0 ? fifo_align(link->tx_buf_size, UART_FIFO_SIZE * 2) : 0;
+    // 模组上电时未开启流控，由协商决定是否启用
+    uart_config_t uart_config = {
+        .baud_rate = link->baud_rate,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .rx_flow_ctrl_thresh = UART_RTS_THRESH,
+        .source_clk = UART_SCLK_APB,
+    };
+
+    int rtsPin = link->flow_ctrl ? config->rts_pin : UART_PIN_NO_CHANGE;
+    int ctsPin = link->flow_ctrl ? config->cts_pin : UART_PIN_NO_CHANGE;
+    if (uart_driver_install(port->num, rxSize, txSize, UART_EVENT_QUEUE_SIZE, &port->events, 0) != ESP_OK ||
+        uart_param_config(port->num, &uart_config) != ESP_OK ||
+        uart_set_pin(port->num, config->tx_pin, config->rx_pin, rtsPin, ctsPin) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "UART %d initialization failed", port->num);
+        uart_driver_delete(port->num);
+        return NULL;
+    }
+
+    // 行尾 '\n' 触发模式检测中断，整行到达即唤醒读任务
+    uart_enable_pattern_det_baud_intr(port->num, '\n', 1, 9, 0, 0);
+    uart_pattern_queue_reset(port->num, UART_EVENT_QUEUE_SIZE);
+    // 高波特率下 FIFO 在约 1 ms 内即可填满，提前搬运避免 FIFO 溢出
+    uart_set_rx_full_threshold(port->num, UART_RX_FULL_THRESH);
+    uart_set_rx_timeout(port->num, UART_RX_TOUT_SYMBOLS);
+    port->used = true;
+    ESP_LOGI(TAG, "UART %d at %u baud, RX buffer %u, TX buffer %u", port->num, (unsigned)link->baud_rate, (unsigned)rxSize,
+             (unsigned)txSize);
+    return port;
+}
+
+bool at_port_set_baud(at_port_t *port, uint32_t baud, bool flow_ctrl)
+{
+    uart_wait_tx_done(port->num, pdMS_TO_TICKS(100));
+    if (uart_set_baudrate(port->num, baud) != ESP_OK ||
+        uart_set_hw_flow_ctrl(port->num, flow_ctrl ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE, UART_RTS_THRESH) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to switch UART to %u baud", (unsigned)baud);
+        return false;
+    }
+    // 切换过程中收到的字节按旧波特率采样，已无意义
+    uart_flush_input(port->num);
+    return true;
+}
+
+void at_port_close(at_port_t *port)
+{
+    uart_driver_delete(port->num);
+    port->events = NULL;
+    port->used = false;
+}
+
+int at_port_write(at_port_t *port, const void *data, size_t len)
+{
+    return uart_write_bytes(port->num, data, len);
+}
+
+int at_port_read(at_port_t *port, uint8_t *buf, size_t max)
+{
+    uart_event_t event;
+
+    while (1)
+    {
+        // 驱动缓冲区里还有数据就直接取，不必等待下一个事件
+        size_t buffered = 0;
+        uart_get_buffered_data_len(port->num, &buffered);
+        if (buffered > 0)
+        {
+            return uart_read_bytes(port->num, buf, buffered < max ? buffered : max, 0);
+        }
+
+        if (xQueueReceive(port->events, &event, portMAX_DELAY) != pdTRUE)
+        {
+            continue;
+        }
+        switch (event.type)
+        {
+        case UART_PATTERN_DET:
+            // 行尾位置由分发任务自行切分，这里只需弹出位置避免队列溢出
+            uart_pattern_pop_pos(port->num);
+            break;
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            ESP_LOGE(TAG, "UART RX overflow, event %d", event.type);
+            uart_flush_input(port->num);
+            xQueueReset(port->events);
+            break;
+        default:
+            break;
+        }
+    }
+}
@@ -0,0 +1,181 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "at_uart.h"
+#include "at_uart_port.h"
+
+#define DEFAULT_DEVICE "/dev/ttyUSB0"
+
+static const char *TAG = "UART_PORT";
+static char devicePath[128] = {0};
+
+struct at_port
+{
+    int fd;
+    bool used;
+};
+
+static at_port_t ports[AT_MODEM_MAX];
+
+// 指定默认实例的串口设备（例如模拟器返回的 pty），未指定时读取环境变量 AT_UART_DEVICE；
+// 其余实例由 at_modem_port_t.device 给出
+void at_uart_set_device(const char *path)
+{
+    strncpy(devicePath, path, sizeof(devicePath) - 1);
+    devicePath[sizeof(devicePath) - 1] = '\0';
+}
+
+static speed_t baud_speed(uint32_t baud)
+{
+    switch (baud)
+    {
+    case 9600:
+        return B9600;
+    case 19200:
+        return B19200;
+    case 38400:
+        return B38400;
+    case 57600:
+        return B57600;
+    case 230400:
+        return B230400;
+    case 460800:
+        return B460800;
+    case 921600:
+        return B921600;
+    default:
+        return B115200;
+    }
+}
+
+at_port_t *at_port_open(const at_modem_port_t *config, const at_uart_link_t *link)
+{
+    const char *path = config->device ? config->device : devicePath[0] ? devicePath : getenv("AT_UART_DEVICE");
+    if (path == NULL)
+    {
+        path = DEFAULT_DEVICE;
+    }
+    at_port_t *port = NULL;
+    for (int i = 0; i < AT_MODEM_MAX && port == NULL; i++)
+    {
+        port = ports[i].used ? NULL : &ports[i];
+    }
+    if (port == NULL)
+    {
+        ESP_LOGE(TAG, "No free serial port for %s", path);
+        return NULL;
+    }
+
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0)
+    {
+        ESP_LOGE(TAG, "Failed to open %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, baud_speed(link->baud_rate));
+        cfsetospeed(&tio, baud_speed(link->baud_rate));
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    port->fd = fd;
+    port->used = true;
+    ESP_LOGI(TAG, "Serial backend on %s", path);
+    return port;
+}
+
+bool at_port_set_baud(at_port_t *port, uint32_t baud, bool flow_ctrl)
+{
+    struct termios tio;
+    int fd = port->fd;
+    tcdrain(fd);
+    if (tcgetattr(fd, &tio) != 0)
+    {
+        return false;
+    }
+    cfsetispeed(&tio, baud_speed(baud));
+    cfsetospeed(&tio, baud_speed(baud));
+    if (flow_ctrl)
+    {
+        tio.c_cflag |= CRTSCTS;
+    }
+    else
+    {
+        tio.c_cflag &= ~CRTSCTS;
+    }
+    if (tcsetattr(fd, TCSANOW, &tio) != 0)
+    {
+        ESP_LOGE(TAG, "Failed to switch to %u baud: %s", (unsigned)baud, strerror(errno));
+        return false;
+    }
+    tcflush(fd, TCIFLUSH);
+    return true;
+}
+
+void at_port_close(at_port_t *port)
+{
+    if (port->used)
+    {
+        close(port->fd);
+        port->fd = -1;
+        port->used = false;
+    }
+}
+
+int at_port_write(at_port_t *port, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    size_t left = len;
+    while (left > 0)
+    {
+        ssize_t n = write(port->fd, p, left);
+        if (n < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+            {
+                continue;
+            }
+            ESP_LOGE(TAG, "write failed: %s", strerror(errno));
+            return -1;
+        }
+        p += n;
+        left -= n;
+    }
+    return len;
+}
+
+int at_port_read(at_port_t *port, uint8_t *buf, size_t max)
+{
+    struct pollfd pfd = {.fd = port->fd, .events = POLLIN};
+    while (1)
+    {
+        int rc = poll(&pfd, 1, -1);
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        ssize_t n = read(port->fd, buf, max);
+        if (n > 0)
+        {
+            return n;
+        }
+        if (n < 0 && errno != EINTR && errno != EAGAIN)
+        {
+            ESP_LOGE(TAG, "read failed: %s", strerror(errno));
+            return -1;
+        }
+    }
+}
@@ -9,11 +9,15 @@
 #include "at_uart.h"
 #include "at_check.h"
 #include "at_config.h"
+#include "at_boot.h"
 #include <string.h>
 static const char *TAG = "AT_UTILS";
 
 static bool isTimeSet = false;
 
+// 热启动沿用系统时间的上限，超过后重新按模组时钟校时
+#define CLOCK_RESUME_MAX_AGE_MS (24LL * 3600 * 1000)
+
 void set_timezone(const char *timezone)
 {
     setenv("TZ", timezone, 1);
@@ -45,47 +49,73 @@ bool initSysTimeByAT()
 {
     if (at_check_base() && at_check_pdp())
     {
-        char response[UART_BUF_SIZE];
-        at_send_command("AT+CCLK?", "OK", 1000, response, false);
-        ESP_LOGI(TAG, "AT+CCLK? response: %s", response);
-        if (strlen(response) == 0)
+        // 响应放在共享暂存区，只取出时间字段后立即归还
+        char cclk_line[64] = {0};
+        at_scratch_t *scratch = at_scratch_take();
+        at_send_command("AT+CCLK?", "OK", 1000, scratch->response, false);
+        ESP_LOGI(TAG, "AT+CCLK? response: %s", scratch->response);
+        char *action_start = strstr(scratch->response, "+CCLK:");
+        if (action_start)
+        {
+            // 提取 +CCLK: 行，仅保留相关内容
+            sscanf(action_start, "+CCLK: \"%63[^\"]\"", cclk_line);
+        }
+        else if (strlen(scratch->response) == 0)
         {
             ESP_LOGE(TAG, "Empty response received for AT+CCLK");
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Expected CCLK not found in response: %s", scratch->response);
+        }
+        at_scratch_give(scratch);
+        if (action_start == NULL)
+        {
             return false;
         }
-        if (strstr(response, "+CCLK:") != NULL)
+        int year, month, day, hour, minute, second;
+        ESP_LOGW(TAG, "cclk_line: %s", cclk_line);
+        if (sscanf(cclk_line, "%d/%d/%d,%d:%d:%d",
+                   &year, &month, &day, &hour, &minute, &second) == 6)
         {
-            char *action_start = strstr(response, "+CCLK:");
-            if (action_start)
-            {
-                char cclk_line[64] = {0};
-                // 提取 +CCLK: 行，仅保留相关内容
-                sscanf(action_start, "+CCLK: \"%63[^\"]\"", cclk_line);
-                int year, month, day, hour, minute, second;
-                ESP_LOGW(TAG, "cclk_line: %s", cclk_line);
-                if (sscanf(cclk_line, "%d/%d/%d,%d:%d:%d",
-                           &year, &month, &day, &hour, &minute, &second) == 6)
-                {
-                    year += 2000; // Adjust year
-                    set_esp32_time(year, month, day, hour, minute, second);
-                    ESP_LOGI(TAG, "Set system time to %d/%d/%d %d:%d:%d", year, month, day, hour, minute, second);
-                }
-                else
-                {
-                    ESP_LOGE(TAG, "Failed to parse CCLK response: %s", response);
-                    return false;
-                }
-            }
+            year += 2000; // Adjust year
+            set_esp32_time(year, month, day, hour, minute, second);
+            ESP_LOGI(TAG, "Set system time to %d/%d/%d %d:%d:%d", year, month, day, hour, minute, second);
+            struct timeval tv;
+            gettimeofday(&tv, NULL);
+            at_boot_state_t *boot = at_boot_take();
+            boot->clock_ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+            at_boot_give(boot, true);
         }
         else
         {
-            ESP_LOGE(TAG, "Expected CCLK not found in response: %s", response);
+            ESP_LOGE(TAG, "Failed to parse CCLK response: %s", cclk_line);
             return false;
         }
     }
     return true;
 }
 
+// 热启动：ESP32 的系统时间在软件复位与看门狗复位后由 RTC 继续计时，
+// 当前时间不早于上次校时且间隔不长时直接沿用，省去 AT+CCLK?
+bool resumeSysTime()
+{
+    at_boot_state_t *boot = at_boot_take();
+    int64_t synced = boot->clock_ms;
+    at_boot_give(boot, false);
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t now = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    if (synced <= 0 || now < synced || now - synced > CLOCK_RESUME_MAX_AGE_MS)
+    {
+        return false;
+    }
+    set_timezone("CST-8");
+    isTimeSet = true;
+    ESP_LOGI(TAG, "System time kept across reset, last synced %lld s ago", (long long)(now - synced) / 1000);
+    return true;
+}
+
 uint64_t get_current_timestamp_ms()
 {
     if (isTimeSet)
@@ -5,6 +5,8 @@
 
 void generate_random_uuid(char *uuid, size_t size);
 bool initSysTimeByAT();
+// 热启动时沿用复位前已校准的系统时间，无法确认时返回 false，由调用者执行 initSysTimeByAT
+bool resumeSysTime();
 uint64_t get_current_timestamp_ms();
 void parse_json(const char *input, char *output);
 #endif
\ No newline at end of file
@@ -11,9 +11,30 @@
 #include "at_config.h"
 #include "cJSON.h"
 #include "at_utils.h"
+#include "at_codec.h"
+#include "at_json_pool.h"
+#include "at_task.h"
+#include "at_boot.h"
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include "at_sim.h"
+#endif
 
 static const char *TAG = "MAIN";
 
+// 本次是否走了热启动，getMQ 输出启动耗时时使用
+static bool warmBoot = false;
+
+// getMQ 栈预算，连接、注册与发布链路的实测高水位加余量
+#define GET_MQ_STACK 4096
+AT_TASK_DEFINE(getMQTask, GET_MQ_STACK);
+
+// 注册结果 /platform/<username>/regist/...
+static void registReply(const char *topic, const char *payload, size_t len, void *ctx)
+{
+  ESP_LOGI(TAG, "Regist reply on %s: %.*s", topic, (int)len, payload);
+}
+
 void getMQ()
 {
   char *iccid = at_get_iccid();
@@ -29,32 +50,49 @@ void getMQ()
       .username = "",
       .password = "",
   };
+  // 上行报文编码按设备类别取默认值
+  at_mq_set_default_encoding(getDeviceCateEncoding(Elevator));
+  // 连接失败时注册消息先进入发件箱，连上后补发
+  at_mq_outbox_enable();
   at_mq_connect(mqconfig);
-  char topic[UART_BUF_SIZE];
+  at_boot_phase("mq_connect");
+  // 注册的 topic 与负载只在本任务中使用一次，不占用任务栈
+  static char topic[UART_BUF_SIZE];
+  static char payload[UART_BUF_SIZE];
   sprintf(topic, "/platform/%s/regist/#", mqconfig.username);
+  at_mq_add_route(topic, registReply, NULL);
   at_mq_subscribe(topic);
-  cJSON *payload = cJSON_CreateObject();
-  cJSON_AddStringToObject(payload, "deviceId", iccid);
-  cJSON_AddStringToObject(payload, "deviceName", "ESP32_AT");
-  cJSON_AddStringToObject(payload, "deviceCate", getDeviceCateString(Elevator));
-  cJSON_AddStringToObject(payload, "mqttUserName", mqconfig.username);
-  cJSON_AddStringToObject(payload, "projectInfoCode", "PJ202406050002");
+  at_codec_regist_t regist = {
+      .deviceId = iccid,
+      .deviceName = "ESP32_AT",
+      .deviceCate = getDeviceCateString(Elevator),
+      .mqttUserName = mqconfig.username,
+      .projectInfoCode = "PJ202406050002",
+  };
+  if (at_codec_encode_regist(&regist, payload, sizeof(payload)) >= sizeof(payload))
+  {
+    ESP_LOGE(TAG, "Regist payload too long");
+    return;
+  }
   char uuid[37];
   generate_random_uuid(uuid, sizeof(uuid));
   sprintf(topic, "/platform/%s/regist", mqconfig.username);
   mqMessage_t message = {
       .topic = topic,
       .event = RegistDevice,
-      .data = payload,
+      .rawData = payload,
       .time = get_current_timestamp_ms(),
       .ttl = 5000,
       .id = uuid,
   };
   at_mq_publish(message, NULL, NULL);
+  at_boot_phase("first_publish");
+  at_boot_report(warmBoot);
   at_mq_listening();
+  at_mq_telemetry_enable(300000);
   while (1)
   {
-    ESP_LOGI("STACK", "Remaining stack size: %d", uxTaskGetStackHighWaterMark(NULL));
+    at_task_log();
     vTaskDelay(pdMS_TO_TICKS(10000));
   }
 
@@ -64,6 +102,19 @@ void getMQ()
 
 void app_main()
 {
+  // cJSON 节点与字符串改用专用池，长期运行不再碎片化系统堆
+  at_json_pool_init();
+#if CONFIG_IDF_TARGET_LINUX
+  // linux 目标：在 pty 上启动模组模拟器代替真实模组
+  at_sim_config_t sim = AT_SIM_DEFAULT_CONFIG();
+  const char *device = at_sim_start(&sim);
+  if (device == NULL)
+  {
+    ESP_LOGE(TAG, "Failed to start modem simulator");
+    return;
+  }
+  at_uart_set_device(device);
+#endif
   // Initialize UART
   at_uart_init();
   while (!is_uart_inited())
@@ -71,17 +122,35 @@ void app_main()
     ESP_LOGI(TAG, "Waiting for UART!");
     vTaskDelay(pdMS_TO_TICKS(1000));
   }
+  at_boot_phase("uart_init");
 
-  // Perform AT check
-  if (at_check_ping())
+  // 看门狗等复位后模组仍在原波特率且承载在线，一次探测即可恢复，跳过协商、检查与校时
+  warmBoot = at_check_warm_start();
+  at_boot_phase("warm_probe");
+  bool ready = warmBoot;
+  if (!warmBoot)
   {
+    // 协商到模组支持的最高波特率，失败时保持当前波特率
+    at_uart_negotiate(AT_UART_MAX_BAUD);
+    at_boot_phase("negotiate");
+    // Perform AT check
+    ready = at_check_ping();
+    at_boot_phase("ping");
+  }
 
-    initSysTimeByAT();
+  if (ready)
+  {
+    if (!warmBoot || !resumeSysTime())
+    {
+      initSysTimeByAT();
+    }
+    at_boot_phase("clock");
     // Print current time
     // char *iccid = at_get_iccid();
     // ESP_LOGI(TAG, "ICCID: %s", iccid);
+    // at_http_init();
     // at_http_get("https://dev.usemock.com/6782c14e1f946a67671573e2/ping");
-    // at_http_post("https://dev.usemock.com/6782c14e1f946a67671573e2/pong");
-    xTaskCreatePinnedToCore(getMQ, "getMQ", 8192, NULL, 5, NULL, 1);
+    // at_http_post("https://dev.usemock.com/6782c14e1f946a67671573e2/pong", "{\"test\":\"123\",\"bool\":true}");
+    at_task_start(&getMQTask, getMQ, "getMQ", NULL, 5, 1);
   }
 }